@@ -0,0 +1,50 @@
+#include <iostream>
+
+#include "bench_common.h"
+#include "common.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+/**
+ * @brief ループの外にブレークポイントを指定数設定して実行し、1秒あたりのステップ数を返す
+ *
+ * @param count ブレークポイント数
+ * @param repeat 実行回数
+ * @return double steps/sec
+ */
+double Measure(int count, int repeat) {
+    // 使用していない末尾のアドレスに設定する
+    for (int i = 0; i < count; i++) env.cii_cpu.SetBreakPoint(cii::CommetIIEnv::DEFAULT_MEM_SIZE - 1 - i);
+
+    uint64_t steps = 0;
+    bench::StopWatch sw;
+    for (int i = 0; i < repeat; i++) {
+        env.cii_cpu.Reset();
+        env.cii_cpu.Run();
+        steps += env.cii_cpu.GetExcutedCounter();
+    }
+    double result = steps / sw.Elapsed();
+
+    for (int i = 0; i < count; i++) env.cii_cpu.DeleteBreakPoint(cii::CommetIIEnv::DEFAULT_MEM_SIZE - 1 - i);
+    return result;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 20000;
+    int repeat = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    if (!bench::Build(env, bench::LoopSource(count))) {
+        std::cerr << "build error" << std::endl;
+        return 1;
+    }
+
+    double none = Measure(0, repeat);
+    for (int n : {1, 8, 64}) {
+        double with = Measure(n, repeat);
+        std::cout << cmn::Format("%2d break points: %12.0f steps/sec (x%.2f)\n", n, with, with / none);
+    }
+    std::cout << cmn::Format(" no break point : %12.0f steps/sec\n", none);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "builder.h"
+#include "common.h"
+
+namespace {
+
+/**
+ * @brief モジュールのソースを生成する
+ * @param no モジュール番号
+ * @param lines 命令の行数
+ */
+std::string ModuleSource(int no, int lines) {
+    std::stringstream ss;
+    ss << "M" << no << "     START\n";
+    for (int i = 0; i < lines; i++) {
+        ss << "L" << i << "      LD      GR1,D" << (i * 7 % lines) << ",GR2   ; ロード\n";
+        ss << "        ADDA    GR1,=" << (i % 100) << "\n";
+        ss << "D" << i << "      DC      " << i << "\n";
+    }
+    ss << "        RET\n"
+          "        END\n";
+    return ss.str();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int modules = argc > 1 ? std::stoi(argv[1]) : 16;
+    int lines = argc > 2 ? std::stoi(argv[2]) : 700;
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "bench_build";
+    std::filesystem::create_directories(dir);
+    std::vector<std::string> files;
+    for (int i = 0; i < modules; i++) {
+        std::string file = (dir / cmn::Format("m%d.csl", i)).string();
+        std::ofstream(file) << ModuleSource(i, lines);
+        files.push_back(file);
+    }
+
+    auto env = std::make_unique<cii::CommetIIEnv>(cii::CommetIIEnv::MAX_MEM_SIZE);
+    unsigned parallel_jobs = argc > 3 ? std::stoi(argv[3]) : 0;
+    double secs[2];
+    for (unsigned jobs : {1u, parallel_jobs}) {
+        Builder builder{*env};
+        builder.SetJobs(jobs);
+        bench::StopWatch sw;
+        ass::LineTable dbg_infos;
+        if (!builder.Build(files, dbg_infos)) return 1;
+        secs[jobs != 1] = sw.Elapsed();
+    }
+    std::cout << cmn::Format("%d modules x %d lines\n", modules, lines * 3);
+    std::cout << cmn::Format("sequential: %8.2f ms\n", secs[0] * 1e3);
+    std::cout << cmn::Format("parallel  : %8.2f ms (x%.1f)\n", secs[1] * 1e3, secs[0] / secs[1]);
+    return 0;
+}
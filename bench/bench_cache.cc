@@ -0,0 +1,77 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "builder.h"
+#include "common.h"
+
+namespace {
+
+/**
+ * @brief ライブラリのモジュールのソースを生成する
+ * @param no モジュール番号
+ * @param lines 命令の行数
+ * @param rev 変更番号(コメントだけ変わる)
+ */
+std::string ModuleSource(int no, int lines, int rev) {
+    std::stringstream ss;
+    ss << "M" << no << "     START   ; rev " << rev << "\n";
+    for (int i = 0; i < lines; i++) {
+        ss << "L" << i << "      LD      GR1,D" << (i * 7 % lines) << ",GR2\n";
+        ss << "        ADDA    GR1,=" << (i % 100) << "\n";
+        ss << "D" << i << "      DC      " << i << "\n";
+    }
+    ss << "        RET\n"
+          "        END\n";
+    return ss.str();
+}
+
+double Build(const std::vector<std::string>& files, const std::string& cache_dir) {
+    auto env = std::make_unique<cii::CommetIIEnv>(cii::CommetIIEnv::MAX_MEM_SIZE);
+    Builder builder{*env};
+    builder.SetJobs(1);
+    builder.SetCacheDir(cache_dir);
+    ass::LineTable dbg_infos;
+    bench::StopWatch sw;
+    if (!builder.Build(files, dbg_infos)) {
+        std::cerr << "build error" << std::endl;
+        exit(1);
+    }
+    return sw.Elapsed();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int modules = argc > 1 ? std::stoi(argv[1]) : 50;
+    int lines = argc > 2 ? std::stoi(argv[2]) : 250;
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "bench_cache";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::string cache_dir = (dir / "cache").string();
+    std::vector<std::string> files;
+    for (int i = 0; i < modules; i++) {
+        std::string file = (dir / cmn::Format("m%d.csl", i)).string();
+        std::ofstream(file) << ModuleSource(i, lines, 0);
+        files.push_back(file);
+    }
+
+    double full = Build(files, "");
+    double cold = Build(files, cache_dir);
+    double warm = Build(files, cache_dir);
+    // 1ファイルだけ変更する
+    std::ofstream(files[modules / 2]) << ModuleSource(modules / 2, lines, 1);
+    double one = Build(files, cache_dir);
+
+    std::cout << cmn::Format("%d modules x %d lines\n", modules, lines * 3);
+    std::cout << cmn::Format("no cache         : %8.2f ms\n", full * 1e3);
+    std::cout << cmn::Format("cache (cold)     : %8.2f ms\n", cold * 1e3);
+    std::cout << cmn::Format("cache (no change): %8.2f ms (x%.1f)\n", warm * 1e3, full / warm);
+    std::cout << cmn::Format("cache (1 changed): %8.2f ms (x%.1f)\n", one * 1e3, full / one);
+    return 0;
+}
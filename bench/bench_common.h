@@ -0,0 +1,76 @@
+#ifndef BENCH_COMMON_H_
+#define BENCH_COMMON_H_
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "assembler.h"
+#include "conf.h"
+
+namespace bench {
+
+/**
+ * @brief sample/test4.csl と同じ配列加算ループを外側で count 回繰り返すプログラム
+ *
+ * @param count 外側ループの回数
+ * @return std::string CASLIIソース
+ */
+inline std::string LoopSource(int count) {
+    std::stringstream ss;
+    ss << "BENCH   START\n"
+          "        XOR     GR7,GR7\n"
+          "OUTER   XOR     GR0,GR0\n"
+          "        XOR     GR1,GR1\n"
+          "L1      CPA     GR1,LEN\n"
+          "        JZE     L2\n"
+          "        ADDA    GR0,DATA,GR1\n"
+          "        ADDA    GR1,=1\n"
+          "        JUMP    L1\n"
+          "L2      ST      GR0,ANS\n"
+          "        LAD     GR7,1,GR7\n"
+          "        CPA     GR7,COUNT\n"
+          "        JNZ     OUTER\n"
+          "        HLT\n"
+          "DATA    DC      12,34,56,78,90\n"
+          "LEN     DC      5\n"
+          "COUNT   DC      "
+       << count
+       << "\n"
+          "ANS     DS      1\n"
+          "        END\n";
+    return ss.str();
+}
+
+/**
+ * @brief ソースをアセンブルしてメモリに配置する
+ *
+ * @param env commetII 環境
+ * @param src CASLIIソース
+ * @return true 成功
+ */
+inline bool Build(cii::CommetIIEnv& env, const std::string& src) {
+    ass::Assembler assem;
+    std::stringstream ss{src};
+
+    env.mem.Start();
+    assem.Assemble(ss, env.mem);
+    return !assem.is_error && env.mem.End();
+}
+
+/**
+ * @brief 経過時間計測
+ */
+class StopWatch {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+   public:
+    double Elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+}  // namespace bench
+
+#endif
@@ -0,0 +1,44 @@
+#include <iostream>
+
+#include "bench_common.h"
+#include "common.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+/**
+ * @brief 指定回数実行し、1秒あたりのステップ数を返す
+ *
+ * @param repeat 実行回数
+ * @return double steps/sec
+ */
+double Measure(int repeat) {
+    uint64_t steps = 0;
+    bench::StopWatch sw;
+    for (int i = 0; i < repeat; i++) {
+        env.cii_cpu.Reset();
+        env.cii_cpu.Run();
+        steps += env.cii_cpu.GetExcutedCounter();
+    }
+    return steps / sw.Elapsed();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 20000;
+    int repeat = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    if (!bench::Build(env, bench::LoopSource(count))) {
+        std::cerr << "build error" << std::endl;
+        return 1;
+    }
+
+    env.cii_cpu.SetDecodeCache(false);
+    double no_cache = Measure(repeat);
+    env.cii_cpu.SetDecodeCache(true);
+    double cache = Measure(repeat);
+
+    std::cout << cmn::Format("decode cache off: %12.0f steps/sec\n", no_cache);
+    std::cout << cmn::Format("decode cache on : %12.0f steps/sec (x%.2f)\n", cache, cache / no_cache);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <iostream>
+
+#include "bench_common.h"
+#include "common.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+/**
+ * @brief 指定エンジンで指定回数実行し、1秒あたりのステップ数を返す
+ *
+ * @param engine 命令実行エンジン
+ * @param repeat 実行回数
+ * @return double steps/sec
+ */
+double Measure(cii::ExecEngine engine, int repeat) {
+    env.cii_cpu.SetEngine(engine);
+
+    uint64_t steps = 0;
+    bench::StopWatch sw;
+    for (int i = 0; i < repeat; i++) {
+        env.cii_cpu.Reset();
+        env.cii_cpu.Run();
+        steps += env.cii_cpu.GetExcutedCounter();
+    }
+    return steps / sw.Elapsed();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 20000;
+    int repeat = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    if (!bench::Build(env, bench::LoopSource(count))) {
+        std::cerr << "build error" << std::endl;
+        return 1;
+    }
+
+    double call = Measure(cii::ExecEngine::CALL, repeat);
+    double threaded = Measure(cii::ExecEngine::THREADED, repeat);
+    double jit = Measure(cii::ExecEngine::JIT, repeat);
+
+    std::cout << cmn::Format("call dispatch    : %12.0f steps/sec\n", call);
+    std::cout << cmn::Format("threaded dispatch: %12.0f steps/sec (x%.2f)\n", threaded, threaded / call);
+    std::cout << cmn::Format("jit              : %12.0f steps/sec (x%.2f)\n", jit, jit / call);
+    return 0;
+}
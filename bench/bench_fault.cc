@@ -0,0 +1,40 @@
+#include <iostream>
+
+#include "bench_common.h"
+#include "common.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+//! 数命令実行したあとに範囲外アドレスを読み込むプログラム
+const char* FAULT_SRC =
+    "MAIN   START\n"
+    "       LAD   GR1,1\n"
+    "       ADDA  GR2,GR1\n"
+    "       LD    GR0,#FFFF\n"
+    "       HLT\n"
+    "       END\n";
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int repeat = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+    if (!bench::Build(env, FAULT_SRC)) {
+        std::cerr << "build error" << std::endl;
+        return 1;
+    }
+
+    env.cii_cpu.Reset();
+    int faults = 0;
+    bench::StopWatch sw;
+    for (int i = 0; i < repeat; i++) {
+        // 先頭から再実行する
+        env.cii_cpu.PR = 0;
+        if (env.cii_cpu.Run() == cii::CauseOfStop::ILLEGAL_ACCESS) faults++;
+    }
+    double sec = sw.Elapsed();
+
+    std::cout << cmn::Format("ILLEGAL_ACCESS: %d faults in %.3f sec (%.0f faults/sec, %.1f ns/fault)\n", faults, sec,
+                             faults / sec, sec * 1e9 / faults);
+    return faults == repeat ? 0 : 1;
+}
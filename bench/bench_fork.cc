@@ -0,0 +1,67 @@
+#include <iostream>
+#include <memory>
+
+#include "bench_common.h"
+#include "program_image.h"
+#include "common.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+//! 入力した文字列をそのまま出力する
+const char* ECHO_SRC =
+    "ECHO   START\n"
+    "       IN    BUF,LEN\n"
+    "       OUT   BUF,LEN\n"
+    "       RET\n"
+    "BUF    DS    256\n"
+    "LEN    DS    1\n"
+    "       END\n";
+
+/**
+ * @brief 1ケースを実行する
+ */
+void RunCase(cii::CometII& cpu) {
+    std::stringstream in{"hello"};
+    std::stringstream out;
+    cpu.SetSvcIn(in);
+    cpu.SetSvcOut(out);
+    cpu.Run();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int repeat = argc > 1 ? std::stoi(argv[1]) : 20000;
+
+    // 毎回アセンブルする
+    bench::StopWatch sw_build;
+    for (int i = 0; i < repeat; i++) {
+        if (!bench::Build(env, ECHO_SRC)) {
+            std::cerr << "build error" << std::endl;
+            return 1;
+        }
+        env.cii_cpu.Reset();
+        RunCase(env.cii_cpu);
+    }
+    double build = sw_build.Elapsed();
+
+    // プログラムイメージから展開する
+    auto build_env = std::make_unique<cii::CommetIIEnv>();
+    std::stringstream src{ECHO_SRC};
+    ass::Assembler assem;
+    build_env->mem.Start();
+    assem.Assemble(src, build_env->mem);
+    build_env->mem.End();
+    cii::ProgramImage image{build_env->mem, build_env->mem.GetOffset(), 0, assem.dbg_infos};
+
+    bench::StopWatch sw_fork;
+    for (int i = 0; i < repeat; i++) {
+        image.Fork(env.cii_cpu);
+        RunCase(env.cii_cpu);
+    }
+    double fork = sw_fork.Elapsed();
+
+    std::cout << cmn::Format("rebuild per run: %8.2f us/run\n", build * 1e6 / repeat);
+    std::cout << cmn::Format("fork per run   : %8.2f us/run (x%.1f)\n", fork * 1e6 / repeat, build / fork);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <iostream>
+
+#include "bench_common.h"
+#include "common.h"
+#include "history.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+/**
+ * @brief 1回実行し、1秒あたりのステップ数を返す
+ *
+ * @param history 実行履歴(nullptrのときは記録しない)
+ * @return double steps/sec
+ */
+double Measure(cii::History* history) {
+    env.cii_cpu.Reset();
+    if (history != nullptr) history->Start();
+    env.cii_cpu.SetHistory(history);
+
+    bench::StopWatch sw;
+    env.cii_cpu.Run();
+    double sec = sw.Elapsed();
+    return env.cii_cpu.GetExcutedCounter() / sec;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 100000;
+    int repeat = argc > 2 ? std::stoi(argv[2]) : 100;
+
+    if (!bench::Build(env, bench::LoopSource(count))) {
+        std::cerr << "build error" << std::endl;
+        return 1;
+    }
+
+    env.cii_cpu.SetEngine(cii::ExecEngine::CALL);
+    double call = Measure(nullptr);
+    cii::History history(env.cii_cpu);
+    double recorded = Measure(&history);
+    uint32_t end = env.cii_cpu.GetExcutedCounter();
+    size_t checkpoints = history.GetCheckpoints();
+    size_t used = history.GetUsed();
+
+    // 1命令ずつ戻る(直前のチェックポイントから再実行する)
+    bench::StopWatch sw;
+    for (int i = 0; i < repeat; i++) history.GoTo(env.cii_cpu.GetExcutedCounter() - 1);
+    double step_back = sw.Elapsed() / repeat;
+    // 最初まで戻る
+    sw = bench::StopWatch();
+    history.GoTo(history.GetOldest());
+    double to_start = sw.Elapsed();
+    env.cii_cpu.SetHistory(nullptr);
+
+    std::cout << cmn::Format("call dispatch    : %12.0f steps/sec\n", call);
+    std::cout << cmn::Format("recorded         : %12.0f steps/sec (x%.2f of call)\n", recorded, recorded / call);
+    std::cout << cmn::Format("recorded steps   : %12u\n", end);
+    std::cout << cmn::Format("checkpoints      : %12zu (%zu bytes)\n", checkpoints, used);
+    std::cout << cmn::Format("step back        : %12.3f ms\n", step_back * 1000);
+    std::cout << cmn::Format("back to start    : %12.3f ms\n", to_start * 1000);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "builder.h"
+#include "common.h"
+#include "exec_image.h"
+
+namespace {
+
+/**
+ * @brief プログラムのソースを生成する
+ * @param lines 命令の行数
+ */
+std::string ProgramSource(int lines) {
+    std::stringstream ss;
+    ss << "MAIN    START\n";
+    for (int i = 0; i < lines; i++) {
+        ss << "L" << i << "      LD      GR1,D" << (i * 7 % lines) << ",GR2   ; ロード\n";
+        ss << "        ADDA    GR1,=" << (i % 100) << "\n";
+        ss << "D" << i << "      DC      " << i << "\n";
+    }
+    ss << "        RET\n"
+          "        END\n";
+    return ss.str();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? std::stoi(argv[1]) : 6000;
+    int count = argc > 2 ? std::stoi(argv[2]) : 20;
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "bench_image";
+    std::filesystem::create_directories(dir);
+    std::string src = (dir / "main.csl").string();
+    std::string img = (dir / "main.ciix").string();
+    std::ofstream(src) << ProgramSource(lines);
+
+    // ソースからビルドしてデバッガを開始できる状態にする
+    double build_sec = 0;
+    for (int i = 0; i < count; i++) {
+        bench::StopWatch sw;
+        auto env = std::make_unique<cii::CommetIIEnv>(cii::CommetIIEnv::MAX_MEM_SIZE);
+        Builder builder{*env};
+        ass::LineTable dbg_infos;
+        if (!builder.Build({src}, dbg_infos)) return 1;
+        build_sec += sw.Elapsed();
+
+        if (i == 0) {
+            std::ofstream ofs(img, std::ios::binary);
+            cii::ExecImage::Save(ofs, env->mem, builder.GetStart(), dbg_infos);
+        }
+    }
+
+    // 実行イメージから実行を開始できる状態にする
+    double run_sec = 0;
+    double debug_sec = 0;
+    for (int i = 0; i < count; i++) {
+        for (bool debug : {false, true}) {
+            bench::StopWatch sw;
+            cii::ExecImage image;
+            if (!image.Open(img)) return 1;
+            auto env = std::make_unique<cii::CommetIIEnv>(image.GetMemSize());
+            image.Load(env->mem);
+            if (debug) {
+                ass::LineTable dbg_infos;
+                image.LoadSyms(env->mem);
+                image.GetDbgInfos(dbg_infos);
+                debug_sec += sw.Elapsed();
+            } else {
+                env->cii_cpu.PR = image.GetStart();
+                run_sec += sw.Elapsed();
+            }
+        }
+    }
+
+    std::cout << cmn::Format("%d lines, image %llu bytes\n", lines * 3,
+                             (unsigned long long)std::filesystem::file_size(img));
+    std::cout << cmn::Format("build from source : %8.3f ms\n", build_sec / count * 1e3);
+    std::cout << cmn::Format("image (run)       : %8.3f ms (x%.0f)\n", run_sec / count * 1e3, build_sec / run_sec);
+    std::cout << cmn::Format("image (debug)     : %8.3f ms (x%.0f)\n", debug_sec / count * 1e3,
+                             build_sec / debug_sec);
+    return 0;
+}
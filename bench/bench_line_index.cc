@@ -0,0 +1,103 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "builder.h"
+#include "common.h"
+
+namespace {
+
+/**
+ * @brief プログラムのソースを生成する
+ * @param lines 命令の行数
+ */
+std::string ProgramSource(int lines) {
+    std::stringstream ss;
+    ss << "MAIN    START\n";
+    for (int i = 0; i < lines; i++) {
+        ss << "L" << i << "      LD      GR1,D" << i << ",GR2\n";
+        ss << "        ADDA    GR1,=1\n";
+        ss << "D" << i << "      DC      " << i << "\n";
+    }
+    ss << "        RET\n"
+          "        END\n";
+    return ss.str();
+}
+
+//! 索引を使わずにアドレスを含む行を探す(後ろから全行を見る)
+uint32_t ScanLine(const ass::LineTable& lines, uint16_t adr) {
+    for (uint32_t i = lines.Size(); i-- > 0;) {
+        if (lines.StartOffset(i) <= adr && lines.EndOffset(i) > adr) return i;
+    }
+    return ass::LineTable::NO_LINE;
+}
+
+//! 索引を使わずに範囲の行を数える(全行を見る)
+uint32_t ScanLines(const ass::LineTable& lines, uint16_t start, uint16_t end) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < lines.Size(); i++) {
+        if (lines.StartOffset(i) >= start && lines.EndOffset(i) < end) n++;
+    }
+    return n;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? std::stoi(argv[1]) : 12000;
+    int count = argc > 2 ? std::stoi(argv[2]) : 2000;
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "bench_line_index";
+    std::filesystem::create_directories(dir);
+    std::string src = (dir / "main.csl").string();
+    std::ofstream(src) << ProgramSource(lines);
+
+    auto env = std::make_unique<cii::CommetIIEnv>(cii::CommetIIEnv::MAX_MEM_SIZE);
+    Builder builder{*env};
+    ass::LineTable dbg_infos;
+    if (!builder.Build({src}, dbg_infos)) return 1;
+    uint32_t used = env->mem.GetOffset();
+
+    std::mt19937 rand(1);
+    std::vector<uint16_t> adrs(count);
+    for (auto& adr : adrs) adr = (uint16_t)(rand() % used);
+
+    // 停止位置、ブレークポイントの行
+    uint64_t sum[2] = {};
+    double find_sec[2];
+    for (int index = 0; index < 2; index++) {
+        bench::StopWatch sw;
+        for (uint16_t adr : adrs) sum[index] += index ? dbg_infos.FindLine(adr) : ScanLine(dbg_infos, adr);
+        find_sec[index] = sw.Elapsed();
+    }
+    // L start end (20ワード分)
+    double list_sec[2];
+    for (int index = 0; index < 2; index++) {
+        bench::StopWatch sw;
+        for (uint16_t adr : adrs) {
+            if (index) {
+                auto [first, last] = dbg_infos.FindLines(adr, adr + 20);
+                sum[index] += last - first;
+            } else {
+                sum[index] += ScanLines(dbg_infos, adr, adr + 20);
+            }
+        }
+        list_sec[index] = sw.Elapsed();
+    }
+    if (sum[0] != sum[1]) {
+        std::cerr << "mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << cmn::Format("%u lines, %u words, %d queries\n", dbg_infos.Size(), used, count);
+    std::cout << cmn::Format("find line  scan: %8.3f us  index: %8.3f us (x%.0f)\n", find_sec[0] / count * 1e6,
+                             find_sec[1] / count * 1e6, find_sec[0] / find_sec[1]);
+    std::cout << cmn::Format("list range scan: %8.3f us  index: %8.3f us (x%.0f)\n", list_sec[0] / count * 1e6,
+                             list_sec[1] / count * 1e6, list_sec[0] / list_sec[1]);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <malloc.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "builder.h"
+#include "common.h"
+
+namespace {
+//! 確保中のヒープのバイト数
+std::atomic<size_t> live_bytes{0};
+
+/**
+ * @brief プログラムのソースを生成する
+ * @param lines 命令の行数
+ */
+std::string ProgramSource(int lines) {
+    std::stringstream ss;
+    ss << "MAIN    START\n";
+    for (int i = 0; i < lines; i++) {
+        ss << "L" << i << "      LD      GR1,D" << (i * 7 % lines) << ",GR2   ; ロード\n";
+        ss << "        ADDA    GR1,=" << (i % 100) << "\n";
+        ss << "D" << i << "      DC      " << i << "\n";
+    }
+    ss << "        RET\n"
+          "        END\n";
+    return ss.str();
+}
+}  // namespace
+
+void* operator new(size_t size) {
+    void* p = malloc(size);
+    if (p == nullptr) throw std::bad_alloc();
+    live_bytes += malloc_usable_size(p);
+    return p;
+}
+void operator delete(void* p) noexcept {
+    if (p == nullptr) return;
+    live_bytes -= malloc_usable_size(p);
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? std::stoi(argv[1]) : 6000;
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "bench_lines";
+    std::filesystem::create_directories(dir);
+    std::string src = (dir / "main.csl").string();
+    std::ofstream(src) << ProgramSource(lines);
+
+    auto env = std::make_unique<cii::CommetIIEnv>(cii::CommetIIEnv::MAX_MEM_SIZE);
+    Builder builder{*env};
+    size_t bytes;
+    double sec;
+    {
+        ass::LineTable dbg_infos;
+        bench::StopWatch sw;
+        if (!builder.Build({src}, dbg_infos)) return 1;
+        sec = sw.Elapsed();
+        bytes = live_bytes;
+    }
+    // ビルドした結果のデバッグ情報だけのバイト数
+    bytes -= live_bytes;
+
+    std::cout << cmn::Format("%d lines, source %llu bytes\n", lines * 3,
+                             (unsigned long long)std::filesystem::file_size(src));
+    std::cout << cmn::Format("build      : %8.2f ms\n", sec * 1e3);
+    std::cout << cmn::Format("debug info : %8.2f MB (%.1f bytes/line)\n", bytes / 1e6, (double)bytes / (lines * 3));
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "bench_common.h"
+#include "common.h"
+
+namespace {
+
+/**
+ * @brief labels個のラベルを定義し、半分の行から別のラベルを参照するソースを生成する
+ * @param labels ラベル数
+ * @note
+ * メモリに収まるように、参照する行(2語)と参照しない行(0語)を交互に置く
+ */
+std::string LabelSource(int labels) {
+    std::stringstream ss;
+    ss << "MAIN    START\n";
+    for (int i = 0; i < labels; i++) {
+        if (i % 2 == 0) {
+            ss << "L" << i << "      JUMP    L" << (int)((i * 7919LL) % labels) << "\n";
+        } else {
+            ss << "L" << i << "      DS      0\n";
+        }
+    }
+    ss << "        END\n";
+    return ss.str();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int max_labels = argc > 1 ? std::stoi(argv[1]) : 50000;
+
+    auto env = std::make_unique<cii::CommetIIEnv>(cii::CommetIIEnv::MAX_MEM_SIZE);
+    for (int labels = 10000; labels <= max_labels; labels += 10000) {
+        std::string src = LabelSource(labels);
+
+        bench::StopWatch sw;
+        if (!bench::Build(*env, src)) {
+            std::cerr << "build error" << std::endl;
+            return 1;
+        }
+        double sec = sw.Elapsed();
+        std::cout << cmn::Format("%6d labels: %8.2f ms (%6.3f us/label)\n", labels, sec * 1e3, sec * 1e6 / labels);
+    }
+    return 0;
+}
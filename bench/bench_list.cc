@@ -0,0 +1,90 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#include "bench_common.h"
+#include "builder.h"
+#include "common.h"
+#include "debugger.h"
+
+namespace {
+
+/**
+ * @brief プログラムのソースを生成する
+ * @param lines 命令の行数
+ */
+std::string ProgramSource(int lines) {
+    std::stringstream ss;
+    ss << "MAIN    START\n";
+    for (int i = 0; i < lines; i++) {
+        ss << "L" << i << "      LD      GR1,D" << i << ",GR2   ; ロード\n";
+        ss << "        ADDA    GR1,=1\n";
+        ss << "D" << i << "      DC      " << i << "\n";
+    }
+    ss << "        OUT     D0,D1\n"
+          "        RET\n"
+          "        END\n";
+    return ss.str();
+}
+
+/**
+ * @brief 出力を捨てて、書き込み回数とバイト数を数える
+ */
+class CountBuf : public std::streambuf {
+   public:
+    size_t writes = 0;
+    size_t bytes = 0;
+
+   protected:
+    int overflow(int c) override {
+        writes++;
+        bytes++;
+        return c;
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        writes++;
+        bytes += n;
+        return n;
+    }
+};
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? std::stoi(argv[1]) : 4000;
+    int count = argc > 2 ? std::stoi(argv[2]) : 3;
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "bench_list";
+    std::filesystem::create_directories(dir);
+    std::string src = (dir / "main.csl").string();
+    std::ofstream(src) << ProgramSource(lines);
+
+    auto env = std::make_unique<cii::CommetIIEnv>(cii::CommetIIEnv::MAX_MEM_SIZE);
+    Builder builder{*env};
+    ass::LineTable dbg_infos;
+    if (!builder.Build({src}, dbg_infos)) return 1;
+
+    // プログラム全体のソースリストをcount回表示する
+    std::string cmds;
+    for (int i = 0; i < count; i++) cmds += "L 0\n";
+    cmds += "Q\n";
+    std::stringstream in{cmds};
+    CountBuf out;
+    std::streambuf* cin_buf = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* cout_buf = std::cout.rdbuf(&out);
+
+    cii::Debugger debug(env->cii_cpu, dbg_infos, env->mem);
+    bench::StopWatch sw;
+    debug.Start();
+    double sec = sw.Elapsed();
+
+    std::cin.rdbuf(cin_buf);
+    std::cout.rdbuf(cout_buf);
+    std::cout << cmn::Format("%u lines x %d listings\n", dbg_infos.Size(), count);
+    std::cout << cmn::Format("time  : %8.2f ms per listing\n", sec / count * 1e3);
+    std::cout << cmn::Format("writes: %8.0f per listing (%zu bytes)\n", (double)out.writes / count, out.bytes / count);
+    return 0;
+}
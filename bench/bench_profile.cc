@@ -0,0 +1,55 @@
+#include <iostream>
+
+#include "bench_common.h"
+#include "common.h"
+#include "profiler.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+/**
+ * @brief 指定回数実行し、1秒あたりのステップ数を返す
+ *
+ * @param profiler 実行プロファイラ(nullptrのときは記録しない)
+ * @param repeat 実行回数
+ * @return double steps/sec
+ */
+double Measure(cii::Profiler* profiler, int repeat) {
+    env.cii_cpu.SetProfiler(profiler);
+
+    uint64_t steps = 0;
+    bench::StopWatch sw;
+    for (int i = 0; i < repeat; i++) {
+        env.cii_cpu.Reset();
+        env.cii_cpu.Run();
+        steps += env.cii_cpu.GetExcutedCounter();
+    }
+    double sec = sw.Elapsed();
+    env.cii_cpu.SetProfiler(nullptr);
+    return steps / sec;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 20000;
+    int repeat = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    if (!bench::Build(env, bench::LoopSource(count))) {
+        std::cerr << "build error" << std::endl;
+        return 1;
+    }
+
+    // プロファイルしないときは各エンジンの実行ループのまま
+    env.cii_cpu.SetEngine(cii::ExecEngine::CALL);
+    double call = Measure(nullptr, repeat);
+    env.cii_cpu.SetEngine(cii::ExecEngine::THREADED);
+    double threaded = Measure(nullptr, repeat);
+    cii::Profiler profiler(env.mem.size);
+    double profiled = Measure(&profiler, repeat);
+
+    std::cout << cmn::Format("call dispatch    : %12.0f steps/sec\n", call);
+    std::cout << cmn::Format("threaded dispatch: %12.0f steps/sec\n", threaded);
+    std::cout << cmn::Format("profiled         : %12.0f steps/sec (x%.2f of call)\n", profiled, profiled / call);
+    std::cout << cmn::Format("recorded steps   : %12llu\n", (unsigned long long)profiler.GetSteps());
+    return 0;
+}
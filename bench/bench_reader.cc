@@ -0,0 +1,172 @@
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "common.h"
+#include "reader.h"
+
+namespace {
+
+/**
+ * @brief 比較用の正規表現によるトークン分割(置き換え前のReader::Parse)
+ */
+class RegexReader {
+    const std::regex reg = std::regex(R"(\s*([^,;'\s]+|,|;|')\s*)");
+    ass::Tokens tokenes;
+
+    static bool IsDigit(const std::string& s) {
+        auto top = s.cbegin() + (s[0] == '-' ? 1 : 0);
+        return top != s.cend() && std::all_of(top, s.cend(), isdigit);
+    }
+    static bool IsHex(const std::string& s) {
+        return s.size() > 1 && s[0] == '#' && std::all_of(s.cbegin() + 1, s.cend(), [](char c) {
+                   return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F');
+               });
+    }
+
+   public:
+    const ass::Tokens& Parse(const std::string& line) {
+        tokenes.clear();
+        enum STRING_MODE { NONE, START, CONTINUE };
+        STRING_MODE st_mode = NONE;
+        std::string string_s;
+        bool check_const_char = false;
+
+        for (std::sregex_iterator it(line.cbegin(), line.cend(), reg), end; it != end; ++it) {
+            auto&& m = *it;
+            if (st_mode == START) {
+                if (m[1].str()[0] == '\'') {
+                    st_mode = CONTINUE;
+                } else {
+                    string_s += m[0].str();
+                }
+                continue;
+            } else if (st_mode == CONTINUE) {
+                if (m[1].str()[0] == '\'') {
+                    st_mode = START;
+                    string_s += '\'';
+                    continue;
+                }
+                if (check_const_char && string_s.size() == 1) {
+                    tokenes.push_back(ass::TokenInfo(ass::TokenId::CONST, string_s[0], "'" + string_s + "'"));
+                } else {
+                    tokenes.push_back(ass::TokenInfo(ass::TokenId::STRING, string_s));
+                }
+                check_const_char = false;
+                st_mode = NONE;
+            }
+            if (auto itr = ass::Reader::key_words.find(m[1].str()); itr != ass::Reader::key_words.end()) {
+                if (itr->second.token_id == ass::TokenId::COMMENT) break;
+                tokenes.push_back(itr->second);
+                continue;
+            }
+            std::string s = m[1].str();
+            if (s[0] == '=') {
+                if (s.size() > 1) {
+                    std::string x{s.begin() + 1, s.end()};
+                    if (IsHex(x)) {
+                        tokenes.push_back(ass::TokenInfo(ass::TokenId::CONST, std::stoi(x.substr(1), nullptr, 16), s));
+                    } else if (IsDigit(x)) {
+                        tokenes.push_back(ass::TokenInfo(ass::TokenId::CONST, std::stoi(x, nullptr, 10), s));
+                    } else {
+                        tokenes.push_back(ass::TokenInfo(ass::TokenId::OTHER, s));
+                    }
+                } else {
+                    check_const_char = true;
+                }
+            } else if (IsHex(s)) {
+                tokenes.push_back(ass::TokenInfo(ass::TokenId::DIGIT, std::stoi(s.substr(1), nullptr, 16)));
+            } else if (IsDigit(s)) {
+                tokenes.push_back(ass::TokenInfo(ass::TokenId::DIGIT, std::stoi(s, nullptr, 10)));
+            } else if (s[0] == '\'') {
+                st_mode = START;
+                string_s = "";
+            } else if (ass::Reader::IsLabel(s)) {
+                tokenes.push_back(ass::TokenInfo(ass::TokenId::LABEL, s));
+            } else {
+                tokenes.push_back(ass::TokenInfo(ass::TokenId::OTHER, s));
+            }
+        }
+        if (st_mode == CONTINUE) {
+            if (check_const_char && string_s.size() == 1) {
+                tokenes.push_back(ass::TokenInfo(ass::TokenId::CONST, string_s[0], "'" + string_s + "'"));
+            } else {
+                tokenes.push_back(ass::TokenInfo(ass::TokenId::STRING, string_s));
+            }
+        }
+        return tokenes;
+    }
+};
+
+/**
+ * @brief 様々な書式を含むCASLIIソースを生成する
+ * @param lines 行数
+ */
+std::vector<std::string> GenerateSource(int lines) {
+    static const char* const templates[] = {
+        "L%d      LD      GR1,DATA%d,GR2",
+        "        ADDA    GR0,=%d",
+        "        LAD     GR3,#%04X   ; コメント %d",
+        "MSG%d    DC      'Hello, World ''%d'' ; not comment'",
+        "        CPA     GR1,='Z'    ;%d",
+        "        JNZ     L%d",
+        "DATA%d  DC      %d,-12,#FF,L1",
+        "        OUT     MSG%d,LEN",
+        "  \tSUBL\tGR%d , GR7\t",
+        "        DS      %d",
+    };
+    std::vector<std::string> src;
+    for (int i = 0; i < lines; i++) {
+        const char* t = templates[i % (sizeof(templates) / sizeof(templates[0]))];
+        src.push_back(cmn::Format(t, i % 8, i));
+    }
+    return src;
+}
+
+bool SameTokens(const ass::Tokens& a, const ass::Tokens& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].token_id != b[i].token_id) return false;
+        auto id = a[i].token_id;
+        if ((id == ass::TokenId::DIGIT || id == ass::TokenId::CONST) && a[i].digit != b[i].digit) return false;
+        if (a[i].label != b[i].label) return false;
+        if (ass::GetTokenClass(id) == ass::OPE_CLASS && a[i].operand_type != b[i].operand_type) return false;
+    }
+    return true;
+}
+
+template <class READER>
+double Measure(READER& reader, const std::vector<std::string>& src, size_t& tokens) {
+    bench::StopWatch sw;
+    tokens = 0;
+    for (auto& line : src) tokens += reader.Parse(line).size();
+    return sw.Elapsed();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? std::stoi(argv[1]) : 100000;
+    std::vector<std::string> src = GenerateSource(lines);
+
+    RegexReader regex_reader;
+    ass::Reader reader;
+    for (auto& line : src) {
+        if (!SameTokens(regex_reader.Parse(line), reader.Parse(line))) {
+            std::cerr << "token mismatch: " << line << std::endl;
+            return 1;
+        }
+    }
+
+    size_t regex_tokens;
+    size_t lexer_tokens;
+    double regex = Measure(regex_reader, src, regex_tokens);
+    double lexer = Measure(reader, src, lexer_tokens);
+
+    std::cout << cmn::Format("regex: %10.0f lines/s (%zu tokens)\n", lines / regex, regex_tokens);
+    std::cout << cmn::Format("lexer: %10.0f lines/s (%zu tokens, x%.1f)\n", lines / lexer, lexer_tokens,
+                             regex / lexer);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <sstream>
+
+#include "bench_common.h"
+#include "common.h"
+#include "tracer.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+/**
+ * @brief 指定回数実行し、1秒あたりのステップ数を返す
+ *
+ * @param tracer 命令トレース(nullptrのときは記録しない)
+ * @param repeat 実行回数
+ * @return double steps/sec
+ */
+double Measure(cii::Tracer* tracer, int repeat) {
+    env.cii_cpu.SetTracer(tracer);
+
+    uint64_t steps = 0;
+    bench::StopWatch sw;
+    for (int i = 0; i < repeat; i++) {
+        env.cii_cpu.Reset();
+        env.cii_cpu.Run();
+        steps += env.cii_cpu.GetExcutedCounter();
+    }
+    double sec = sw.Elapsed();
+    env.cii_cpu.SetTracer(nullptr);
+    return steps / sec;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 20000;
+    int repeat = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    if (!bench::Build(env, bench::LoopSource(count))) {
+        std::cerr << "build error" << std::endl;
+        return 1;
+    }
+
+    env.cii_cpu.SetEngine(cii::ExecEngine::CALL);
+    double call = Measure(nullptr, repeat);
+    cii::Tracer tracer;
+    double traced = Measure(&tracer, repeat);
+    // 全ステップをファイルに書き込むときの1ステップあたりのバイト数
+    std::ostringstream file;
+    cii::Tracer sink_tracer(64 * 1024);
+    sink_tracer.SetSink(&file);
+    double sunk = Measure(&sink_tracer, repeat);
+    sink_tracer.Flush();
+
+    std::cout << cmn::Format("call dispatch    : %12.0f steps/sec\n", call);
+    std::cout << cmn::Format("traced (ring)    : %12.0f steps/sec (x%.2f of call)\n", traced, traced / call);
+    std::cout << cmn::Format("traced (file)    : %12.0f steps/sec (x%.2f of call)\n", sunk, sunk / call);
+    std::cout << cmn::Format("recorded steps   : %12llu\n", (unsigned long long)sink_tracer.GetTotal());
+    std::cout << cmn::Format("bytes/step       : %12.2f\n", (double)file.str().size() / sink_tracer.GetTotal());
+    return 0;
+}
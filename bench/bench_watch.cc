@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <iostream>
+
+#include "bench_common.h"
+#include "common.h"
+
+namespace {
+cii::CommetIIEnv env;
+
+/**
+ * @brief 1回実行し、1秒あたりのステップ数を返す
+ *
+ * @param engine 実行エンジン
+ * @return double steps/sec
+ */
+double Measure(cii::ExecEngine engine) {
+    env.cii_cpu.SetEngine(engine);
+    // ばらつきを抑えるため、3回のうち最も速いものにする
+    double best = 0;
+    for (int i = 0; i < 3; i++) {
+        env.cii_cpu.Reset();
+        bench::StopWatch sw;
+        env.cii_cpu.Run();
+        double sec = sw.Elapsed();
+        best = std::max(best, env.cii_cpu.GetExcutedCounter() / sec);
+    }
+    return best;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+    if (!bench::Build(env, bench::LoopSource(count))) {
+        std::cerr << "build error" << std::endl;
+        return 1;
+    }
+    // プログラムと同じページの末尾と、別のページのアドレス(どちらもアクセスしない)
+    uint16_t near = (uint16_t)(cii::CometII::WATCH_PAGE_WORDS - 1);
+    uint16_t far = (uint16_t)(env.cii_cpu.GetMemory().size - 1);
+
+    for (auto engine : {cii::ExecEngine::CALL, cii::ExecEngine::THREADED}) {
+        const char* name = engine == cii::ExecEngine::CALL ? "call" : "threaded";
+        double none = Measure(engine);
+        // 別のページのウォッチポイントは、ページのビットを見るだけで判定しない
+        env.cii_cpu.SetWatchPoint(far, far, cii::WatchType::ACCESS);
+        double other = Measure(engine);
+        env.cii_cpu.DeleteWatchPoint(far);
+        // 同じページのウォッチポイントは、そのページへのアクセスごとに判定する
+        env.cii_cpu.SetWatchPoint(near, near, cii::WatchType::ACCESS);
+        double same = Measure(engine);
+        env.cii_cpu.DeleteWatchPoint(near);
+
+        std::cout << cmn::Format("%-8s no watch      : %12.0f steps/sec\n", name, none);
+        std::cout << cmn::Format("%-8s other page    : %12.0f steps/sec (x%.2f)\n", name, other, other / none);
+        std::cout << cmn::Format("%-8s same page     : %12.0f steps/sec (x%.2f)\n", name, same, same / none);
+    }
+    // JITはウォッチポイントがあるときはTHREADEDで実行する
+    double jit = Measure(cii::ExecEngine::JIT);
+    env.cii_cpu.SetWatchPoint(far, far, cii::WatchType::ACCESS);
+    double jit_watch = Measure(cii::ExecEngine::JIT);
+    env.cii_cpu.DeleteWatchPoint(far);
+    std::cout << cmn::Format("jit      no watch      : %12.0f steps/sec\n", jit);
+    std::cout << cmn::Format("jit      other page    : %12.0f steps/sec (x%.2f)\n", jit_watch, jit_watch / jit);
+    return 0;
+}
@@ -1,33 +1,39 @@
 #include "assem_mem.h"
 
-#include <list>
+#include <algorithm>
 #include <utility>
 
 #include "comet_ii.h"
+#include "object_module.h"
 
 namespace cii {
 AssmMem::AssmMem(uint32_t msize, WordData *mem, int off) {
     size = msize;
     memory = mem;
     offset = off;
+    overflow = false;
+    modules = 0;
 }
 
 AssmMem &AssmMem::operator<<(OpWord op) {
-    memory[offset++].opword = op;
+    Next().opword = op;
     return *this;
 }
 
 AssmMem &AssmMem::operator<<(SymRef sym) {
-    sym_refs.push_back(std::make_pair(sym.sym_ref, offset));
-    memory[offset++].opword = 0;
+    sym_refs.push_back({sym_table.Intern(sym.sym_ref), (uint16_t)offset, SymTable::NO_ADR, modules});
+    Next().opword = 0;
     return *this;
 }
 
+void AssmMem::DefineSym(const std::string &sym, uint16_t adr) { sym_table.DefineLocal(sym_table.Intern(sym), adr); }
+
 AssmMem &AssmMem::operator<<(SymDef sym) {
-    sym_defs.push_back(std::make_pair(sym.sym_def, offset));
+    DefineSym(sym.sym_def, offset);
     return *this;
 }
 AssmMem &AssmMem::operator<<(SymStart sym) {
+    sym_table.DefineExtern(sym_table.Intern(sym.sym_def), offset);
     sym_externs.push_back(std::make_pair(sym.sym_def, offset));
     return *this;
 }
@@ -39,150 +45,170 @@ AssmMem &AssmMem::operator<<(SymConst sym) {
 }
 
 AssmMem &AssmMem::operator<<(SymDC sym) {
-    sym_defs.push_back(std::make_pair(sym.sym_def, offset));
-    memory[offset++].opword = sym.def_const;
+    DefineSym(sym.sym_def, offset);
+    Next().opword = sym.def_const;
     return *this;
 }
 AssmMem &AssmMem::operator<<(SymDS sym) {
-    sym_defs.push_back(std::make_pair(sym.sym_def, offset));
+    DefineSym(sym.sym_def, offset);
 
     for (int i = 0; i < sym.ds_size; i++) {
-        memory[offset++].opword = 0;
+        Next().opword = 0;
     }
     return *this;
 }
 
 AssmMem &AssmMem::operator<<(DcDef dc_def) {
-    memory[offset++].opword = dc_def.value;
+    Next().opword = dc_def.value;
     return *this;
 }
 
 AssmMem &AssmMem::operator<<(DsDef ds_def) {
     for (int i = 0; i < ds_def.value; i++) {
-        memory[offset++].opword = 0;
+        Next().opword = 0;
     }
     return *this;
 }
 
 AssmMem &AssmMem::operator<<(uint16_t v) {
-    memory[offset++].opword = v;
+    Next().opword = v;
     return *this;
 }
 
 AssmMem &AssmMem::operator<<(int v) {
-    memory[offset++].opword = v;
+    Next().opword = v;
     return *this;
 }
 
 AssmMem &AssmMem::operator<<(const char *str) {
     while (*str != '\0') {
-        memory[offset++].opword = *str++;
+        Next().opword = *str++;
     }
     return *this;
 }
 
 void AssmMem::Clear() {
     offset = 0;
-    sym_defs.clear();
+    overflow = false;
+    sym_table.Clear();
+    sym_externs.clear();
     sym_refs.clear();
+    link_refs.clear();
     sym_consts.clear();
-    sym_externs.clear();
-    syms.clear();
+    unresolved.clear();
+    modules = 0;
     ClearMem();
 }
 
 uint16_t AssmMem::FindSym(std::string sym) const {
-    if (auto itr = std::find_if(sym_externs.begin(), sym_externs.end(), [&](SymValue v) { return v.first == sym; });
-        itr != sym_externs.end()) {
-        return itr->second;
-    }
+    uint32_t id = sym_table.Find(sym);
+    if (id == SymTable::NO_SYM) return UINT16_MAX;
 
-    if (syms.size() == 0) {
-        if (auto itr = std::find_if(sym_defs.begin(), sym_defs.end(), [&](SymValue v) { return v.first == sym; });
-            itr != sym_defs.end()) {
-            return itr->second;
-        }
-    } else {
-        for (auto [defs, refs] : syms) {
-            if (auto itr = std::find_if(defs.begin(), defs.end(), [&](SymValue v) { return v.first == sym; });
-                itr != defs.end()) {
-                return itr->second;
-            }
-        }
-    }
-    return UINT16_MAX;
+    int32_t adr = ResolveSym(id);
+    return adr != SymTable::NO_ADR ? adr : UINT16_MAX;
 }
 
-bool AssmMem::LinkSym(std::vector<SymValue> &defs, std::vector<SymValue> &refs) {
-    int find_count = 0;
+int32_t AssmMem::ResolveSym(uint32_t id) const {
+    if (int32_t adr = sym_table.Extern(id); adr != SymTable::NO_ADR) return adr;
+    // モジュールを終了したあとは、最初に定義したモジュールのシンボル
+    return modules == 0 ? sym_table.Local(id) : sym_table.First(id);
+}
 
-    for (auto &ref : refs) {
-        // externシンボル
-        if (auto itr = std::find_if(sym_externs.begin(), sym_externs.end(),
-                                    [&ref](SymValue sym) { return ref.first == sym.first; });
-            itr != sym_externs.end()) {
-            memory[ref.second].data = itr->second;
-            find_count++;
-            continue;
-        }
-        // localシンボル
-        if (auto itr = std::find_if(defs.begin(), defs.end(), [&ref](SymValue sym) { return ref.first == sym.first; });
-            itr != defs.end()) {
-            memory[ref.second].data = itr->second;
-            find_count++;
-        }
+std::vector<SymValue> AssmMem::GetSyms() const {
+    std::vector<SymValue> syms;
+    for (uint32_t id = 0; id < sym_table.Size(); id++) {
+        if (int32_t adr = ResolveSym(id); adr != SymTable::NO_ADR) syms.emplace_back(sym_table.Name(id), adr);
     }
-    return refs.size() == find_count;
+    return syms;
 }
 
-bool AssmMem::CheckSym(std::string &sym_name) {
-    // externシンボル
-    if (auto itr = std::find_if(sym_externs.begin(), sym_externs.end(),
-                                [&sym_name](SymValue sym) { return sym_name == sym.first; });
-        itr != sym_externs.end()) {
-        return false;
-    }
-    // localシンボル
-    if (auto itr =
-            std::find_if(sym_defs.begin(), sym_defs.end(), [&sym_name](SymValue sym) { return sym_name == sym.first; });
-        itr != sym_defs.end()) {
-        return false;
-    }
-    return true;
+bool AssmMem::CheckSym(const std::string &sym_name) const {
+    uint32_t id = sym_table.Find(sym_name);
+    if (id == SymTable::NO_SYM) return true;
+
+    // externシンボル、localシンボル
+    return sym_table.Extern(id) == SymTable::NO_ADR && sym_table.Local(id) == SymTable::NO_ADR;
 }
 
 void AssmMem::SnapShot() {
-    syms.push_back(std::make_pair(sym_defs, sym_refs));
-
-    sym_defs.clear();
+    // localシンボルはモジュールを終了すると引けなくなるため、ここで引いておく
+    for (auto &ref : sym_refs) {
+        ref.local = sym_table.Local(ref.id);
+        link_refs.push_back(ref);
+    }
     sym_refs.clear();
+    sym_table.EndModule();
+    modules++;
+}
+
+void AssmMem::Export(ObjectModule &module) const {
+    module.words.resize(std::min<uint32_t>(offset, size));
+    for (size_t i = 0; i < module.words.size(); i++) module.words[i] = memory[i].data;
+    module.overflow = overflow;
+
+    module.locals.clear();
+    for (uint32_t id : sym_table.GetLocalIds()) {
+        module.locals.push_back(std::make_pair(sym_table.Name(id), (uint16_t)sym_table.Local(id)));
+    }
+    module.externs = sym_externs;
+    module.refs.clear();
+    for (auto &ref : sym_refs) module.refs.push_back(std::make_pair(sym_table.Name(ref.id), ref.offset));
+    module.consts = sym_consts;
+}
+
+void AssmMem::Append(const ObjectModule &module) {
+    uint16_t base = (uint16_t)offset;
+    for (uint16_t w : module.words) Next().data = w;
+    // メモリサイズを超えたモジュールは、超えた分も出力したことにする
+    if (module.overflow) {
+        overflow = true;
+        offset = (int)size + 1;
+    }
+
+    for (auto &local : module.locals) DefineSym(local.first, base + local.second);
+    for (auto &ext : module.externs) {
+        sym_table.DefineExtern(sym_table.Intern(ext.first), base + ext.second);
+        sym_externs.push_back(std::make_pair(ext.first, (uint16_t)(base + ext.second)));
+    }
+    for (auto &ref : module.refs) {
+        sym_refs.push_back({sym_table.Intern(ref.first), (uint16_t)(base + ref.second), SymTable::NO_ADR, modules});
+    }
+    sym_consts.insert(sym_consts.end(), module.consts.begin(), module.consts.end());
 }
 
 bool AssmMem::End() {
     // 定数で重複しているものを削除
-    std::sort(sym_consts.begin(), sym_consts.end(), [](SymValue s, SymValue d) { return s.first < d.first; });
+    std::sort(sym_consts.begin(), sym_consts.end());
     sym_consts.erase(std::unique(sym_consts.begin(), sym_consts.end()), sym_consts.end());
     // 定数を登録
     for (auto &&key : sym_consts) {
+        sym_table.DefineExtern(sym_table.Intern(key.first), offset);
         sym_externs.push_back(std::make_pair(key.first, offset));
         operator<<(key.second);
     }
-
-    bool link_ok = true;
-    if (syms.size() > 0) {
-        for (auto [defs, refs] : syms) {
-            if (!LinkSym(defs, refs)) link_ok = false;
+    if (overflow) return false;
+
+    // SnapShotしていない参照は1つのモジュールとして扱う
+    if (modules == 0 || !sym_refs.empty()) SnapShot();
+
+    // 参照ごとに1回だけ引く。externシンボルを優先する
+    unresolved.clear();
+    for (auto &ref : link_refs) {
+        int32_t adr = sym_table.Extern(ref.id);
+        if (adr == SymTable::NO_ADR) adr = ref.local;
+        if (adr == SymTable::NO_ADR) {
+            unresolved.push_back({ref.module, ref.offset});
+            continue;
         }
-    } else {
-        if (!LinkSym(sym_defs, sym_refs)) link_ok = false;
+        memory[ref.offset].data = (uint16_t)adr;
     }
-
-    return link_ok;
+    return unresolved.empty();
 }
 
 void AssmMem::ClearMem() {
+    // 0のワードには書き込まない(未使用のページを割り当てないため)
     for (size_t i = 0; i < size; i++) {
-        memory[i].data = 0;
+        if (memory[i].data != 0) memory[i].data = 0;
     }
 }
 }  // namespace cii
@@ -4,12 +4,16 @@
 #include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "comet_ii.h"
+#include "sym_table.h"
 
 namespace cii {
+struct ObjectModule;
+
 struct SymDef {
     std::string sym_def;
     SymDef(const std::string &sym) : sym_def(sym) {}
@@ -78,6 +82,13 @@ T &operator<<(T &mem, Halt) {
     return mem;
 }
 using SymValue = std::pair<std::string, uint16_t>;
+/**
+ * @brief 未解決のシンボル参照
+ */
+struct SymUnresolved {
+    uint32_t module;  //!< モジュール番号(SnapShotの順)
+    uint16_t offset;  //!< 参照位置
+};
 
 /**
  * @brief メモリクラス
@@ -85,13 +96,26 @@ using SymValue = std::pair<std::string, uint16_t>;
  */
 class AssmMem : public Memory {
    private:
-    std::vector<SymValue> sym_defs;     //!< シンボル定義
-    std::vector<SymValue> sym_externs;  //!< 外部シンボル
-    std::vector<SymValue> sym_refs;     //!< シンボル参照
-    std::vector<SymValue> sym_consts;   //!< コンスタント　シンボル
+    /**
+     * @brief シンボル参照
+     */
+    struct SymRefEntry {
+        uint32_t id;      //!< シンボル番号
+        uint16_t offset;  //!< 参照位置
+        int32_t local;    //!< モジュール内のローカルシンボルのアドレス
+        uint32_t module;  //!< モジュール番号
+    };
 
-    std::vector<std::pair<std::vector<SymValue>, std::vector<SymValue>>> syms;
-    int offset;  //!< アセンブル出力最終位置
+    SymTable sym_table;                     //!< シンボル表
+    std::vector<SymValue> sym_externs;      //!< 外部シンボル(定義順)
+    std::vector<SymRefEntry> sym_refs;      //!< アセンブル中のモジュールのシンボル参照
+    std::vector<SymRefEntry> link_refs;     //!< 終了したモジュールのシンボル参照
+    std::vector<SymValue> sym_consts;       //!< コンスタント　シンボル
+    std::vector<SymUnresolved> unresolved;  //!< 未解決のシンボル参照
+    uint32_t modules;                       //!< 終了したモジュール数
+    int offset;      //!< アセンブル出力最終位置
+    bool overflow;   //!< メモリサイズを超えて出力した
+    WordData spill;  //!< メモリサイズを超えた出力の書き込み先
 
    public:
     AssmMem() = delete;
@@ -102,7 +126,7 @@ class AssmMem : public Memory {
      * @brief アセンブル終了。シンボルのリンクを行う。
      *
      * @return true リンク成功
-     * @return false リンクエラー
+     * @return false リンクエラー、またはメモリサイズを超えた
      */
     bool End();
     /**
@@ -205,9 +229,9 @@ class AssmMem : public Memory {
 
     // for DEBUG
     uint16_t Dump(const char *sym, uint16_t &m, int offset = 0) {
-        auto itr = std::find_if(sym_defs.begin(), sym_defs.end(), [&](SymValue s) { return s.first == sym; });
-        if (itr != sym_defs.end()) {
-            m = memory[itr->second + offset];
+        uint16_t adr = FindSym(sym);
+        if (adr != UINT16_MAX) {
+            m = memory[adr + offset];
             return true;
         }
         return false;
@@ -224,9 +248,13 @@ class AssmMem : public Memory {
     /**
      * @brief Get the Offset object
      * アセンブルの出力位置を取得する。
-     * @return uint16_t
+     * @return uint32_t
+     */
+    uint32_t GetOffset() const { return offset; }
+    /**
+     * @brief メモリサイズを超えて出力したかどうかを返す
      */
-    uint16_t GetOffset() const { return offset; }
+    bool IsOverflow() const { return overflow; }
     /**
      * @brief シンボルのoffsetを取得する
      *
@@ -235,14 +263,73 @@ class AssmMem : public Memory {
      */
     uint16_t FindSym(std::string sym) const;
     const std::vector<SymValue> &GetSymExtern() const { return sym_externs; }
-    const auto &GetSyms() const { return syms; }
+    /**
+     * @brief FindSymで引けるすべてのシンボルとアドレスを取得する
+     */
+    std::vector<SymValue> GetSyms() const;
+    /**
+     * @brief リンク済みのシンボルを定義する
+     * @param sym シンボル
+     * @param adr アドレス
+     * @note
+     * 実行イメージから読み込んだシンボルをFindSymで引けるようにする
+     */
+    void DefineLinkedSym(const std::string &sym, uint16_t adr) { sym_table.DefineExtern(sym_table.Intern(sym), adr); }
+    /**
+     * @brief Endで解決できなかったシンボル参照を取得する
+     */
+    const std::vector<SymUnresolved> &GetUnresolved() const { return unresolved; }
 
+    /**
+     * @brief モジュール(ファイル)のアセンブルを終了する
+     * @note
+     * モジュール内のシンボル参照はここでローカルシンボルを引いておき、Endで外部シンボルとあわせて解決する
+     */
     void SnapShot();
-    bool CheckSym(std::string &sym_name);
+    /**
+     * @brief アセンブル中のモジュールをオブジェクトモジュールに取り出す
+     *
+     * @param module 出力先。コードとシンボルを設定する
+     * @note
+     * 0番地からアセンブルし、SnapShot、Endをする前に呼び出す
+     */
+    void Export(ObjectModule &module) const;
+    /**
+     * @brief オブジェクトモジュールを出力位置に再配置して追加する
+     *
+     * @param module オブジェクトモジュール
+     * @note
+     * モジュール内のシンボル定義と参照の位置は出力位置だけずらす。追加したあとにSnapShotを呼び出すこと
+     */
+    void Append(const ObjectModule &module);
+    /**
+     * @brief シンボルを定義できるかチェックする
+     * @param sym_name シンボル
+     * @return false 外部シンボルかモジュール内で定義済み
+     */
+    bool CheckSym(const std::string &sym_name) const;
 
    private:
+    /**
+     * @brief 次の出力位置のワードを取得する
+     * @return WordData& 出力先。メモリサイズを超えたときはspill
+     */
+    inline WordData &Next() {
+        if (offset < (int)size) return memory[offset++];
+        overflow = true;
+        offset++;
+        return spill;
+    }
     void Clear();
-    bool LinkSym(std::vector<SymValue> &def, std::vector<SymValue> &ref);
+    /**
+     * @brief シンボルのアドレスを取得する
+     * @return int32_t アドレス、未定義のときはSymTable::NO_ADR
+     */
+    int32_t ResolveSym(uint32_t id) const;
+    /**
+     * @brief モジュール内のシンボルを定義する
+     */
+    void DefineSym(const std::string &sym, uint16_t adr);
 };
 
 }  // namespace cii
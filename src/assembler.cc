@@ -56,18 +56,15 @@ void Assembler::Assemble(std::string line, cii::AssmMem& asem) {
 
     uint16_t start_offset = asem.GetOffset();
 
-    auto tokens2 = tokens;
     Assemble(tokens, asem);
-    DbgInfo dbg_info{line, error, false, start_offset, asem.GetOffset(), std::move(tokens2)};
-
-    dbg_infos.push_back(dbg_info);
+    dbg_infos.Add(line, error, start_offset, (uint16_t)asem.GetOffset());
 }
 
 void Assembler::Assemble(std::stringstream& ss, cii::AssmMem& asem) {
     std::string line;
 
     is_error = false;
-    dbg_infos.clear();
+    dbg_infos.Clear();
 
     while (std::getline(ss, line)) {
         Assemble(line, asem);
@@ -78,7 +75,7 @@ void Assembler::Assemble(std::ifstream& ss, cii::AssmMem& asem) {
     std::string line;
 
     is_error = false;
-    dbg_infos.clear();
+    dbg_infos.Clear();
 
     while (std::getline(ss, line)) {
         Assemble(line, asem);
@@ -7,21 +7,11 @@
 
 #include "assem_mem.h"
 #include "comet_ii.h"
+#include "line_table.h"
 #include "reader.h"
 
 namespace ass {
 
-enum class AsmErrCode {
-    OK,
-    NO_OPERATION,     //<! 命令コードがない
-    NO_OPERAND,       //<! オペランドがない
-    INVALID_OPERAND,  //<! 余計なオペランド
-    NO_DC_OR_DS,      //<! 定数、文字列が指定されたがDC,DSが宣言されていない
-    NO_DEF_SYM,       //<! シンボルの定義が見つからない
-    MULTI_DEF_SYM,    //<! シンボル多重定義
-    ERR,              //!< その他のエラー
-};
-
 struct OpInfo {
     OperandType operand_type;
     cii::OpCode opcode1;
@@ -30,17 +20,6 @@ struct OpInfo {
         : operand_type(ot), opcode1(op1), opcode2(op2) {}
 };
 
-struct DbgInfo {
-    std::string line;
-    AsmErrCode err;
-    bool is_break;
-    uint16_t start_offset;
-    uint16_t end_offset;
-    ass::Tokens tokens;
-};
-
-using DbgInfos = std::vector<DbgInfo>;
-
 /**
  * アセンブラクラス
  */
@@ -50,7 +29,7 @@ class Assembler {
    public:
     AsmErrCode error = AsmErrCode::OK;
     int number = 0;
-    DbgInfos dbg_infos;
+    LineTable dbg_infos;
     bool is_error = false;
 
     Assembler();
@@ -0,0 +1,121 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "batch_runner.h"
+#include "common.h"
+#include "conf.h"
+#include "tracer.h"
+
+namespace {
+//! ワーカー数の上限
+constexpr uint32_t MAX_WORKERS = 1024;
+
+void Usage() {
+    std::cerr << "使い方: casl_batch [-j ワーカー数] [--max-steps 最大命令数] [-m メモリワードサイズ]"
+                 " [--profile 出力ディレクトリ] [--trace 出力ディレクトリ] マニフェスト\n"
+              << "        casl_batch --dump-trace トレースファイル\n"
+              << "  マニフェストの各行: ソース1 [ソース2 ...] < 入力ファイル > 期待出力ファイル\n";
+}
+
+/**
+ * @brief 数値のオプションを変換する
+ *
+ * @param s オプション値
+ * @param min 最小値
+ * @param max 最大値
+ * @param value 変換した値
+ * @return true 成功
+ */
+bool ParseNumber(const std::string& s, uint32_t min, uint32_t max, uint32_t& value) {
+    if (s.empty() || s.size() > 10 || s.find_first_not_of("0123456789") != std::string::npos) return false;
+    uint64_t v = std::stoull(s);
+    if (v < min || v > max) return false;
+    value = static_cast<uint32_t>(v);
+    return true;
+}
+
+/**
+ * @brief トレースファイルをテキストで表示する
+ * @return int 終了コード
+ */
+int DumpTrace(const std::string& file) {
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open()) {
+        std::cerr << "ファイルのオープンに失敗しました:" << file << std::endl;
+        return 2;
+    }
+    bool ok = cii::Tracer::ReadFile(ifs, [](const cii::TraceStep& step) {
+        cii::Tracer::Print(std::cout, step);
+        std::cout << "\n";
+    });
+    if (!ok) {
+        std::cerr << "トレースファイルではありません:" << file << std::endl;
+        return 2;
+    }
+    return 0;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    uint32_t workers = 0;
+    uint32_t max_steps = cii::BatchRunner::DEFAULT_MAX_STEPS;
+    uint32_t mem_size = cii::CommetIIEnv::DEFAULT_MEM_SIZE;
+    std::string manifest;
+    std::string profile_dir;
+    std::string trace_dir;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            if (!ParseNumber(argv[++i], 0, MAX_WORKERS, workers)) {
+                std::cerr << cmn::Format("-j: ワーカー数は0から%uで指定してください(0のときはハードウェアスレッド数)。\n",
+                                         MAX_WORKERS);
+                Usage();
+                return 2;
+            }
+        } else if (arg == "--max-steps" && i + 1 < argc) {
+            if (!ParseNumber(argv[++i], 1, UINT32_MAX, max_steps)) {
+                std::cerr << cmn::Format("--max-steps: 最大命令数は1から%uで指定してください。\n", UINT32_MAX);
+                Usage();
+                return 2;
+            }
+        } else if (arg == "-m" && i + 1 < argc) {
+            if (!ParseNumber(argv[++i], 1, cii::CommetIIEnv::MAX_MEM_SIZE, mem_size)) {
+                std::cerr << cmn::Format("-m: メモリワードサイズは1から%uで指定してください。\n",
+                                         cii::CommetIIEnv::MAX_MEM_SIZE);
+                Usage();
+                return 2;
+            }
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profile_dir = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_dir = argv[++i];
+        } else if (arg == "--dump-trace" && i + 1 < argc) {
+            return DumpTrace(argv[++i]);
+        } else if (manifest.empty() && arg[0] != '-') {
+            manifest = arg;
+        } else {
+            Usage();
+            return 2;
+        }
+    }
+    if (manifest.empty()) {
+        Usage();
+        return 2;
+    }
+
+    std::ifstream ifs(manifest);
+    if (!ifs.is_open()) {
+        std::cerr << "ファイルのオープンに失敗しました:" << manifest << std::endl;
+        return 2;
+    }
+    std::vector<cii::BatchProgram> programs;
+    if (!cii::BatchRunner::ReadManifest(ifs, programs)) return 2;
+
+    cii::BatchRunner runner{workers, max_steps, mem_size};
+    runner.SetProfileDir(profile_dir);
+    runner.SetTraceDir(trace_dir);
+    return runner.Run(programs, std::cout) ? 0 : 1;
+}
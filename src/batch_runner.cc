@@ -0,0 +1,257 @@
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "builder.h"
+#include "common.h"
+#include "conf.h"
+#include "input_arena.h"
+#include "profiler.h"
+#include "program_image.h"
+#include "tracer.h"
+#include "work_pool.h"
+
+namespace cii {
+namespace {
+//! ケースごとの命令トレースのリングバッファのバイト数
+constexpr size_t TRACE_BUFFER_SIZE = 64 * 1024;
+
+/**
+ * @brief ワーカーごとのプロファイラ
+ */
+struct WorkerProfile {
+    static constexpr size_t NONE = SIZE_MAX;  //!< 記録中のプログラムなし
+
+    std::unique_ptr<Profiler> profiler;  //!< 記録中のプログラムのケースを合計するプロファイラ
+    size_t program = NONE;               //!< 記録中のプログラム
+};
+
+/**
+ * @brief JSON文字列として出力する
+ */
+std::string JsonString(const std::string &s) {
+    std::string json = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            json += '\\';
+            json += c;
+        } else if ((unsigned char)c < 0x20) {
+            json += cmn::Format("\\u%04x", c);
+        } else {
+            json += c;
+        }
+    }
+    return json + "\"";
+}
+
+bool ReadFile(const std::string &file, std::string &contents) {
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open()) return false;
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    contents = ss.str();
+    return true;
+}
+
+/**
+ * @brief 1ケースを実行する
+ * @param env ワーカーのcommetII環境
+ * @param image プログラムイメージ
+ * @param c 採点ケース
+ * @param max_steps 最大命令数
+ * @param profiler 実行プロファイラ(nullptrのときは記録しない)
+ * @param trace_file 命令トレースの出力先(空のときは記録しない)
+ */
+BatchResult RunCase(CommetIIEnv &env, const ProgramImage &image, const BatchCase &c, uint32_t max_steps,
+                    Profiler *profiler, const std::string &trace_file) {
+    InputArena in;
+    std::string expect;
+    if (!in.Load(c.input_file) || !ReadFile(c.expect_file, expect)) {
+        return {"error", CauseOfStop::OK, 0, 0};
+    }
+
+    std::stringstream out;
+    env.cii_cpu.SetSvcIn(in);
+    env.cii_cpu.SetSvcOut(out);
+    image.Fork(env.cii_cpu);
+
+    // トレースは埋まったブロックから書き込むため、リングバッファは小さくてよい
+    std::ofstream trace_out;
+    std::unique_ptr<Tracer> tracer;
+    if (!trace_file.empty()) {
+        trace_out.open(trace_file, std::ios::binary);
+        if (!trace_out.is_open()) return {"error", CauseOfStop::OK, 0, 0};
+        tracer = std::make_unique<Tracer>(TRACE_BUFFER_SIZE);
+        tracer->SetSink(&trace_out);
+    }
+
+    env.cii_cpu.SetProfiler(profiler);
+    env.cii_cpu.SetTracer(tracer.get());
+    auto start = std::chrono::steady_clock::now();
+    RunResult run = env.cii_cpu.RunFor(max_steps);
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    env.cii_cpu.SetProfiler(nullptr);
+    env.cii_cpu.SetTracer(nullptr);
+    if (profiler) profiler->EndRun();
+    if (tracer) tracer->Flush();
+
+    // STARTからのRETもHALTで停止する。STACK_UNDERFLOWは正常終了ではない
+    bool finished = run.cause == CauseOfStop::HALT;
+    bool pass = finished && out.str() == expect;
+    return {pass ? "pass" : "fail", run.cause, run.steps, sec};
+}
+}  // namespace
+
+bool BatchRunner::ReadManifest(std::istream &is, std::vector<BatchProgram> &programs, std::ostream &err) {
+    std::string line;
+    int line_num = 0;
+    while (std::getline(is, line)) {
+        line_num++;
+        std::stringstream ss{line};
+        std::vector<std::string> files;
+        BatchCase c;
+        std::string word;
+        while (ss >> word && word != "<") {
+            if (word[0] == '#' && files.empty()) break;
+            files.push_back(word);
+        }
+        if (files.empty()) continue;
+
+        if (word != "<" || !(ss >> c.input_file) || !(ss >> word) || word != ">" || !(ss >> c.expect_file) ||
+            (ss >> word)) {
+            err << "manifest:" << line_num << ": 'ソース ... < 入力ファイル > 期待出力ファイル' の形式ではありません"
+                << std::endl;
+            return false;
+        }
+
+        auto itr = std::find_if(programs.begin(), programs.end(),
+                                [&files](const BatchProgram &p) { return p.files == files; });
+        if (itr == programs.end()) {
+            programs.push_back({files, {}});
+            itr = programs.end() - 1;
+        }
+        itr->cases.push_back(c);
+    }
+    return true;
+}
+
+bool BatchRunner::Run(const std::vector<BatchProgram> &programs, std::ostream &out) {
+    // アセンブルはプログラムごとに1回だけ行う
+    std::vector<std::shared_ptr<const ProgramImage>> images(programs.size());
+    {
+        auto build_env = std::make_unique<CommetIIEnv>(mem_size);
+        // Builderのエラー表示で結果の出力を汚さないように、標準エラー出力に切り替える
+        cmn::CoutToCerr diag;
+        for (size_t i = 0; i < programs.size(); i++) {
+            Builder builder{*build_env};
+            images[i] = builder.BuildImage(programs[i].files);
+        }
+    }
+
+    if (!trace_dir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(trace_dir, ec);
+    }
+
+    cmn::WorkPool pool(workers);
+    std::vector<std::unique_ptr<CommetIIEnv>> envs(pool.GetWorkers());
+    std::vector<std::vector<BatchResult>> results(programs.size());
+    // プロファイルはワーカーごとに同じプログラムのケースを続けて記録し、
+    // 別のプログラムのケースを実行する前と全ケースの実行後に、プログラムの合計に足し込む
+    std::vector<WorkerProfile> worker_profiles(pool.GetWorkers());
+    std::vector<std::unique_ptr<Profiler>> totals(programs.size());
+    std::mutex totals_mtx;
+    auto flush = [&](WorkerProfile &wp) {
+        if (wp.program == WorkerProfile::NONE) return;
+        std::lock_guard<std::mutex> lock(totals_mtx);
+        std::unique_ptr<Profiler> &total = totals[wp.program];
+        if (!total) total = std::make_unique<Profiler>(mem_size);
+        total->Merge(*wp.profiler);
+        wp.profiler->Clear();
+        wp.program = WorkerProfile::NONE;
+    };
+    for (size_t i = 0; i < programs.size(); i++) {
+        results[i].resize(programs[i].cases.size(), {"error", CauseOfStop::OK, 0, 0});
+        if (!images[i]) continue;
+
+        for (size_t j = 0; j < programs[i].cases.size(); j++) {
+            pool.Push([&, i, j](unsigned worker) {
+                // commetII環境はワーカーごとに1つ
+                if (!envs[worker]) envs[worker] = std::make_unique<CommetIIEnv>(mem_size);
+                Profiler *profiler = nullptr;
+                if (!profile_dir.empty()) {
+                    WorkerProfile &wp = worker_profiles[worker];
+                    if (wp.program != i) flush(wp);
+                    if (!wp.profiler) wp.profiler = std::make_unique<Profiler>(mem_size);
+                    wp.program = i;
+                    profiler = wp.profiler.get();
+                }
+                std::string trace_file;
+                if (!trace_dir.empty()) {
+                    std::string name = cmn::Format("program%zu_case%zu.trace", i + 1, j + 1);
+                    trace_file = (std::filesystem::path(trace_dir) / name).string();
+                }
+                results[i][j] =
+                    RunCase(*envs[worker], *images[i], programs[i].cases[j], max_steps, profiler, trace_file);
+            });
+        }
+    }
+    pool.Run();
+
+    if (!profile_dir.empty()) {
+        for (auto &wp : worker_profiles) flush(wp);
+        WriteProfiles(programs, images, totals);
+    }
+
+    bool all_pass = true;
+    for (size_t i = 0; i < programs.size(); i++) {
+        std::string program;
+        for (auto &file : programs[i].files) program += (program.empty() ? "" : " ") + file;
+
+        for (size_t j = 0; j < programs[i].cases.size(); j++) {
+            const BatchCase &c = programs[i].cases[j];
+            const BatchResult &r = results[i][j];
+            out << "{\"program\":" << JsonString(program) << ",\"input\":" << JsonString(c.input_file)
+                << ",\"expect\":" << JsonString(c.expect_file) << ",\"result\":\"" << r.result << "\",\"cause\":\""
+                << GetCauseName(r.cause) << "\",\"steps\":" << r.steps
+                << cmn::Format(",\"time_ms\":%.3f}", r.sec * 1000) << "\n";
+            if (std::string(r.result) != "pass") all_pass = false;
+        }
+    }
+    out.flush();
+    return all_pass;
+}
+
+void BatchRunner::WriteProfiles(const std::vector<BatchProgram> &programs,
+                                const std::vector<std::shared_ptr<const ProgramImage>> &images,
+                                const std::vector<std::unique_ptr<Profiler>> &totals) const {
+    std::error_code ec;
+    std::filesystem::create_directories(profile_dir, ec);
+    // ケースを実行しなかったプログラムは空のプロファイルを出力する
+    Profiler empty(mem_size);
+    for (size_t i = 0; i < programs.size(); i++) {
+        if (!images[i]) continue;
+
+        const Profiler &total = totals[i] ? *totals[i] : empty;
+
+        std::string base = (std::filesystem::path(profile_dir) / cmn::Format("program%zu", i + 1)).string();
+        std::ofstream report(base + ".txt");
+        std::ofstream folded(base + ".folded");
+        if (!report.is_open() || !folded.is_open()) {
+            std::cerr << "プロファイルを書き込めません:" << base << std::endl;
+            continue;
+        }
+        for (auto &file : programs[i].files) report << file << " ";
+        report << "(" << programs[i].cases.size() << " cases)\n";
+        total.Report(report, images[i]->GetDbgInfos(), images[i]->GetSyms());
+        total.WriteFolded(folded, images[i]->GetSyms());
+    }
+}
+
+}  // namespace cii
@@ -0,0 +1,111 @@
+#ifndef BATCH_RUNNER_H_
+#define BATCH_RUNNER_H_
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "comet_ii.h"
+#include "conf.h"
+
+namespace cii {
+
+class Profiler;
+class ProgramImage;
+
+/**
+ * @brief 採点ケース
+ */
+struct BatchCase {
+    std::string input_file;   //!< 標準入力(SVC IN)のファイル
+    std::string expect_file;  //!< 期待する標準出力(SVC OUT)のファイル
+};
+
+/**
+ * @brief 採点プログラム
+ */
+struct BatchProgram {
+    std::vector<std::string> files;  //!< ソースファイル
+    std::vector<BatchCase> cases;    //!< 採点ケース
+};
+
+/**
+ * @brief 採点結果
+ */
+struct BatchResult {
+    const char *result;  //!< "pass", "fail", "error"
+    CauseOfStop cause;   //!< 停止要因
+    uint32_t steps;      //!< 実行した命令数
+    double sec;          //!< 実行時間
+};
+
+/**
+ * @class
+ * 複数プログラム、複数ケースの一括採点
+ * @note
+ * プログラムは1回だけアセンブルし、ケースはワーカーごとのCometIIで並列に実行する。
+ */
+class BatchRunner {
+    unsigned workers;         //!< ワーカー数(0のときはハードウェアスレッド数)
+    uint32_t max_steps;       //!< 1ケースの最大命令数
+    uint32_t mem_size;        //!< メモリワードサイズ
+    std::string profile_dir;  //!< プロファイルの出力先(空のときはプロファイルしない)
+    std::string trace_dir;    //!< トレースの出力先(空のときはトレースしない)
+
+   public:
+    //! 1ケースの最大命令数の既定値
+    static constexpr uint32_t DEFAULT_MAX_STEPS = 10000000;
+
+    BatchRunner(unsigned workers = 0, uint32_t max_steps = DEFAULT_MAX_STEPS, uint32_t mem_size = CommetIIEnv::DEFAULT_MEM_SIZE)
+        : workers(workers), max_steps(max_steps), mem_size(mem_size) {}
+
+    /**
+     * @brief プロファイルを有効にする
+     * @param dir 出力先ディレクトリ
+     * @note
+     * プログラムごとに全ケースの記録を合計し、program<番号>.txtに実行回数の多い行などを、
+     * program<番号>.foldedにflamegraphのfolded形式を出力する。番号はマニフェストに現れた順(1から)
+     */
+    void SetProfileDir(const std::string &dir) { profile_dir = dir; }
+    /**
+     * @brief 命令トレースを有効にする
+     * @param dir 出力先ディレクトリ
+     * @note
+     * ケースごとに全命令のトレースをprogram<番号>_case<番号>.traceに書き込む。番号はマニフェストに現れた順(1から)。
+     * 内容はTracer::ReadFileで復元する
+     */
+    void SetTraceDir(const std::string &dir) { trace_dir = dir; }
+    /**
+     * @brief マニフェストを読み込む
+     * @param is マニフェスト
+     * @param programs 採点プログラム。ソースファイルが同じ行は1つのプログラムにまとめる
+     * @param err エラーメッセージの出力先
+     * @return true 成功
+     * @note
+     * 1行に1ケースを "ソース1 [ソース2 ...] < 入力ファイル > 期待出力ファイル" の形式で記述する。
+     * 空行と'#'で始まる行は読み飛ばす。
+     */
+    static bool ReadManifest(std::istream &is, std::vector<BatchProgram> &programs, std::ostream &err = std::cerr);
+    /**
+     * @brief すべてのケースを実行し、結果をケースごとにJSON Linesで出力する
+     * @param programs 採点プログラム
+     * @param out 結果の出力先
+     * @return true すべてのケースが成功
+     * @note
+     * アセンブルエラーは標準エラー出力に表示する
+     */
+    bool Run(const std::vector<BatchProgram> &programs, std::ostream &out);
+
+   private:
+    /**
+     * @brief プログラムごとに全ケースを合計したプロファイルをファイルに出力する
+     * @param totals プログラムごとの合計(ケースを実行しなかったプログラムはnullptr)
+     */
+    void WriteProfiles(const std::vector<BatchProgram> &programs,
+                       const std::vector<std::shared_ptr<const ProgramImage>> &images,
+                       const std::vector<std::unique_ptr<Profiler>> &totals) const;
+};
+
+}  // namespace cii
+#endif
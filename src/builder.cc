@@ -1,11 +1,15 @@
 
 #include "builder.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 #include "assembler.h"
 #include "debugger.h"
+#include "work_pool.h"
 
 namespace {
 const cii::ColorChar C_START(cmn::Color::F_BLUE);
@@ -25,116 +29,182 @@ std::ostream& operator<<(std::ostream& os, ass::AsmErrCode err) {
     return os;
 }
 
-std::ostream& operator<<(std::ostream& os, ass::DbgInfo dbg_info) {
-    if (dbg_info.err == ass::AsmErrCode::NO_DEF_SYM) {
-        auto itr = std::find_if(dbg_info.tokens.begin(), dbg_info.tokens.end(),
-                                [](ass::TokenInfo token_info) { return token_info.token_id == ass::TokenId::LABEL; });
-        if (itr != dbg_info.tokens.end()) {
-            cmn::C << C_ERROR << cmn::Format(err_msg[(int)dbg_info.err], itr->label.c_str()) << C_RESET;
+/**
+ * @brief エラー行を表示する
+ * @param dbg_infos 全ファイルのデバッグ情報
+ * @param i 行
+ */
+void PrintError(const ass::LineTable& dbg_infos, uint32_t i) {
+    std::string_view line = dbg_infos.Text(i);
+    ass::AsmErrCode err = dbg_infos.Err(i);
+    cmn::C << dbg_infos.FileName(dbg_infos.FileId(i)) << ":" << dbg_infos.LineNo(i) << " " << line << std::endl;
+    if (err == ass::AsmErrCode::NO_DEF_SYM) {
+        // 見つからないシンボルを表示するため、行を解析し直す
+        ass::Reader reader;
+        const ass::Tokens& tokens = reader.Parse(line);
+        auto itr = std::find_if(tokens.begin(), tokens.end(),
+                                [](const ass::TokenInfo& token_info) { return token_info.token_id == ass::TokenId::LABEL; });
+        if (itr != tokens.end()) {
+            cmn::C << C_ERROR << cmn::Format(err_msg[(int)err], itr->label.c_str()) << C_RESET;
         } else {
             cmn::C << C_ERROR << err_msg[(int)ass::AsmErrCode::ERR] << C_RESET;
         }
     } else {
-        cmn::C << C_ERROR << err_msg[(int)dbg_info.err] << C_RESET;
+        cmn::C << C_ERROR << err_msg[(int)err] << C_RESET;
     }
-
-    return os;
+    cmn::C << std::endl;
 }
 }  // namespace
 // Builder::Builder(cmn::CommetIIEnv& commetII_env) {}
 
-void Builder::LinkError(ass::DbgInfos& dbg_infos, std::vector<int>& dbg_info_index, std::vector<std ::string> files) {
-    // リンクエラー
-    auto syms = mem.GetSyms();
-    auto sym_externs = mem.GetSymExtern();
-
-    int index = 0;
-    for (auto&& [sym_def, sym_ref] : syms) {
-        // 未定義のシンボルを検索してエラー行を特定する
-        for (auto& ref : sym_ref) {
-            auto itr_ext = std::find_if(sym_externs.begin(), sym_externs.end(),
-                                        [&ref](auto sym) { return ref.first == sym.first; });
-            if (itr_ext == sym_externs.end()) {
-                if (auto itr = std::find_if(sym_def.begin(), sym_def.end(),
-                                            [&ref](auto sym) { return ref.first == sym.first; });
-                    itr == sym_def.end()) {
-                    auto itr_dbg =
-                        std::find_if(dbg_infos.begin() + dbg_info_index[index], dbg_infos.end(), [&](ass::DbgInfo e) {
-                            uint16_t off_diff = e.end_offset - e.start_offset;
-                            if (e.err == ass::AsmErrCode::OK && off_diff != 0 &&
-                                (ref.second >= e.start_offset && ref.second < e.end_offset)) {
-                                // e.err = ass::AsmErrCode::NO_DEF_SYM;
-                                return true;
-                            }
-                            return false;
-                        });
-
-                    if (itr_dbg != dbg_infos.end()) itr_dbg->err = ass::AsmErrCode::NO_DEF_SYM;
-                }
+void Builder::LinkError(ass::LineTable& dbg_infos) {
+    // 未解決のシンボル参照からエラー行を特定する
+    for (auto& ref : mem.GetUnresolved()) {
+        for (uint32_t i = dbg_infos.FileBegin(ref.module); i < dbg_infos.FileEnd(ref.module); i++) {
+            if (dbg_infos.Err(i) == ass::AsmErrCode::OK && dbg_infos.EndOffset(i) != dbg_infos.StartOffset(i) &&
+                ref.offset >= dbg_infos.StartOffset(i) && ref.offset < dbg_infos.EndOffset(i)) {
+                dbg_infos.SetErr(i, ass::AsmErrCode::NO_DEF_SYM);
+                break;
             }
         }
-        index++;
     }
 
     // エラー行の表示
-    int line_num = 1;
-    int f_index = 0;
-    index = 0;
-    for (auto&& dbg_info : dbg_infos) {
-        if (dbg_info.err == ass::AsmErrCode::NO_DEF_SYM) {
-            cmn::C << files[f_index] << ":" << line_num << " " << dbg_info.line << std::endl;
-            cmn::C << dbg_info << std::endl;
-        }
-        index++;
-        line_num++;
-        if (dbg_info_index[f_index] == index) {
-            line_num = 1;
-            f_index++;
-        }
+    for (uint32_t i = 0; i < dbg_infos.Size(); i++) {
+        if (dbg_infos.Err(i) == ass::AsmErrCode::NO_DEF_SYM) PrintError(dbg_infos, i);
     }
 }
 
-bool Builder::Build(std::vector<std ::string> files, ass::DbgInfos& all_dbg_infos) {
+bool Builder::Build(std::vector<std ::string> files, ass::LineTable& all_dbg_infos) {
     mem.Start();
+    all_dbg_infos.Clear();
 
     bool asm_error = false;
 
-    // ass::DbgInfos all_dbg_infos;
+    // 複数ファイルとキャッシュを使うときは、先にオブジェクトモジュールにしておく
+    std::vector<std::unique_ptr<cii::ObjectModule>> modules;
+    unsigned workers = std::min<unsigned>(jobs != 0 ? jobs : std::thread::hardware_concurrency(), (unsigned)files.size());
+    if (workers > 1 || cache) modules = CompileModules(files, std::max(workers, 1u));
+
+    for (size_t i = 0; i < files.size(); i++) {
+        const std::string& file = files[i];
+        const ass::LineTable* dbg_infos = &assem.dbg_infos;
+        bool is_error;
+        if (!modules.empty() && modules[i]) {
+            AppendModule(*modules[i]);
+            dbg_infos = &modules[i]->dbg_infos;
+            is_error = modules[i]->is_error;
+        } else {
+            std::ifstream ifs(file);
+            if (!ifs.is_open()) {
+                cmn::C << "ファイルのオープンに失敗しました:" << file << std::endl;
+                return false;
+            }
 
-    std::vector<int> dbg_info_index;
-    dbg_info_index.push_back(0);
-    for (auto file : files) {
-        std::ifstream ifs(file);
-        if (!ifs.is_open()) {
-            cmn::C << "ファイルのオープンに失敗しました:" << file << std::endl;
-            return false;
+            assem.Assemble(ifs, mem);
+            is_error = assem.is_error;
         }
 
-        assem.Assemble(ifs, mem);
+        uint16_t file_id = all_dbg_infos.GetFiles();
+        all_dbg_infos.AddFile(file);
+        all_dbg_infos.Append(*dbg_infos);
 
-        std::copy(assem.dbg_infos.begin(), assem.dbg_infos.end(), std::back_inserter(all_dbg_infos));
-
-        if (assem.is_error) {
-            int num = 1;
-            for (auto& e : assem.dbg_infos) {
-                if (e.err != ass::AsmErrCode::OK) {
-                    cmn::C << file << ":" << num << " " << e.line << std::endl;
-                    cmn::C << e << std::endl;
-                }
-                num++;
+        if (is_error) {
+            for (uint32_t j = all_dbg_infos.FileBegin(file_id); j < all_dbg_infos.FileEnd(file_id); j++) {
+                if (all_dbg_infos.Err(j) != ass::AsmErrCode::OK) PrintError(all_dbg_infos, j);
             }
             asm_error = true;
         }
         mem.SnapShot();
-        dbg_info_index.push_back((int)assem.dbg_infos.size());
     }
     if (asm_error) return false;
 
     if (!mem.End()) {
+        if (mem.IsOverflow()) {
+            cmn::C << C_ERROR << cmn::Format("プログラムがメモリサイズ(%u ワード)を超えています", mem.size) << C_RESET
+                   << std::endl;
+            return false;
+        }
         // リンクエラー
-        LinkError(all_dbg_infos, dbg_info_index, files);
+        LinkError(all_dbg_infos);
         return false;
     }
+    all_dbg_infos.BuildIndex();
 
     return true;
 }
+
+void Builder::SetCacheDir(const std::string& dir) {
+    cache = dir.empty() ? nullptr : std::make_unique<cii::ObjectCache>(dir);
+}
+
+std::unique_ptr<cii::ObjectModule> Builder::Compile(const std::string& file) const {
+    std::ifstream ifs(file);
+    if (!ifs.is_open()) return nullptr;
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    std::string source = ss.str();
+
+    auto module = std::make_unique<cii::ObjectModule>();
+    if (cache && cache->Load(source, *module)) return module;
+
+    // 0番地からアセンブルする
+    cmn::PageArray<cii::WordData> words(mem.size);
+    cii::AssmMem module_mem(mem.size, words.data(), 0);
+    ass::Assembler module_assem;
+    std::stringstream src{source};
+    module_mem.Start();
+    module_assem.Assemble(src, module_mem);
+
+    module_mem.Export(*module);
+    module->dbg_infos = std::move(module_assem.dbg_infos);
+    module->is_error = module_assem.is_error;
+    module->source_size = (uint32_t)source.size();
+    // メモリサイズを超えたモジュールはメモリサイズによって結果が変わるため保存しない
+    if (cache && !module->overflow) cache->Save(source, *module);
+    return module;
+}
+
+std::vector<std::unique_ptr<cii::ObjectModule>> Builder::CompileModules(const std::vector<std::string>& files,
+                                                                        unsigned workers) {
+    std::vector<std::unique_ptr<cii::ObjectModule>> modules(files.size());
+    cmn::WorkPool pool(workers);
+    for (size_t i = 0; i < files.size(); i++) {
+        pool.Push([&, i](unsigned) { modules[i] = Compile(files[i]); });
+    }
+    pool.Run();
+    return modules;
+}
+
+void Builder::AppendModule(cii::ObjectModule& module) {
+    // 前のファイルのSTARTと同じラベルを定義しているときは、順番にアセンブルした結果と変わるため、アセンブルし直す
+    auto is_defined = [&](const cii::SymValue& sym) { return !mem.CheckSym(sym.first); };
+    bool redefined = std::any_of(module.locals.begin(), module.locals.end(), is_defined) ||
+                     std::any_of(module.externs.begin(), module.externs.end(), is_defined);
+    if (redefined) {
+        assem.is_error = false;
+        assem.dbg_infos.Clear();
+        for (uint32_t i = 0; i < module.dbg_infos.Size(); i++) assem.Assemble(std::string(module.dbg_infos.Text(i)), mem);
+        std::swap(module.dbg_infos, assem.dbg_infos);
+        module.is_error = assem.is_error;
+        return;
+    }
+
+    uint16_t base = (uint16_t)mem.GetOffset();
+    mem.Append(module);
+    module.dbg_infos.Relocate(base);
+}
+
+std::shared_ptr<const cii::ProgramImage> Builder::BuildImage(std::vector<std ::string> files) {
+    ass::LineTable dbg_infos;
+    if (!Build(files, dbg_infos)) return nullptr;
+
+    return std::make_shared<const cii::ProgramImage>(mem, mem.GetOffset(), GetStart(), std::move(dbg_infos),
+                                                     mem.GetSyms());
+}
+
+uint16_t Builder::GetStart() const {
+    // 最初のSTARTから実行する
+    auto& starts = mem.GetSymExtern();
+    return starts.empty() ? 0 : starts[0].second;
+}
@@ -1,6 +1,7 @@
 #ifndef BUILDER_H_
 #define BUILDER_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -9,6 +10,8 @@
 #include "comet_ii.h"
 #include "common.h"
 #include "conf.h"
+#include "object_module.h"
+#include "program_image.h"
 
 /**
  * @brief ビルド
@@ -18,11 +21,73 @@ class Builder {
     cii::AssmMem& mem;
     cii::CometII& cii_cpu;
     ass::Assembler assem;
+    unsigned jobs = 0;                        //!< アセンブルの並列数(0:ハードウェアスレッド数、1:順番)
+    std::unique_ptr<cii::ObjectCache> cache;  //!< オブジェクトモジュールのキャッシュ
 
    public:
     Builder(cii::CommetIIEnv& commetII_env) : mem(commetII_env.mem), cii_cpu(commetII_env.cii_cpu) {}
-    bool Build(std::vector<std ::string> files, ass::DbgInfos& all_dbg_infos);
-    void LinkError(ass::DbgInfos& dbg_infos, std::vector<int>& dbg_info_index, std::vector<std ::string> files);
+    /**
+     * @brief ビルドする
+     *
+     * @param files ソースファイル
+     * @param all_dbg_infos 全ファイルのデバッグ情報。成功したときはアドレスの索引も作成する
+     * @return true 成功
+     * @note
+     * 複数ファイルは並列にアセンブルしてから、ファイルの順に再配置してリンクする。
+     * 結果とエラー表示は順番にアセンブルしたときと同じ
+     */
+    bool Build(std::vector<std ::string> files, ass::LineTable& all_dbg_infos);
+    /**
+     * @brief アセンブルの並列数を設定する
+     * @param n 並列数(0:ハードウェアスレッド数、1:順番にアセンブルする)
+     */
+    void SetJobs(unsigned n) { jobs = n; }
+    /**
+     * @brief オブジェクトモジュールのキャッシュを使う
+     * @param dir キャッシュディレクトリ(空のときは使わない)
+     * @note
+     * 内容が変わらないソースファイルはアセンブルせずにキャッシュから読み込む
+     */
+    void SetCacheDir(const std::string& dir);
+    /**
+     * @brief 1ファイルを0番地からアセンブルしてオブジェクトモジュールにする
+     *
+     * @param file ソースファイル
+     * @return std::unique_ptr<cii::ObjectModule> オブジェクトモジュール、ファイルを開けないときはnullptr
+     * @note
+     * キャッシュを使うときは、キャッシュにあれば読み込み、なければ保存する
+     */
+    std::unique_ptr<cii::ObjectModule> Compile(const std::string& file) const;
+    /**
+     * @brief ビルドしてプログラムイメージを作成する
+     *
+     * @param files ソースファイル
+     * @return std::shared_ptr<const cii::ProgramImage> プログラムイメージ、エラーのときはnullptr
+     */
+    std::shared_ptr<const cii::ProgramImage> BuildImage(std::vector<std ::string> files);
+    /**
+     * @brief ビルドしたプログラムの実行開始アドレス(最初のSTART)を取得する
+     */
+    uint16_t GetStart() const;
+    /**
+     * @brief 未解決のシンボルを参照している行にエラーを設定して表示する
+     * @param dbg_infos 全ファイルのデバッグ情報
+     */
+    void LinkError(ass::LineTable& dbg_infos);
+
+   private:
+    /**
+     * @brief ファイルごとに並列でオブジェクトモジュールにする
+     * @param files ソースファイル
+     * @param workers 並列数
+     */
+    std::vector<std::unique_ptr<cii::ObjectModule>> CompileModules(const std::vector<std::string>& files,
+                                                                   unsigned workers);
+    /**
+     * @brief オブジェクトモジュールを出力位置に再配置してリンクする
+     * @param module オブジェクトモジュール。デバッグ情報のアドレスを再配置する
+     */
+    void AppendModule(cii::ObjectModule& module);
 };
 
 #endif
\ No newline at end of file
@@ -3,8 +3,122 @@
 #include <iostream>
 #include <string>
 
+#include "history.h"
+#include "jit_x64.h"
+#include "profiler.h"
+#include "tracer.h"
+
 namespace cii {
-CometII::CometII(Memory *mem, std::ostream &out, std::istream &in) : ram(mem), svc_out(&out), svc_in(&in), counter(0) {
+/**
+ * 命令コード、ハンドラ、命令語長の一覧
+ */
+#define CII_OP_LIST(X) \
+    X(LD_M, LoadMem, 2)\
+    X(ST, Store, 2)\
+    X(LAD, LoadAdr, 2)\
+    X(LD_R, LoadReg, 1)\
+    X(ADDA_M, AddAMem, 2)\
+    X(ADDL_M, AddLMem, 2)\
+    X(SUBA_M, SubAMem, 2)\
+    X(SUBL_M, SubLMem, 2)\
+    X(ADDA_R, AddAReg, 1)\
+    X(ADDL_R, AddLReg, 1)\
+    X(SUBA_R, SubAReg, 1)\
+    X(SUBL_R, SubLReg, 1)\
+    X(AND_M, AndMem, 2)\
+    X(OR_M, OrMem, 2)\
+    X(XOR_M, XorMem, 2)\
+    X(AND_R, AndReg, 1)\
+    X(OR_R, OrReg, 1)\
+    X(XOR_R, XorReg, 1)\
+    X(CPA_M, CompAMem, 2)\
+    X(CPL_M, CompLMem, 2)\
+    X(CPA_R, CompAReg, 1)\
+    X(CPL_R, CompLReg, 1)\
+    X(SLA, ShiftLeftA, 2)\
+    X(SRA, ShiftRightA, 2)\
+    X(SLL, ShiftLeftL, 2)\
+    X(SRL, ShiftRightL, 2)\
+    X(JPL, JumpOnPlus, 2)\
+    X(JMI, JumpOnMinus, 2)\
+    X(JNZ, JumpOnNonZero, 2)\
+    X(JZE, JumpOnZero, 2)\
+    X(JOV, JumpOnOverflow, 2)\
+    X(JUMP, Jump, 2)\
+    X(PUSH, Push, 2)\
+    X(POP, Pop, 1)\
+    X(CALL, CallSub, 2)\
+    X(RET, ReturnFromSub, 1)\
+    X(SVC, Svc, 2)\
+    X(HLT, Halt, 1)
+
+const char *GetOpName(OpCode op) {
+    switch (op) {
+#define CII_OP_NAME(op, handler, len) \
+    case OpCode::op:                  \
+        return #op;
+        CII_OP_LIST(CII_OP_NAME)
+#undef CII_OP_NAME
+    default:
+        return nullptr;
+    }
+}
+
+const char *GetCauseName(CauseOfStop cause) {
+    switch (cause) {
+    case CauseOfStop::OK:
+        return "OK";
+    case CauseOfStop::SINGLE_STEP:
+        return "SINGLE_STEP";
+    case CauseOfStop::HALT:
+        return "HALT";
+    case CauseOfStop::ILLEGAL_ACCESS:
+        return "ILLEGAL_ACCESS";
+    case CauseOfStop::INVALID_OPERATION:
+        return "INVALID_OPERATION";
+    case CauseOfStop::STACK_OVERFLOW:
+        return "STACK_OVERFLOW";
+    case CauseOfStop::STACK_UNDERFLOW:
+        return "STACK_UNDERFLOW";
+    case CauseOfStop::BREAK_POINT:
+        return "BREAK_POINT";
+    case CauseOfStop::STEP_LIMIT:
+        return "STEP_LIMIT";
+    case CauseOfStop::CONDITION:
+        return "CONDITION";
+    case CauseOfStop::WATCH_POINT:
+        return "WATCH_POINT";
+    }
+    return "UNKNOWN";
+}
+
+const std::array<CometII::OpDef, 256> CometII::op_defs = CometII::MakeOpDefs();
+
+std::array<CometII::OpDef, 256> CometII::MakeOpDefs() {
+    std::array<OpDef, 256> defs;
+    defs.fill({&CometII::InvalidOp, 1});
+
+#define CII_OP_DEF(op, handler, len) defs[static_cast<uint8_t>(OpCode::op)] = {&CometII::handler, len};
+    CII_OP_LIST(CII_OP_DEF)
+#undef CII_OP_DEF
+
+    return defs;
+}
+
+CometII::CometII(Memory *mem, std::ostream &out, std::istream &in)
+    : ram(mem),
+      svc_out(&out),
+      svc_in(&in),
+      svc_arena(nullptr),
+      out_flush_size(DEFAULT_OUT_FLUSH_SIZE),
+      break_map(mem->size),
+      watch_pages((mem->size + WATCH_PAGE_WORDS - 1) / WATCH_PAGE_WORDS),
+      watch_hit{},
+      counter(0),
+      step_end(0),
+      stop(CauseOfStop::OK),
+      decode_cache(mem->size), use_decode_cache(true), engine(DEFAULT_ENGINE), code_map(mem->size),
+      profiler(nullptr), tracer(nullptr), history(nullptr) {
     Reset();
 }
 CometII::~CometII() {}
@@ -17,6 +131,140 @@ void CometII::Reset() {
     counter = 0;
     // break_points.clear();
     pre_pr = -1;
+    InvalidateDecodeCache();
+}
+
+CpuState CometII::GetState() const {
+    CpuState state;
+    std::copy(GR, GR + 8, state.gr);
+    state.sp = SP;
+    state.pr = PR;
+    state.fr = (uint8_t)(FR.OF | (FR.SF << 1) | (FR.ZF << 2));
+    state.counter = counter;
+    return state;
+}
+
+void CometII::SetState(const CpuState &state) {
+    std::copy(state.gr, state.gr + 8, GR);
+    SP = state.sp;
+    PR = state.pr;
+    FR.Clear();
+    FR.OF = state.fr & 1;
+    FR.SF = (state.fr >> 1) & 1;
+    FR.ZF = (state.fr >> 2) & 1;
+    counter = state.counter;
+    pre_pr = -1;
+}
+
+void CometII::InvalidateDecodeCache() {
+    if (jit || decoded_adrs.size() >= ram->size) {
+        decode_cache.Clear();
+        code_map.Clear();
+        if (jit) jit->Clear();
+    } else {
+        // デコードしたアドレスだけを無効にする
+        for (uint16_t adr : decoded_adrs) {
+            decode_cache[adr].len = 0;
+            code_map[adr] = 0;
+            if (adr + 1u < ram->size) code_map[adr + 1] = 0;
+        }
+    }
+    decoded_adrs.clear();
+}
+
+void CometII::SetBreakPoint(uint16_t point, BreakCond cond, uint32_t ignore_count) {
+    if (point >= break_map.size()) return;
+
+    if (break_map[point] == 0) {
+        break_points.push_back({point, nullptr, 0, 0});
+        break_map[point] = (uint32_t)break_points.size();
+    }
+    BreakPoint &bp = break_points[break_map[point] - 1];
+    bp.cond = std::move(cond);
+    bp.ignore_count = ignore_count;
+}
+
+void CometII::DeleteBreakPoint(uint16_t point) {
+    if (point >= break_map.size() || break_map[point] == 0) return;
+
+    // 最後のブレークポイントを削除位置に移動する
+    uint32_t no = break_map[point];
+    break_map[point] = 0;
+    if (no != break_points.size()) {
+        break_points[no - 1] = std::move(break_points.back());
+        break_map[break_points[no - 1].adr] = no;
+    }
+    break_points.pop_back();
+}
+
+void CometII::SetWatchPoint(uint16_t start, uint16_t end, WatchType type, uint16_t value) {
+    if (start > end || end >= ram->size) return;
+
+    auto itr = std::find_if(watch_points.begin(), watch_points.end(),
+                            [&](const WatchPoint &wp) { return wp.start == start && wp.end == end; });
+    if (itr == watch_points.end()) itr = watch_points.insert(watch_points.end(), {start, end, type, value});
+    itr->type = type;
+    itr->value = value;
+    UpdateWatchPages();
+}
+
+void CometII::DeleteWatchPoint(uint16_t start) {
+    watch_points.erase(std::remove_if(watch_points.begin(), watch_points.end(),
+                                      [&](const WatchPoint &wp) { return wp.start == start; }),
+                       watch_points.end());
+    UpdateWatchPages();
+}
+
+void CometII::UpdateWatchPages() {
+    std::fill(watch_pages.begin(), watch_pages.end(), 0);
+    for (auto &wp : watch_points) {
+        uint8_t kind = wp.type == WatchType::READ     ? WATCH_READ
+                       : wp.type == WatchType::ACCESS ? WATCH_READ | WATCH_WRITE
+                                                      : WATCH_WRITE;
+        for (uint32_t page = wp.start / WATCH_PAGE_WORDS; page <= wp.end / WATCH_PAGE_WORDS; page++) {
+            watch_pages[page] |= kind;
+        }
+    }
+}
+
+void CometII::CheckWatch(uint16_t adr, uint16_t old_data, uint16_t data, bool write) {
+    for (auto &wp : watch_points) {
+        if (adr < wp.start || adr > wp.end) continue;
+
+        bool hit = false;
+        switch (wp.type) {
+        case WatchType::WRITE:
+            hit = write && old_data != data;
+            break;
+        case WatchType::READ:
+            hit = !write;
+            break;
+        case WatchType::ACCESS:
+            hit = true;
+            break;
+        case WatchType::VALUE:
+            hit = write && data == wp.value;
+            break;
+        }
+        // 1命令で複数回満たしたときは最初のアクセスで停止する
+        if (hit && stop == CauseOfStop::OK) {
+            watch_hit = {wp, adr, old_data, data, write};
+            Stop(CauseOfStop::WATCH_POINT);
+            return;
+        }
+    }
+}
+
+bool CometII::HitBreakPoint(BreakPoint &bp) {
+    if (bp.cond && !bp.cond(*this)) return false;
+
+    return ++bp.hit_count > bp.ignore_count;
+}
+
+void CometII::InvalidateCode(uint16_t adr) {
+    decode_cache[adr].len = 0;
+    if (adr > 0) decode_cache[adr - 1].len = 0;
+    if (jit) jit->Invalidate(adr);
 }
 
 /**
@@ -30,81 +278,259 @@ void CometII::Reset() {
  * @detail 詳細な説明
  */
 CauseOfStop CometII::Run() {
-    CauseOfStop cause = CauseOfStop::OK;
+    FR.HLT = OFF;
+    stop = CauseOfStop::OK;
+    CauseOfStop cause = RunEngine<false>();
+    FlushSvcOut();
+    return cause;
+}
 
+RunResult CometII::RunFor(uint32_t max_steps) {
     FR.HLT = OFF;
-    for (;;) {
-        if (pre_pr != PR) {
-            if (auto itr = std::find(break_points.begin(), break_points.end(), PR); itr != break_points.end()) {
-                pre_pr = PR;
-                cause = CauseOfStop::BREAK_POINT;
-                break;
-            }
-        }
-        pre_pr = -1;
+    stop = CauseOfStop::OK;
+    uint32_t start = counter;
+    step_end = counter + max_steps;
+    CauseOfStop cause = RunEngine<true>();
+    FlushSvcOut();
+    return {cause, counter - start};
+}
 
-        try {
-            ExecOneStep();
-        } catch (IlleagalAccessError) {
-            cause = CauseOfStop::ILLEGAL_ACCESS;
-            break;
-        } catch (StackOverflowError) {
-            cause = CauseOfStop::STACK_OVERFLOW;
+RunResult CometII::RunUntil(const BreakCond &cond, uint32_t max_steps) {
+    FR.HLT = OFF;
+    stop = CauseOfStop::OK;
+    uint32_t start = counter;
+    bool replay = history != nullptr && history->IsReplaying();
+    CauseOfStop cause;
+    for (;;) {
+        if (cond(*this)) {
+            cause = CauseOfStop::CONDITION;
             break;
-        } catch (StackUnderflowError) {
-            cause = CauseOfStop::STACK_UNDERFLOW;
+        }
+        if (counter - start == max_steps) {
+            cause = CauseOfStop::STEP_LIMIT;
             break;
-        } catch (InvalidOperationError) {
-            cause = CauseOfStop::INVALID_OPERATION;
+        }
+        if (!break_points.empty() && !replay && IsBreak()) {
+            cause = CauseOfStop::BREAK_POINT;
             break;
         }
-        if (FR.IsHalt()) {
-            cause = CauseOfStop::HALT;
+
+        if (IsHooked())
+            ExecOneStep<true>();
+        else
+            ExecOneStep<false>();
+
+        if (stop != CauseOfStop::OK) {
+            cause = TakeStop();
             break;
         }
         if (FR.IsSingleStep()) {
-            cause = CauseOfStop::SINGLE_STEP;
             FR.SetSingleStep(OFF);
+            cause = CauseOfStop::SINGLE_STEP;
             break;
         }
     }
-    return cause;
+    FlushSvcOut();
+    return {cause, counter - start};
+}
+
+/*
+ * ブレークポイントと実行ステップ数の判定は、必要なときだけ行うループで実行する
+ */
+template <bool LIMIT>
+CauseOfStop CometII::RunEngine() {
+    // 実行履歴の再実行中はブレークポイントで停止しない
+    bool has_break = !break_points.empty() && (history == nullptr || !history->IsReplaying());
+    if (!has_break) pre_pr = -1;
+    // プロファイル、トレース、実行履歴の記録中は命令ごとに記録するため、呼び出し方式で実行する
+    if (IsHooked())
+        return has_break ? RunCall<true, LIMIT, true>() : RunCall<false, LIMIT, true>();
+    switch (engine) {
+    case ExecEngine::JIT:
+        if (!jit) jit = std::make_unique<JitX64>(ram->size);
+        // コンパイル済みブロックはメモリに直接アクセスするため、ウォッチポイントがあるときはTHREADEDで実行する
+        if (jit->IsAvailable() && watch_points.empty()) return RunJit(LIMIT);
+        // JITが使用できないときはTHREADEDで実行する
+        [[fallthrough]];
+    case ExecEngine::THREADED:
+        return has_break ? RunThreaded<true, LIMIT>() : RunThreaded<false, LIMIT>();
+    default:
+        return has_break ? RunCall<true, LIMIT, false>() : RunCall<false, LIMIT, false>();
+    }
 }
 
-uint16_t CometII::EffectiveAdr(OpWord opword) {
-    if (opword.src_reg == 0) {
-        return FetchWordData().data;
+template <bool BREAK, bool LIMIT, bool HOOK>
+CauseOfStop CometII::RunCall() {
+    for (;;) {
+        if (BREAK && IsBreak()) return CauseOfStop::BREAK_POINT;
+        if (LIMIT && counter == step_end) return CauseOfStop::STEP_LIMIT;
+
+        ExecOneStep<HOOK>();
+
+        if (stop != CauseOfStop::OK) return TakeStop();
+        if (FR.IsSingleStep()) {
+            FR.SetSingleStep(OFF);
+            return CauseOfStop::SINGLE_STEP;
+        }
     }
-    return FetchWordData().data + GR[opword.src_reg];
+}
+
+#if defined(__GNUC__)
+/*
+ * 命令ごとのラベルへ直接ジャンプする(computed goto)。
+ * 各ラベルの末尾で次の命令をデコードしてディスパッチするため、
+ * 分岐予測が命令ごとに分散される。
+ */
+template <bool BREAK, bool LIMIT>
+CauseOfStop CometII::RunThreaded() {
+    void *labels[256];
+    for (auto &label : labels) label = &&L_INVALID;
+#define CII_OP_LABEL_ADR(op, handler, len) labels[static_cast<uint8_t>(OpCode::op)] = &&L_##op;
+    CII_OP_LIST(CII_OP_LABEL_ADR)
+#undef CII_OP_LABEL_ADR
+
+    DecodedOp decoded;
+    const DecodedOp *op;
+
+#define CII_DISPATCH()                                                     \
+    do {                                                                   \
+        if (BREAK && IsBreak()) return CauseOfStop::BREAK_POINT;           \
+        if (LIMIT && counter == step_end) return CauseOfStop::STEP_LIMIT;  \
+        counter++;                                                         \
+        op = FetchDecoded(decoded);                                        \
+        if (op == nullptr) return TakeStop();                              \
+        PR += op->len;                                                     \
+        goto *labels[static_cast<uint8_t>(op->op_code)];                   \
+    } while (0)
+
+#define CII_NEXT()                                                         \
+    do {                                                                   \
+        if (stop != CauseOfStop::OK) return TakeStop();                    \
+        if (FR.IsSingleStep()) {                                           \
+            FR.SetSingleStep(OFF);                                         \
+            return CauseOfStop::SINGLE_STEP;                               \
+        }                                                                  \
+        CII_DISPATCH();                                                    \
+    } while (0)
+
+    CII_DISPATCH();
+
+#define CII_OP_LABEL(op_name, handler, len) \
+    L_##op_name : handler(*op);             \
+    CII_NEXT();
+    CII_OP_LIST(CII_OP_LABEL)
+#undef CII_OP_LABEL
+
+L_INVALID:
+    InvalidOp(*op);
+    CII_NEXT();
+
+#undef CII_NEXT
+#undef CII_DISPATCH
+}
+#else
+template <bool BREAK, bool LIMIT>
+CauseOfStop CometII::RunThreaded() {
+    return RunCall<BREAK, LIMIT, false>();
+}
+#endif
+
+/*
+ * ブロックの先頭で実行回数を数え、一定回数を超えたらネイティブコードにコンパイルする。
+ * ブレークポイントを含むブロックとシングルステップ中はインタプリタで実行する。
+ */
+CauseOfStop CometII::RunJit(bool limit) {
+    bool leader = true;
+    for (;;) {
+        // 実行ステップ数の上限を超えないように、残りが1ブロックの最大命令数未満のときはインタプリタで実行する
+        if (leader && !FR.IsSingleStep() && (!limit || step_end - counter >= JitX64::MAX_BLOCK_OPS)) {
+            const JitX64::Block *block = jit->Find(PR);
+            if (block == nullptr && jit->IsHot(PR)) block = jit->Compile(PR, *ram, code_map.data());
+            if (block != nullptr && !HasBreakPoint(block->start, block->end)) {
+                JitContext ctx{GR, ram->memory, code_map.data(), ram->size, 0, SP, PR,
+                               (uint8_t)(FR.OF | (FR.SF << 1) | (FR.ZF << 2))};
+                block->func(&ctx);
+                counter += ctx.steps;
+                SP = ctx.sp;
+                PR = ctx.pr;
+                FR.OF = ctx.flags & 1;
+                FR.SF = (ctx.flags >> 1) & 1;
+                FR.ZF = (ctx.flags >> 2) & 1;
+                pre_pr = -1;
+                // 先頭の命令でインタプリタに戻ったときは、その命令をインタプリタで実行する
+                leader = ctx.steps != 0;
+                continue;
+            }
+        }
+
+        if (!break_points.empty() && IsBreak()) return CauseOfStop::BREAK_POINT;
+        if (limit && counter == step_end) return CauseOfStop::STEP_LIMIT;
+
+        counter++;
+        DecodedOp decoded;
+        const DecodedOp *op = FetchDecoded(decoded);
+        if (op == nullptr) return TakeStop();
+        PR += op->len;
+        OpCode op_code = op->op_code;
+        (this->*op->handler)(*op);
+        leader = IsBlockEnd(op_code);
+
+        if (stop != CauseOfStop::OK) return TakeStop();
+        if (FR.IsSingleStep()) {
+            FR.SetSingleStep(OFF);
+            return CauseOfStop::SINGLE_STEP;
+        }
+    }
+}
+
+uint16_t CometII::EffectiveAdr(const DecodedOp &op) const {
+    if (op.src_reg == 0) {
+        return op.adr;
+    }
+    return op.adr + GR[op.src_reg];
 }
 /*
  *
  */
-void CometII::LoadReg(OpWord opword) {
-    GR[opword.des_reg] = GR[opword.src_reg];
-    FR.SetFlagsClearOver(GR[opword.des_reg]);
+void CometII::LoadReg(const DecodedOp &op) {
+    GR[op.des_reg] = GR[op.src_reg];
+    FR.SetFlagsClearOver(GR[op.des_reg]);
 }
-void CometII::LoadMem(OpWord opword) {
-    GR[opword.des_reg] = FetchWordData(EffectiveAdr(opword));
-    FR.SetFlagsClearOver(GR[opword.des_reg]);
+void CometII::LoadMem(const DecodedOp &op) {
+    uint16_t data;
+    if (!FetchWordData(EffectiveAdr(op), data)) return;
+    GR[op.des_reg] = data;
+    FR.SetFlagsClearOver(GR[op.des_reg]);
 }
-void CometII::Store(OpWord opword) {
+void CometII::Store(const DecodedOp &op) {
     // store はdes_reg
-    StoreData(EffectiveAdr(opword), GR[opword.des_reg]);
+    StoreData(EffectiveAdr(op), GR[op.des_reg]);
 }
-void CometII::LoadAdr(OpWord opword) { GR[opword.des_reg] = EffectiveAdr(opword); }
+void CometII::LoadAdr(const DecodedOp &op) { GR[op.des_reg] = EffectiveAdr(op); }
 /*
  *
  */
-void CometII::AddAReg(OpWord opword) { AddA(GR[opword.des_reg], GR[opword.src_reg]); }
-void CometII::AddAMem(OpWord opword) { AddA(GR[opword.des_reg], FetchWordData(EffectiveAdr(opword))); }
-void CometII::SubAReg(OpWord opword) { SubA(GR[opword.des_reg], GR[opword.src_reg]); }
-void CometII::SubAMem(OpWord opword) { SubA(GR[opword.des_reg], FetchWordData(EffectiveAdr(opword))); }
+void CometII::AddAReg(const DecodedOp &op) { AddA(GR[op.des_reg], GR[op.src_reg]); }
+void CometII::AddAMem(const DecodedOp &op) {
+    uint16_t data;
+    if (FetchWordData(EffectiveAdr(op), data)) AddA(GR[op.des_reg], data);
+}
+void CometII::SubAReg(const DecodedOp &op) { SubA(GR[op.des_reg], GR[op.src_reg]); }
+void CometII::SubAMem(const DecodedOp &op) {
+    uint16_t data;
+    if (FetchWordData(EffectiveAdr(op), data)) SubA(GR[op.des_reg], data);
+}
 
-void CometII::AddLReg(OpWord opword) { AddL(GR[opword.des_reg], GR[opword.src_reg]); }
-void CometII::AddLMem(OpWord opword) { AddL(GR[opword.des_reg], FetchWordData(EffectiveAdr(opword))); }
-void CometII::SubLReg(OpWord opword) { SubL(GR[opword.des_reg], GR[opword.src_reg]); }
-void CometII::SubLMem(OpWord opword) { SubL(GR[opword.des_reg], FetchWordData(EffectiveAdr(opword))); }
+void CometII::AddLReg(const DecodedOp &op) { AddL(GR[op.des_reg], GR[op.src_reg]); }
+void CometII::AddLMem(const DecodedOp &op) {
+    uint16_t data;
+    if (FetchWordData(EffectiveAdr(op), data)) AddL(GR[op.des_reg], data);
+}
+void CometII::SubLReg(const DecodedOp &op) { SubL(GR[op.des_reg], GR[op.src_reg]); }
+void CometII::SubLMem(const DecodedOp &op) {
+    uint16_t data;
+    if (FetchWordData(EffectiveAdr(op), data)) SubL(GR[op.des_reg], data);
+}
 
 void CometII::AddA(uint16_t &des, uint16_t src) {
     int32_t result;
@@ -134,320 +560,319 @@ void CometII::SubL(uint16_t &des, uint16_t src) {
     FR.SetFlags(result);
 }
 
-void CometII::AndReg(OpWord opword) {
-    GR[opword.des_reg] &= GR[opword.src_reg];
-    FR.SetFlagsClearOver(GR[opword.des_reg]);
+void CometII::AndReg(const DecodedOp &op) {
+    GR[op.des_reg] &= GR[op.src_reg];
+    FR.SetFlagsClearOver(GR[op.des_reg]);
 }
-void CometII::AndMem(OpWord opword) {
-    GR[opword.des_reg] &= FetchWordData(EffectiveAdr(opword));
-    FR.SetFlagsClearOver(GR[opword.des_reg]);
+void CometII::AndMem(const DecodedOp &op) {
+    uint16_t data;
+    if (!FetchWordData(EffectiveAdr(op), data)) return;
+    GR[op.des_reg] &= data;
+    FR.SetFlagsClearOver(GR[op.des_reg]);
 }
-void CometII::OrReg(OpWord opword) {
-    GR[opword.des_reg] |= GR[opword.src_reg];
-    FR.SetFlagsClearOver(GR[opword.des_reg]);
+void CometII::OrReg(const DecodedOp &op) {
+    GR[op.des_reg] |= GR[op.src_reg];
+    FR.SetFlagsClearOver(GR[op.des_reg]);
 }
-void CometII::OrMem(OpWord opword) {
-    GR[opword.des_reg] |= FetchWordData(EffectiveAdr(opword));
-    FR.SetFlagsClearOver(GR[opword.des_reg]);
+void CometII::OrMem(const DecodedOp &op) {
+    uint16_t data;
+    if (!FetchWordData(EffectiveAdr(op), data)) return;
+    GR[op.des_reg] |= data;
+    FR.SetFlagsClearOver(GR[op.des_reg]);
 }
-void CometII::XorReg(OpWord opword) {
-    GR[opword.des_reg] ^= GR[opword.src_reg];
-    FR.SetFlagsClearOver(GR[opword.des_reg]);
+void CometII::XorReg(const DecodedOp &op) {
+    GR[op.des_reg] ^= GR[op.src_reg];
+    FR.SetFlagsClearOver(GR[op.des_reg]);
 }
-void CometII::XorMem(OpWord opword) {
-    GR[opword.des_reg] ^= FetchWordData(EffectiveAdr(opword));
-    FR.SetFlagsClearOver(GR[opword.des_reg]);
+void CometII::XorMem(const DecodedOp &op) {
+    uint16_t data;
+    if (!FetchWordData(EffectiveAdr(op), data)) return;
+    GR[op.des_reg] ^= data;
+    FR.SetFlagsClearOver(GR[op.des_reg]);
 }
-void CometII::CompAReg(OpWord opword) {
-    uint16_t des = GR[opword.des_reg];
-    SubA(des, GR[opword.src_reg]);
+void CometII::CompAReg(const DecodedOp &op) {
+    uint16_t des = GR[op.des_reg];
+    SubA(des, GR[op.src_reg]);
 }
-void CometII::CompLReg(OpWord opword) {
-    uint16_t des = GR[opword.des_reg];
-    SubL(des, GR[opword.src_reg]);
+void CometII::CompLReg(const DecodedOp &op) {
+    uint16_t des = GR[op.des_reg];
+    SubL(des, GR[op.src_reg]);
 }
-void CometII::CompAMem(OpWord opword) {
-    uint16_t des = GR[opword.des_reg];
-    SubA(des, FetchWordData(EffectiveAdr(opword)));
+void CometII::CompAMem(const DecodedOp &op) {
+    uint16_t des = GR[op.des_reg];
+    uint16_t data;
+    if (FetchWordData(EffectiveAdr(op), data)) SubA(des, data);
 }
-void CometII::CompLMem(OpWord opword) {
-    uint16_t des = GR[opword.des_reg];
-    SubL(des, FetchWordData(EffectiveAdr(opword)));
+void CometII::CompLMem(const DecodedOp &op) {
+    uint16_t des = GR[op.des_reg];
+    uint16_t data;
+    if (FetchWordData(EffectiveAdr(op), data)) SubL(des, data);
 }
 
-void CometII::ShiftLeftA(OpWord opword) {
-    uint16_t result = GR[opword.des_reg];
+void CometII::ShiftLeftA(const DecodedOp &op) {
+    uint16_t result = GR[op.des_reg];
 
-    result <<= EffectiveAdr(opword);
+    result <<= EffectiveAdr(op);
     FR.OF = cii::IsSigned(result);
 
-    if (cii::IsSigned(GR[opword.des_reg]) == OFF) {
+    if (cii::IsSigned(GR[op.des_reg]) == OFF) {
         result &= 0x7fff;
     } else {
         result |= 0x8000;
     }
-    GR[opword.des_reg] = result;
+    GR[op.des_reg] = result;
     FR.SetSigned(result);
     FR.SetZero(result);
 }
 
-void CometII::ShiftRightA(OpWord opword) {
-    int16_t result = (int16_t)GR[opword.des_reg];
+void CometII::ShiftRightA(const DecodedOp &op) {
+    int16_t result = (int16_t)GR[op.des_reg];
 
-    result >>= EffectiveAdr(opword) - 1;
+    result >>= EffectiveAdr(op) - 1;
 
     FR.OF = (result & 1) == 0 ? OFF : ON;
 
     result >>= 1;
 
-    GR[opword.des_reg] = result;
+    GR[op.des_reg] = result;
     FR.SetSigned(result);
     FR.SetZero(result);
 }
 
-void CometII::ShiftLeftL(OpWord opword) {
+void CometII::ShiftLeftL(const DecodedOp &op) {
     uint32_t result;
 
-    result = (uint32_t)GR[opword.des_reg] << EffectiveAdr(opword);
-    GR[opword.des_reg] = result;
+    result = (uint32_t)GR[op.des_reg] << EffectiveAdr(op);
+    GR[op.des_reg] = result;
     FR.OF = (result & 0x10000) == 0 ? OFF : ON;
-    FR.SetSigned(GR[opword.des_reg]);
-    FR.SetZero(GR[opword.des_reg]);
+    FR.SetSigned(GR[op.des_reg]);
+    FR.SetZero(GR[op.des_reg]);
 }
-void CometII::ShiftRightL(OpWord opword) {
+void CometII::ShiftRightL(const DecodedOp &op) {
     uint32_t result;
 
-    result = (uint32_t)GR[opword.des_reg] >> (EffectiveAdr(opword) - 1);
+    result = (uint32_t)GR[op.des_reg] >> (EffectiveAdr(op) - 1);
 
     FR.OF = (result & 1) == 0 ? OFF : ON;
 
-    GR[opword.des_reg] = result >> 1;
-    FR.SetSigned(GR[opword.des_reg]);
-    FR.SetZero(GR[opword.des_reg]);
+    GR[op.des_reg] = result >> 1;
+    FR.SetSigned(GR[op.des_reg]);
+    FR.SetZero(GR[op.des_reg]);
 }
 /*
  *
  */
-void CometII::JumpOnPlus(OpWord opword) {
-    uint16_t jump_adr = EffectiveAdr(opword);
+void CometII::JumpOnPlus(const DecodedOp &op) {
+    uint16_t jump_adr = EffectiveAdr(op);
     if (!FR.IsSigned() && !FR.IsZero()) {
-        if (jump_adr >= ram->size) throw IlleagalAccessError();
+        if (jump_adr >= ram->size) return Stop(CauseOfStop::ILLEGAL_ACCESS);
 
         PR = jump_adr;
     }
 }
-void CometII::JumpOnMinus(OpWord opword) {
-    uint16_t jump_adr = EffectiveAdr(opword);
+void CometII::JumpOnMinus(const DecodedOp &op) {
+    uint16_t jump_adr = EffectiveAdr(op);
     if (FR.IsSigned()) {
-        if (jump_adr >= ram->size) throw IlleagalAccessError();
+        if (jump_adr >= ram->size) return Stop(CauseOfStop::ILLEGAL_ACCESS);
         PR = jump_adr;
     }
 }
-void CometII::JumpOnNonZero(OpWord opword) {
-    uint16_t jump_adr = EffectiveAdr(opword);
+void CometII::JumpOnNonZero(const DecodedOp &op) {
+    uint16_t jump_adr = EffectiveAdr(op);
     if (!FR.IsZero()) {
-        if (jump_adr >= ram->size) throw IlleagalAccessError();
+        if (jump_adr >= ram->size) return Stop(CauseOfStop::ILLEGAL_ACCESS);
         PR = jump_adr;
     }
 }
-void CometII::JumpOnZero(OpWord opword) {
-    uint16_t jump_adr = EffectiveAdr(opword);
+void CometII::JumpOnZero(const DecodedOp &op) {
+    uint16_t jump_adr = EffectiveAdr(op);
     if (FR.IsZero()) {
-        if (jump_adr >= ram->size) throw IlleagalAccessError();
+        if (jump_adr >= ram->size) return Stop(CauseOfStop::ILLEGAL_ACCESS);
         PR = jump_adr;
     }
 }
-void CometII::JumpOnOverflow(OpWord opword) {
-    uint16_t jump_adr = EffectiveAdr(opword);
+void CometII::JumpOnOverflow(const DecodedOp &op) {
+    uint16_t jump_adr = EffectiveAdr(op);
     if (FR.IsOverflow()) {
-        if (jump_adr >= ram->size) throw IlleagalAccessError();
+        if (jump_adr >= ram->size) return Stop(CauseOfStop::ILLEGAL_ACCESS);
         PR = jump_adr;
     }
 }
-void CometII::Jump(OpWord opword) {
-    uint16_t jump_adr = EffectiveAdr(opword);
-    if (jump_adr >= ram->size) throw IlleagalAccessError();
+void CometII::Jump(const DecodedOp &op) {
+    uint16_t jump_adr = EffectiveAdr(op);
+    if (jump_adr >= ram->size) return Stop(CauseOfStop::ILLEGAL_ACCESS);
     PR = jump_adr;
 }
-void CometII::Push(OpWord opword) { StoreData(--SP, EffectiveAdr(opword)); }
-void CometII::Pop(OpWord opword) { GR[opword.des_reg] = FetchWordData(SP++); }
-void CometII::CallSub(OpWord opword) {
-    if (SP == 0) throw StackOverflowError();
+void CometII::Push(const DecodedOp &op) { StoreData(--SP, EffectiveAdr(op)); }
+void CometII::Pop(const DecodedOp &op) {
+    uint16_t data;
+    if (FetchWordData(SP++, data)) GR[op.des_reg] = data;
+}
+void CometII::CallSub(const DecodedOp &op) {
+    // 65536ワードのときは、SP=0がスタックの底になる
+    if (SP == 0 && !IsStackEmpty()) return Stop(CauseOfStop::STACK_OVERFLOW);
 
+    uint16_t call_addr = EffectiveAdr(op);
+    // 戻りアドレスを積めなかったときは、SPとPRを変更せずに停止する
+    if (!StoreData(SP - 1, PR)) return;
     SP--;
-    uint16_t call_addr = EffectiveAdr(opword);
-    StoreData(SP, PR);
     PR = call_addr;
 }
-void CometII::ReturnFromSub(OpWord opword) {
-    if (SP >= ram->size) throw StackUnderflowError();
+void CometII::ReturnFromSub(const DecodedOp &op) {
+    // スタックが空のとき(STARTからのRET)はOSに戻るため、HLTと同じように停止する
+    if (IsStackEmpty()) return Halt(op);
+    if (SP >= ram->size) return Stop(CauseOfStop::STACK_UNDERFLOW);
 
-    PR = FetchWordData(SP);
+    PR = ram->memory[SP].data;
+    if (watch_pages[SP / WATCH_PAGE_WORDS] & WATCH_READ) CheckWatch(SP, PR, PR, false);
     SP++;
 }
-void CometII::Svc(OpWord opword) {
-    SVCNo svc_no = static_cast<SVCNo>(EffectiveAdr(opword));
+void CometII::Svc(const DecodedOp &op) {
+    SVCNo svc_no = static_cast<SVCNo>(EffectiveAdr(op));
     switch (svc_no) {
     case SVCNo::SVC_IN:
-        SvcIn(opword);
+        SvcIn(op);
         break;
 
     case SVCNo::SVC_OUT:
-        SvcOut(opword);
+        SvcOut(op);
         break;
     }
 }
 
-void CometII::SvcIn(OpWord opword) {
-    std::string line;
+void CometII::SvcIn(const DecodedOp &) {
+    // 対話用のときは入力を促す出力を先に表示する
+    if (out_flush_size == 0) FlushSvcOut();
+
+    const char *line = nullptr;
+    uint32_t len = 0;
+    bool ok = false;
+    std::string buf;
+    // 実行履歴を戻したあとは、記録した入力を同じ順に読み込む
+    if (history == nullptr || !history->ReplayInput(line, len, ok)) {
+        if (svc_arena) {
+            ok = svc_arena->Next(line, len);
+        } else {
+            ok = (bool)std::getline(*svc_in, buf);
+            line = buf.data();
+            len = (uint32_t)buf.size();
+        }
+        if (history != nullptr) history->RecordInput(line, len, ok);
+    }
 
-    bool is_ok = (bool)std::getline(*svc_in, line);
+    if (ok) {
+        StoreLine(line, len);
+    } else {
+        StoreData(GR2, -1);
+    }
+}
 
-    if (is_ok) {
-        StoreData(GR2, (uint16_t)line.size());
+void CometII::StoreLine(const char *line, uint32_t len) {
+    if (!StoreData(GR2, (uint16_t)len)) return;
 
-        int i = 0;
-        for (auto c : line) {
-            StoreData(GR1 + i++, c);
+    // 範囲チェックは1回だけ行い、範囲内の文字をまとめて格納する
+    uint32_t avail = GR1 < ram->size ? std::min<uint32_t>(len, ram->size - GR1) : 0;
+    for (uint32_t i = 0; i < avail; i++) {
+        uint32_t adr = GR1 + i;
+        if (watch_pages[adr / WATCH_PAGE_WORDS] & WATCH_WRITE) {
+            CheckWatch(adr, ram->memory[adr].data, static_cast<uint16_t>(line[i]), true);
         }
-    } else {
-        StoreData(GR2, -1);
     }
+    for (uint32_t i = 0; i < avail; i++) ram->memory[GR1 + i].data = static_cast<uint16_t>(line[i]);
+    for (uint32_t i = 0; i < avail; i++) {
+        if (code_map[GR1 + i]) InvalidateCode(GR1 + i);
+    }
+    if (avail < len) Stop(CauseOfStop::ILLEGAL_ACCESS);
+}
+
+void CometII::SvcOut(const DecodedOp &) {
+    uint16_t len;
+    if (!FetchWordData(GR2, len)) return;
+
+    // 範囲チェックは1回だけ行い、範囲内の文字をまとめて出力バッファに詰める
+    uint32_t avail = GR1 < ram->size ? std::min<uint32_t>(len, ram->size - GR1) : 0;
+    // 実行履歴の再実行では出力済みのため出力しない
+    if (history != nullptr && history->IsReplaying()) {
+        if (avail < len) Stop(CauseOfStop::ILLEGAL_ACCESS);
+        return;
+    }
+    size_t pos = out_buf.size();
+    out_buf.resize(pos + avail);
+    for (uint32_t i = 0; i < avail; i++) out_buf[pos + i] = static_cast<char>(ram->memory[GR1 + i].data);
+    for (uint32_t i = 0; i < avail; i++) {
+        uint32_t adr = GR1 + i;
+        if (watch_pages[adr / WATCH_PAGE_WORDS] & WATCH_READ) CheckWatch(adr, out_buf[pos + i], out_buf[pos + i], false);
+    }
+
+    if (avail < len) {
+        FlushSvcOut();
+        return Stop(CauseOfStop::ILLEGAL_ACCESS);
+    }
+    out_buf += '\n';
+    if (out_flush_size == 0 || out_buf.size() >= out_flush_size) FlushSvcOut();
+}
+
+void CometII::FlushSvcOut() {
+    if (out_buf.empty()) return;
+
+    svc_out->write(out_buf.data(), out_buf.size());
+    svc_out->flush();
+    out_buf.clear();
+}
+
+void CometII::Halt(const DecodedOp &) {
+    FR.HLT = ON;
+    Stop(CauseOfStop::HALT);
 }
 
-void CometII::SvcOut(OpWord opword) {
-    uint16_t len = FetchWordData(GR2);
+void CometII::InvalidOp(const DecodedOp &) { Stop(CauseOfStop::INVALID_OPERATION); }
 
-    for (uint16_t i = 0; i < len; i++) {
-        int16_t data = FetchWordData(GR1 + i);
-        *svc_out << static_cast<int8_t>(data);
+bool CometII::Decode(uint16_t adr, DecodedOp &op) {
+    OpWord opword = ram->memory[adr].opword;
+    const OpDef &def = op_defs[opword.op_code];
+
+    op.handler = def.handler;
+    op.op_code = opword.GetOpCode();
+    op.des_reg = opword.des_reg;
+    op.src_reg = opword.src_reg;
+    op.adr = 0;
+    if (def.len == 2) {
+        if (adr + 1u >= ram->size) {
+            Stop(CauseOfStop::ILLEGAL_ACCESS);
+            return false;
+        }
+        op.adr = ram->memory[adr + 1].data;
     }
-    *svc_out << std::endl;  // TODO
+    op.len = def.len;
+    return true;
 }
 
+template <bool HOOK>
 void CometII::ExecOneStep() {
     counter++;
-    WordData word_data = FetchWordData();
-    switch (word_data.opword.GetOpCode()) {
-    case OpCode::LD_M:
-        LoadMem(word_data.opword);
-        break;
-    case OpCode::ST:
-        Store(word_data.opword);
-        break;
-    case OpCode::LAD:
-        LoadAdr(word_data.opword);
-        break;
-    case OpCode::LD_R:
-        LoadReg(word_data.opword);
-        break;
-    case OpCode::ADDA_R:
-        AddAReg(word_data.opword);
-        break;
-    case OpCode::ADDA_M:
-        AddAMem(word_data.opword);
-        break;
-    case OpCode::SUBA_R:
-        SubAReg(word_data.opword);
-        break;
-    case OpCode::SUBA_M:
-        SubAMem(word_data.opword);
-        break;
-    case OpCode::ADDL_R:
-        AddLReg(word_data.opword);
-        break;
-    case OpCode::ADDL_M:
-        AddLMem(word_data.opword);
-        break;
-    case OpCode::SUBL_R:
-        SubLReg(word_data.opword);
-        break;
-    case OpCode::SUBL_M:
-        SubLMem(word_data.opword);
-        break;
-    case OpCode::AND_R:
-        AndReg(word_data.opword);
-        break;
-    case OpCode::AND_M:
-        AndMem(word_data.opword);
-        break;
-    case OpCode::OR_R:
-        OrReg(word_data.opword);
-        break;
-    case OpCode::OR_M:
-        OrMem(word_data.opword);
-        break;
-    case OpCode::XOR_R:
-        XorReg(word_data.opword);
-        break;
-    case OpCode::XOR_M:
-        XorMem(word_data.opword);
-        break;
-    case OpCode::CPA_R:
-        CompAReg(word_data.opword);
-        break;
-    case OpCode::CPL_R:
-        CompLReg(word_data.opword);
-        break;
-    case OpCode::CPA_M:
-        CompAMem(word_data.opword);
-        break;
-    case OpCode::CPL_M:
-        CompLMem(word_data.opword);
-        break;
-    case OpCode::SLA:
-        ShiftLeftA(word_data.opword);
-        break;
-    case OpCode::SRA:
-        ShiftRightA(word_data.opword);
-        break;
-    case OpCode::SLL:
-        ShiftLeftL(word_data.opword);
-        break;
-    case OpCode::SRL:
-        ShiftRightL(word_data.opword);
-        break;
-    case OpCode::JPL:
-        JumpOnPlus(word_data.opword);
-        break;
-    case OpCode::JMI:
-        JumpOnMinus(word_data.opword);
-        break;
-    case OpCode::JNZ:
-        JumpOnNonZero(word_data.opword);
-        break;
-    case OpCode::JZE:
-        JumpOnZero(word_data.opword);
-        break;
-    case OpCode::JOV:
-        JumpOnOverflow(word_data.opword);
-        break;
-    case OpCode::JUMP:
-        Jump(word_data.opword);
-        break;
-    case OpCode::PUSH:
-        Push(word_data.opword);
-        break;
-    case OpCode::POP:
-        Pop(word_data.opword);
-        break;
-    case OpCode::CALL:
-        CallSub(word_data.opword);
-        break;
-    case OpCode::RET:
-        ReturnFromSub(word_data.opword);
-        break;
-    case OpCode::SVC:
-        Svc(word_data.opword);
-        break;
-    case OpCode::HLT:
-        FR.HLT = ON;
-        break;
-    default:
-        throw InvalidOperationError();
-        // FR.HLT = ON;
-        break;
+
+    DecodedOp decoded;
+    const DecodedOp *op = FetchDecoded(decoded);
+    if (op == nullptr) return;
+    if (!HOOK) {
+        PR += op->len;
+        (this->*op->handler)(*op);
+        return;
     }
+
+    // 自己書き換えでデコードキャッシュが無効になり、命令でレジスタが変わるため、実行前に取り出しておく
+    uint16_t adr = PR;
+    OpCode op_code = op->op_code;
+    uint8_t len = op->len;
+    uint16_t opword = ram->memory[adr].data;
+    uint16_t ea = len == 2 ? EffectiveAdr(*op) : 0;
+    auto packed_fr = [this] { return (uint8_t)(FR.OF | (FR.SF << 1) | (FR.ZF << 2)); };
+    if (tracer != nullptr && !tracer->Continues(counter, adr)) tracer->Seed(GR, SP, packed_fr());
+    PR += len;
+    (this->*op->handler)(*op);
+    if (profiler != nullptr) profiler->Record(adr, op_code, len, PR, stop == CauseOfStop::OK);
+    if (tracer != nullptr) tracer->Record(counter, adr, opword, len, ea, GR, SP, packed_fr(), PR);
+    if (history != nullptr) history->Record(op_code, ea);
 }
 
 }  // namespace cii
@@ -4,17 +4,16 @@
 #include <algorithm>
 #include <array>
 #include <cstdint>
-#include <exception>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <vector>
 
-namespace cii {
-class CommetError : public std::exception {};
-class InvalidOperationError : public CommetError {};
-class IlleagalAccessError : public CommetError {};
-class StackOverflowError : public CommetError {};
-class StackUnderflowError : public CommetError {};
+#include "input_arena.h"
+#include "page_array.h"
 
+namespace cii {
 enum class CauseOfStop {
     OK,
     SINGLE_STEP,
@@ -24,6 +23,9 @@ enum class CauseOfStop {
     STACK_OVERFLOW,
     STACK_UNDERFLOW,
     BREAK_POINT,
+    STEP_LIMIT,   //!< 指定ステップ数を実行した
+    CONDITION,    //!< 停止条件を満たした
+    WATCH_POINT,  //!< ウォッチポイントの条件を満たした
 };
 /**
  * @enum class Reg
@@ -98,6 +100,16 @@ enum class OpCode : uint8_t {
     HLT,
 };
 
+/**
+ * @enum class ExecEngine
+ * 命令実行エンジン
+ */
+enum class ExecEngine {
+    CALL,      //!< ハンドラテーブルによる呼び出し
+    THREADED,  //!< computed gotoによるスレッデッドコード(GCC/Clang以外はCALLと同じ)
+    JIT,       //!< 実行回数の多い基本ブロックをx86-64にコンパイルする(使用できないときはTHREADED)
+};
+
 enum class SVCNo : uint16_t {
     SVC_IN = 1,
     SVC_OUT,
@@ -113,6 +125,27 @@ constexpr int32_t MAX_WORD_NUM = (int32_t)((int16_t)0x7fff);
 
 inline Flag IsSigned(uint16_t v) { return (v & SIGNED_BIT) ? ON : OFF; }
 
+/**
+ * 命令コードの名前を返す
+ * @return
+ * 名前(LD_M、ADDA_Rなど)、命令コードでないときはnullptr
+ */
+const char *GetOpName(OpCode op);
+/**
+ * 停止要因の名前を返す
+ * @return
+ * 名前(HALT、STACK_UNDERFLOWなど)
+ */
+const char *GetCauseName(CauseOfStop cause);
+
+/**
+ * 基本ブロックの最後になる命令(分岐、コール、リターン、SVC、HALT)かどうかを返す
+ */
+inline bool IsBlockEnd(OpCode op) {
+    return (op >= OpCode::JPL && op <= OpCode::JUMP) || op == OpCode::CALL || op == OpCode::RET ||
+           op == OpCode::SVC || op == OpCode::HLT;
+}
+
 /**
  * 命令ワード
  */
@@ -155,6 +188,101 @@ struct OpWord {
     OpCode GetOpCode() const { return static_cast<OpCode>(op_code); }
 };
 
+class CometII;
+class JitX64;
+class Profiler;
+class Tracer;
+class History;
+
+/**
+ * @struct
+ * デコード済み命令
+ */
+struct DecodedOp {
+    //! 命令ハンドラ
+    using Handler = void (CometII::*)(const DecodedOp &);
+
+    Handler handler;   //!< 命令ハンドラ
+    uint16_t adr;      //!< アドレス部(2語命令の第2語)
+    uint8_t des_reg;   //!< 代入先レジスタ番号
+    uint8_t src_reg;   //!< ソースレジスタ番号
+    OpCode op_code;    //!< 命令コード
+    uint8_t len;       //!< 命令語長(0:未デコード)
+};
+
+/**
+ * @brief ブレークポイントの停止条件
+ * @note
+ * 停止するときにtrueを返す
+ */
+using BreakCond = std::function<bool(const CometII &)>;
+
+/**
+ * @struct
+ * ブレークポイント
+ */
+struct BreakPoint {
+    uint16_t adr;           //!< アドレス
+    BreakCond cond;         //!< 停止条件(空のときは無条件)
+    uint32_t ignore_count;  //!< 停止せずに通過する回数
+    uint32_t hit_count;     //!< 停止条件を満たした回数
+};
+
+/**
+ * @enum class WatchType
+ * ウォッチポイントの種類
+ */
+enum class WatchType : uint8_t {
+    WRITE,   //!< 値が変わる書き込み
+    READ,    //!< 読み込み
+    ACCESS,  //!< 読み込みまたは書き込み
+    VALUE,   //!< 指定した値の書き込み
+};
+
+/**
+ * @struct
+ * ウォッチポイント
+ */
+struct WatchPoint {
+    uint16_t start;  //!< 開始アドレス
+    uint16_t end;    //!< 終了アドレス(含む)
+    WatchType type;  //!< 種類
+    uint16_t value;  //!< VALUEのときの値
+};
+
+/**
+ * @struct
+ * ウォッチポイントで停止したアクセス
+ */
+struct WatchHit {
+    WatchPoint point;   //!< 条件を満たしたウォッチポイント
+    uint16_t adr;       //!< アクセスしたアドレス
+    uint16_t old_data;  //!< アクセス前の値
+    uint16_t data;      //!< アクセス後の値
+    bool write;         //!< 書き込み
+};
+
+/**
+ * @struct
+ * 実行結果
+ */
+struct RunResult {
+    CauseOfStop cause;  //!< 停止要因
+    uint32_t steps;     //!< 実行した命令数
+};
+
+/**
+ * @struct
+ * メモリ以外のCPUの状態
+ */
+struct CpuState {
+    uint16_t gr[8];    //!< 汎用レジスタ
+    uint16_t sp;       //!< SP
+    uint16_t pr;       //!< PR
+    uint8_t fr;        //!< FR(OF:bit0、SF:bit1、ZF:bit2)
+    uint32_t counter;  //!< 実行命令数
+};
+
 /**
  * CommetII ワードデータ定義
  */
@@ -184,9 +312,27 @@ class CometII {
     uint16_t GR[8];  //!< 汎用レジスタ配列
     std::ostream *svc_out;
     std::istream *svc_in;
-    std::vector<uint16_t> break_points;
+    InputArena *svc_arena;  //!< SVC INの入力元(nullptrのときはsvc_inから読み込む)
+    std::string out_buf;    //!< SVC OUTの出力バッファ
+    size_t out_flush_size;  //!< 出力バッファをフラッシュするサイズ(0:1行ごと)
+    std::vector<BreakPoint> break_points;  //!< ブレークポイント
+    cmn::PageArray<uint32_t> break_map;    //!< アドレスごとのブレークポイント番号+1(0:なし)
+    std::vector<WatchPoint> watch_points;  //!< ウォッチポイント
+    std::vector<uint8_t> watch_pages;      //!< ページごとのウォッチの種類(WATCH_READ、WATCH_WRITE)
+    WatchHit watch_hit;                    //!< 最後に停止したウォッチポイントのアクセス
     uint16_t pre_pr;
     uint32_t counter;
+    uint32_t step_end;                    //!< RunForで停止するcounterの値
+    CauseOfStop stop;                     //!< 命令の実行で発生した停止要因
+    cmn::PageArray<DecodedOp> decode_cache;  //!< アドレスごとのデコード済み命令
+    std::vector<uint16_t> decoded_adrs;   //!< デコードキャッシュに登録したアドレス(メモリサイズまで)
+    bool use_decode_cache;                //!< デコードキャッシュを使用する
+    ExecEngine engine;                    //!< 命令実行エンジン
+    cmn::PageArray<uint8_t> code_map;     //!< アドレスごとの命令(デコード済み、コンパイル済み)フラグ
+    std::unique_ptr<JitX64> jit;          //!< JITコンパイラ
+    Profiler *profiler;                   //!< 実行プロファイラ(nullptrのときは記録しない)
+    Tracer *tracer;                       //!< 命令トレース(nullptrのときは記録しない)
+    History *history;                     //!< 実行履歴(nullptrのときは記録しない)
     /**
      * フラグレジスタ
      */
@@ -313,6 +459,16 @@ class CometII {
     FlagReg FR;             //!< フラグレジスタ
 
    public:
+#if defined(__GNUC__)
+    static constexpr ExecEngine DEFAULT_ENGINE = ExecEngine::THREADED;
+#else
+    static constexpr ExecEngine DEFAULT_ENGINE = ExecEngine::CALL;
+#endif
+    //! SVC OUTの出力バッファをフラッシュするサイズの既定値
+    static constexpr size_t DEFAULT_OUT_FLUSH_SIZE = 64 * 1024;
+    //! ウォッチポイントのページのワード数
+    static constexpr uint32_t WATCH_PAGE_WORDS = 256;
+
     CometII(Memory *mem, std::ostream &out = std::cout, std::istream &in = std::cin);
     virtual ~CometII();
     /**
@@ -325,29 +481,187 @@ class CometII {
      * CommetII実行
      */
     CauseOfStop Run();
+    /**
+     * @brief
+     * 指定ステップ数を上限に実行する
+     * @param max_steps
+     * 実行する最大命令数
+     * @return
+     * 停止要因と実行した命令数。上限に達したときはSTEP_LIMIT
+     */
+    RunResult RunFor(uint32_t max_steps);
+    /**
+     * @brief
+     * 停止条件を満たすまで実行する
+     * @param cond
+     * 停止条件。各命令の実行前に評価する
+     * @param max_steps
+     * 実行する最大命令数
+     * @return
+     * 停止要因と実行した命令数。停止条件を満たしたときはCONDITION
+     */
+    RunResult RunUntil(const BreakCond &cond, uint32_t max_steps = UINT32_MAX);
 
-    void SetSvcIn(std::istream &is) { svc_in = &is; }
-    void SetSvcOut(std::ostream &os) { svc_out = &os; }
+    void SetSvcIn(std::istream &is) {
+        svc_in = &is;
+        svc_arena = nullptr;
+    }
+    /**
+     * @brief 読み込み済みの入力をSVC INの入力元にする
+     * @param arena 入力。次の行から読み込む
+     */
+    void SetSvcIn(InputArena &arena) { svc_arena = &arena; }
+    void SetSvcOut(std::ostream &os) {
+        FlushSvcOut();
+        svc_out = &os;
+    }
+    /**
+     * @brief SVC OUTの出力バッファリングを設定する
+     * @param flush_size
+     * 出力バッファをフラッシュするサイズ。0のときは1行ごとにフラッシュし、SVC INの前にもフラッシュする(対話用)
+     * @note
+     * バッファはこのサイズに達したときと、Run、RunFor、RunUntilから戻るときにフラッシュする
+     */
+    void SetSvcOutBuffer(size_t flush_size) {
+        out_flush_size = flush_size;
+        if (flush_size == 0) FlushSvcOut();
+    }
+    size_t GetSvcOutBuffer() const { return out_flush_size; }
+    /**
+     * @brief SVC OUTの出力バッファを出力先に書き込む
+     */
+    void FlushSvcOut();
 
     uint16_t GetReg(int reg_no) const { return GR[reg_no]; }
 
     const Memory &GetMemory() const { return *ram; }
+    /**
+     * @brief メモリを取得する
+     * @note
+     * 書き換えたあとはResetまたはInvalidateDecodeCacheを呼び出すこと
+     */
+    Memory &GetMemory() { return *ram; }
+    /**
+     * @brief JITコンパイラを取得する
+     * @return const JitX64* JITで実行していないときはnullptr
+     */
+    const JitX64 *GetJit() const { return jit.get(); }
 
-    void SetBreakPoint(uint16_t point) {
-        auto itr = std::find(break_points.begin(), break_points.end(), point);
-        if (itr == break_points.end()) {
-            break_points.push_back(point);
-        }
+    /**
+     * @brief ブレークポイントを設定する
+     * @param point アドレス
+     * @param cond 停止条件(空のときは無条件)
+     * @param ignore_count 停止せずに通過する回数
+     * @note
+     * 設定済みのときは停止条件と通過回数を置き換える
+     */
+    void SetBreakPoint(uint16_t point, BreakCond cond = nullptr, uint32_t ignore_count = 0);
+    /**
+     * @brief ブレークポイントを削除する
+     * @param point アドレス
+     */
+    void DeleteBreakPoint(uint16_t point);
+    const std::vector<BreakPoint> &GetBreakPoints() const { return break_points; }
+    /**
+     * @brief 指定アドレスのブレークポイントを取得する
+     * @param point アドレス
+     * @return const BreakPoint* ブレークポイント、ないときはnullptr
+     */
+    const BreakPoint *FindBreakPoint(uint16_t point) const {
+        if (point >= break_map.size() || break_map[point] == 0) return nullptr;
+        return &break_points[break_map[point] - 1];
     }
+    uint32_t GetExcutedCounter() const { return counter; }
 
-    void DeleteBreakPoint(uint16_t point) {
-        auto itr = std::find(break_points.begin(), break_points.end(), point);
-        if (itr != break_points.end()) {
-            break_points.erase(itr);
-        }
+    /**
+     * @brief ウォッチポイントを設定する
+     * @param start 開始アドレス
+     * @param end 終了アドレス(含む)
+     * @param type 種類
+     * @param value VALUEのときの値
+     * @note
+     * 範囲が同じウォッチポイントは種類と値を置き換える。設定中はJITを使用せずTHREADEDで実行する。
+     * 条件を満たしたときは、その命令を実行してからWATCH_POINTで停止する
+     */
+    void SetWatchPoint(uint16_t start, uint16_t end, WatchType type, uint16_t value = 0);
+    /**
+     * @brief 開始アドレスが同じウォッチポイントを削除する
+     * @param start 開始アドレス
+     */
+    void DeleteWatchPoint(uint16_t start);
+    const std::vector<WatchPoint> &GetWatchPoints() const { return watch_points; }
+    /**
+     * @brief 最後にウォッチポイントで停止したアクセスを取得する
+     */
+    const WatchHit &GetWatchHit() const { return watch_hit; }
+    /**
+     * @brief 記録を行う実行ループで実行するかどうかを返す
+     * @note
+     * プロファイラ、トレース、実行履歴のいずれかを設定しているときは、エンジンの指定にかかわらずCALLで実行する
+     */
+    bool IsHooked() const { return profiler != nullptr || tracer != nullptr || history != nullptr; }
+
+    /**
+     * @brief デコードキャッシュの使用有無を設定する
+     * @param on true:使用する
+     */
+    void SetDecodeCache(bool on) {
+        use_decode_cache = on;
+        InvalidateDecodeCache();
     }
-    const std::vector<uint16_t> &GetBreakPoints() const { return break_points; }
-    uint32_t GetExcutedCounter() const { return counter; }
+    bool IsDecodeCache() const { return use_decode_cache; }
+    /**
+     * @brief デコードキャッシュをすべて無効にする
+     * @note
+     * CometIIを経由せずにメモリを書き換えたときに呼び出す
+     */
+    void InvalidateDecodeCache();
+
+    void SetEngine(ExecEngine e) { engine = e; }
+    ExecEngine GetEngine() const { return engine; }
+
+    /**
+     * @brief 実行プロファイラを設定する
+     * @param p プロファイラ(nullptrのときは記録しない)。所有はしない
+     * @note
+     * 記録中はエンジンによらずCALLで実行する。記録しないときの実行ループは記録の判定を含まない
+     */
+    void SetProfiler(Profiler *p) { profiler = p; }
+    Profiler *GetProfiler() const { return profiler; }
+    /**
+     * @brief 命令トレースを設定する
+     * @param t トレース(nullptrのときは記録しない)。所有はしない
+     * @note
+     * プロファイラと同じく、記録中はエンジンによらずCALLで実行する
+     */
+    void SetTracer(Tracer *t) { tracer = t; }
+    Tracer *GetTracer() const { return tracer; }
+    /**
+     * @brief 実行履歴を設定する
+     * @param h 実行履歴(nullptrのときは記録しない)。所有はしない
+     * @note
+     * プロファイラと同じく、記録中はエンジンによらずCALLで実行する。
+     * 履歴の再実行中はブレークポイントで停止せず、SVC INは記録した入力を読み込み、SVC OUTは出力しない
+     */
+    void SetHistory(History *h) { history = h; }
+    History *GetHistory() const { return history; }
+
+    /**
+     * @brief メモリ以外の状態を取得する
+     */
+    CpuState GetState() const;
+    /**
+     * @brief メモリ以外の状態を設定する
+     * @note
+     * HALTフラグとシングルステップフラグはクリアする
+     */
+    void SetState(const CpuState &state);
+    /**
+     * @brief 次の実行の最初は、現在のPRのブレークポイントで停止しないようにする
+     * @note
+     * ブレークポイントで停止したときと同じ状態にする
+     */
+    void SkipBreakPoint() { pre_pr = PR; }
 
    protected:
     /**
@@ -359,18 +673,43 @@ class CometII {
      * PRは更新される
      */
     inline WordData FetchWordData() { return ram->memory[PR++]; }
+    /**
+     * @brief
+     * 停止要因を設定する。命令の実行後に停止する
+     * @param cause
+     * 停止要因
+     */
+    inline void Stop(CauseOfStop cause) { stop = cause; }
+    /**
+     * @brief
+     * 停止要因を取り出してクリアする
+     * @return
+     * 停止要因
+     */
+    inline CauseOfStop TakeStop() {
+        CauseOfStop cause = stop;
+        stop = CauseOfStop::OK;
+        return cause;
+    }
     /**
      * @brief
      * 指定アドレスのワードデータをフェッチする
      * @param adr
      * フェッチアドレス
-     * @return
+     * @param data
      * ワードデータ
+     * @return
+     * false 範囲外アクセス(ILLEGAL_ACCESSで停止する)
      */
-    inline uint16_t FetchWordData(uint16_t adr) {
-        if (adr >= ram->size) throw IlleagalAccessError();
+    inline bool FetchWordData(uint16_t adr, uint16_t &data) {
+        if (adr >= ram->size) {
+            Stop(CauseOfStop::ILLEGAL_ACCESS);
+            return false;
+        }
 
-        return ram->memory[adr].data;
+        data = ram->memory[adr].data;
+        if (watch_pages[adr / WATCH_PAGE_WORDS] & WATCH_READ) CheckWatch(adr, data, data, false);
+        return true;
     }
     /**
      * @brief
@@ -379,12 +718,49 @@ class CometII {
      * ストアアドレス
      * @param data
      * ストアデータ
+     * @return
+     * false 範囲外アクセス(ILLEGAL_ACCESSで停止する)
      */
-    inline void StoreData(uint16_t adr, uint16_t data) {
-        if (adr >= ram->size) throw IlleagalAccessError();
+    inline bool StoreData(uint16_t adr, uint16_t data) {
+        if (adr >= ram->size) {
+            Stop(CauseOfStop::ILLEGAL_ACCESS);
+            return false;
+        }
 
+        if (watch_pages[adr / WATCH_PAGE_WORDS] & WATCH_WRITE) CheckWatch(adr, ram->memory[adr].data, data, true);
         ram->memory[adr].data = data;
+        if (code_map[adr]) InvalidateCode(adr);
+        return true;
     }
+    /**
+     * @brief
+     * 指定アドレスを含む命令のデコードキャッシュとコンパイル済みブロックを無効にする
+     * @param adr
+     * 書き換えたアドレス
+     * @note
+     * 2語命令の第2語の書き換えに対応するため、直前のアドレスも無効にする
+     */
+    void InvalidateCode(uint16_t adr);
+    /**
+     * @brief
+     * ウォッチポイントの条件を判定し、満たしたときは停止要因を設定する
+     * @param adr
+     * アクセスしたアドレス
+     * @param old_data
+     * アクセス前の値
+     * @param data
+     * アクセス後の値
+     * @param write
+     * 書き込み
+     */
+    void CheckWatch(uint16_t adr, uint16_t old_data, uint16_t data, bool write);
+    /**
+     * @brief
+     * スタックが空かどうかを返す
+     * @note
+     * スタックの底はメモリワードサイズ(65536ワードのときは0)
+     */
+    inline bool IsStackEmpty() const { return SP == static_cast<uint16_t>(ram->size); }
     /**
      * @brief
      * ワードデータを符号あり32bitに変換する
@@ -393,55 +769,173 @@ class CometII {
      */
     inline int32_t signed_cast32(uint16_t data) { return static_cast<int32_t>(static_cast<int16_t>(data)); }
 
+    template <bool LIMIT>
+    CauseOfStop RunEngine();
+    template <bool BREAK, bool LIMIT, bool HOOK>
+    CauseOfStop RunCall();
+    template <bool BREAK, bool LIMIT>
+    CauseOfStop RunThreaded();
+    CauseOfStop RunJit(bool limit);
+    /**
+     * @brief
+     * 指定範囲にブレークポイントがあるかどうかを返す
+     * @param start
+     * 開始アドレス
+     * @param end
+     * 終了アドレス(含まない)
+     */
+    bool HasBreakPoint(uint16_t start, uint16_t end) const {
+        if (break_points.empty()) return false;
+        return std::any_of(break_map.begin() + start, break_map.begin() + end, [](uint32_t no) { return no != 0; });
+    }
+    /**
+     * @brief
+     * 1命令を実行する
+     * @tparam HOOK
+     * プロファイラ、トレース、実行履歴に記録する
+     */
+    template <bool HOOK>
     void ExecOneStep();
-    uint16_t EffectiveAdr(OpWord opword);
-    void LoadReg(OpWord opword);
-    void LoadMem(OpWord opword);
-    void Store(OpWord opword);
-    void LoadAdr(OpWord opword);
-    void AddAReg(OpWord opword);
-    void AddAMem(OpWord opword);
-    void SubAReg(OpWord opword);
-    void SubAMem(OpWord opword);
-    void AddLReg(OpWord opword);
-    void AddLMem(OpWord opword);
-    void SubLReg(OpWord opword);
-    void SubLMem(OpWord opword);
+    /**
+     * @brief
+     * ブレークポイントで停止するかどうかを判定する
+     * @return
+     * true 停止する
+     * @note
+     * ブレークポイントで停止した直後の再実行では同じアドレスで停止しない
+     */
+    inline bool IsBreak() {
+        if (pre_pr != PR && PR < break_map.size() && break_map[PR] != 0) {
+            if (HitBreakPoint(break_points[break_map[PR] - 1])) {
+                pre_pr = PR;
+                return true;
+            }
+        }
+        pre_pr = -1;
+        return false;
+    }
+    /**
+     * @brief
+     * ブレークポイントの停止条件を評価し、到達回数を数える
+     * @param bp
+     * ブレークポイント
+     * @return
+     * true 停止する
+     */
+    bool HitBreakPoint(BreakPoint &bp);
+    /**
+     * @brief
+     * PRがさす命令のデコード結果を取得する
+     * @param decoded
+     * デコードキャッシュを使用しないときのデコード先
+     * @return
+     * デコード済み命令、範囲外アクセスのときはnullptr
+     */
+    inline const DecodedOp *FetchDecoded(DecodedOp &decoded) {
+        if (PR >= ram->size) {
+            Stop(CauseOfStop::ILLEGAL_ACCESS);
+            return nullptr;
+        }
+
+        if (use_decode_cache) {
+            DecodedOp &cached = decode_cache[PR];
+            if (cached.len == 0) {
+                if (!Decode(PR, cached)) return nullptr;
+                if (decoded_adrs.size() < ram->size) decoded_adrs.push_back(PR);
+                code_map[PR] = 1;
+                if (cached.len == 2) code_map[PR + 1] = 1;
+            }
+            return &cached;
+        }
+        return Decode(PR, decoded) ? &decoded : nullptr;
+    }
+    /**
+     * @brief
+     * 指定アドレスの命令をデコードする
+     * @param adr
+     * 命令アドレス
+     * @param op
+     * デコード結果
+     * @return
+     * false 範囲外アクセス(ILLEGAL_ACCESSで停止する)
+     */
+    bool Decode(uint16_t adr, DecodedOp &op);
+    uint16_t EffectiveAdr(const DecodedOp &op) const;
+    void LoadReg(const DecodedOp &op);
+    void LoadMem(const DecodedOp &op);
+    void Store(const DecodedOp &op);
+    void LoadAdr(const DecodedOp &op);
+    void AddAReg(const DecodedOp &op);
+    void AddAMem(const DecodedOp &op);
+    void SubAReg(const DecodedOp &op);
+    void SubAMem(const DecodedOp &op);
+    void AddLReg(const DecodedOp &op);
+    void AddLMem(const DecodedOp &op);
+    void SubLReg(const DecodedOp &op);
+    void SubLMem(const DecodedOp &op);
     void AddA(uint16_t &des, uint16_t src);
     void SubA(uint16_t &des, uint16_t src);
     void AddL(uint16_t &des, uint16_t src);
     void SubL(uint16_t &des, uint16_t src);
-    void AndReg(OpWord opword);
-    void AndMem(OpWord opword);
-    void OrReg(OpWord opword);
-    void OrMem(OpWord opword);
-    void XorReg(OpWord opword);
-    void XorMem(OpWord opword);
-    void CompAReg(OpWord opword);
-    void CompLReg(OpWord opword);
-    void CompAMem(OpWord opword);
-    void CompLMem(OpWord opword);
+    void AndReg(const DecodedOp &op);
+    void AndMem(const DecodedOp &op);
+    void OrReg(const DecodedOp &op);
+    void OrMem(const DecodedOp &op);
+    void XorReg(const DecodedOp &op);
+    void XorMem(const DecodedOp &op);
+    void CompAReg(const DecodedOp &op);
+    void CompLReg(const DecodedOp &op);
+    void CompAMem(const DecodedOp &op);
+    void CompLMem(const DecodedOp &op);
 
     Flag IsSigned(uint16_t v);
 
-    void ShiftLeftA(OpWord opword);
-
-    void ShiftRightA(OpWord opword);
-    void ShiftLeftL(OpWord opword);
-    void ShiftRightL(OpWord opword);
-    void JumpOnPlus(OpWord opword);
-    void JumpOnMinus(OpWord opword);
-    void JumpOnNonZero(OpWord opword);
-    void JumpOnZero(OpWord opword);
-    void JumpOnOverflow(OpWord opword);
-    void Jump(OpWord opword);
-    void Push(OpWord opword);
-    void Pop(OpWord opword);
-    void CallSub(OpWord opword);
-    void ReturnFromSub(OpWord opword);
-    void Svc(OpWord opword);
-    void SvcIn(OpWord opword);
-    void SvcOut(OpWord opword);
+    void ShiftLeftA(const DecodedOp &op);
+
+    void ShiftRightA(const DecodedOp &op);
+    void ShiftLeftL(const DecodedOp &op);
+    void ShiftRightL(const DecodedOp &op);
+    void JumpOnPlus(const DecodedOp &op);
+    void JumpOnMinus(const DecodedOp &op);
+    void JumpOnNonZero(const DecodedOp &op);
+    void JumpOnZero(const DecodedOp &op);
+    void JumpOnOverflow(const DecodedOp &op);
+    void Jump(const DecodedOp &op);
+    void Push(const DecodedOp &op);
+    void Pop(const DecodedOp &op);
+    void CallSub(const DecodedOp &op);
+    void ReturnFromSub(const DecodedOp &op);
+    void Svc(const DecodedOp &op);
+    void SvcIn(const DecodedOp &op);
+    void SvcOut(const DecodedOp &op);
+    /**
+     * @brief SVC INで読み込んだ1行をGR1からのメモリに格納する
+     * @param line 行の先頭
+     * @param len 行の長さ
+     */
+    void StoreLine(const char *line, uint32_t len);
+    void Halt(const DecodedOp &op);
+    void InvalidOp(const DecodedOp &op);
+
+   private:
+    //! ページのウォッチの種類
+    enum : uint8_t {
+        WATCH_READ = 0x01,   //!< 読み込みを判定する
+        WATCH_WRITE = 0x02,  //!< 書き込みを判定する
+    };
+    /**
+     * @brief ウォッチポイントからページごとのウォッチの種類を作成し直す
+     */
+    void UpdateWatchPages();
+    /**
+     * @brief 命令コードごとのハンドラと命令語長
+     */
+    struct OpDef {
+        DecodedOp::Handler handler;
+        uint8_t len;
+    };
+    static const std::array<OpDef, 256> op_defs;
+    static std::array<OpDef, 256> MakeOpDefs();
 };
 // test
 // test2
@@ -81,6 +81,25 @@ inline std::ostream& operator<<(std::ostream& os, cmn::Color c) {
  */
 static std::ostream& C = std::cout;
 
+/**
+ * @class
+ * 標準出力を標準エラー出力に切り替え、Restoreを呼ぶかスコープを抜けると元に戻す
+ */
+class CoutToCerr {
+   public:
+    explicit CoutToCerr(bool enable = true) : cout_buf(enable ? std::cout.rdbuf(std::cerr.rdbuf()) : nullptr) {}
+    ~CoutToCerr() { Restore(); }
+    CoutToCerr(const CoutToCerr&) = delete;
+    CoutToCerr& operator=(const CoutToCerr&) = delete;
+    void Restore() {
+        if (cout_buf != nullptr) std::cout.rdbuf(cout_buf);
+        cout_buf = nullptr;
+    }
+
+   private:
+    std::streambuf* cout_buf;
+};
+
 }  // namespace cmn
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "assem_mem.h"
 #include "comet_ii.h"
+#include "page_array.h"
 
 namespace cii {
 
@@ -11,15 +12,25 @@ namespace cii {
  *
  */
 struct CommetIIEnv {
-    //! メモリワードサイズ
-    static const size_t MEM_SIZE = 1024 * 4;
+    //! メモリワードサイズの既定値
+    static constexpr uint32_t DEFAULT_MEM_SIZE = 1024 * 4;
+    //! メモリワードサイズの最大値(アドレス空間全体)
+    static constexpr uint32_t MAX_MEM_SIZE = 0x10000;
 
-    //! メモリ
-    cii::WordData words[MEM_SIZE];
+    //! メモリ(ページ単位で遅延確保する)
+    cmn::PageArray<cii::WordData> words;
     //! メモリ定義
-    cii::AssmMem mem = {(uint32_t)MEM_SIZE, words, 0};
+    cii::AssmMem mem;
     //! commentII環境
-    cii::CometII cii_cpu = {&mem};
+    cii::CometII cii_cpu;
+
+    /**
+     * @brief Construct a new Commet I I Env object
+     *
+     * @param mem_size メモリワードサイズ(MAX_MEM_SIZE以下)
+     */
+    explicit CommetIIEnv(uint32_t mem_size = DEFAULT_MEM_SIZE)
+        : words(mem_size), mem(mem_size, words.data(), 0), cii_cpu(&mem) {}
 };
 }  // namespace cii
 
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <cctype>
 #include <locale>
+#include <sstream>
 
 #include "common.h"
 #include "reader.h"
@@ -49,13 +50,28 @@ static const CmdDef cmds[] = {
     {"R", "全レジスタ表示", "R", CmdId::SHOW_REG_ALL, CmdParam::NO_PARAM},
     {"L", "ソースリスト表示。offsetの指定がないときは、PRレジスタが指す位置から最後まで表示",
      "L [start offset] [end offset]", CmdId::LIST_SRC, CmdParam::OPT_NUM1},
-    {"S", "シングルステップ", "S", CmdId::SINGLE_STEP, CmdParam::NO_PARAM},
+    {"S", "シングルステップ。ステップ数の指定があるときは、その命令数を実行", "S [steps]", CmdId::SINGLE_STEP,
+     CmdParam::OPT_NUM1},
     {"C", "現在状態からの実行", "C", CmdId::CONTINUE, CmdParam::NO_PARAM},
     {"BP", "ブレークポイントの設定", "BP [offset1] [offset2] ...", CmdId::BREAK_POINT, CmdParam::NUM1},
     {"BC", "全ブレークポイントのクリアまたは指定ブレークポイントのクリア", "BC * | offset1 [offset2] ...",
      CmdId::CLEAR_BREAK_POINTS, CmdParam::NUM1},
     {"GO", "レジスタをリセットして実行", "GO", CmdId::RUN, CmdParam::NO_PARAM},
     {"RESET", "レジスタをリセット", "RESET", CmdId::RESET, CmdParam::NO_PARAM},
+    {"PROF", "プロファイル。ONで記録を開始、OFFで終了。指定がないときは実行回数の多い行などを表示",
+     "PROF [ON | OFF | lines]", CmdId::PROFILE, CmdParam::OPT_NUM1},
+    {"T", "命令トレース。ONで記録を開始、OFFで終了。指定がないときは最後に実行した命令を表示",
+     "T [ON | OFF | steps]", CmdId::TRACE, CmdParam::OPT_NUM1},
+    {"RS", "逆ステップ。ステップ数の指定があるときは、その命令数を戻る", "RS [steps]", CmdId::REVERSE_STEP,
+     CmdParam::OPT_NUM1},
+    {"RC", "前に到達したブレークポイントまたはウォッチポイントまで戻る", "RC", CmdId::REVERSE_CONTINUE,
+     CmdParam::NO_PARAM},
+    {"W",
+     "ウォッチポイントの設定。Wは値が変わる書き込み(既定)、Rは読み込み、RWは読み書き、=valueはその値の書き込みで停止",
+     "W offset [end offset] [W | R | RW | =value]", CmdId::WATCH_POINT, CmdParam::NUM1},
+    {"WC", "全ウォッチポイントのクリアまたは指定ウォッチポイントのクリア", "WC * | offset1 [offset2] ...",
+     CmdId::CLEAR_WATCH_POINTS, CmdParam::NUM1},
+    {"WL", "ウォッチポイントの一覧", "WL", CmdId::LIST_WATCH_POINTS, CmdParam::NO_PARAM},
     {"GR0", "GR0の表示", "GR0", CmdId::SHOW_REG_GR0, CmdParam::NO_PARAM},
     {"GR1", "GR1の表示", "GR1", CmdId::SHOW_REG_GR1, CmdParam::NO_PARAM},
     {"GR2", "GR2の表示", "GR2", CmdId::SHOW_REG_GR2, CmdParam::NO_PARAM},
@@ -71,7 +87,7 @@ static const CmdDef cmds[] = {
     {"R", "Print All Registers", "R", CmdId::SHOW_REG_ALL, CmdParam::NO_PARAM},
     {"L", "List Sources. Default start offset is PR reg.", "L [start offset] [end offset]", CmdId::LIST_SRC,
      CmdParam::OPT_NUM1},
-    {"S", "Single Step", "S", CmdId::SINGLE_STEP, CmdParam::NO_PARAM},
+    {"S", "Single Step", "S [steps]", CmdId::SINGLE_STEP, CmdParam::OPT_NUM1},
     {"C", "Continue", "C", CmdId::CONTINUE, CmdParam::NO_PARAM},
     {"BP", "Set Break Points", "BP [offset1|label1] [offset2|label2] ... [pointN|labelN]", CmdId::BREAK_POINT,
      CmdParam::NUM1},
@@ -161,20 +177,43 @@ void Debugger::Start() {
                 DisplayRegs();
                 break;
             case CmdId::SINGLE_STEP:
-                SingleStep();
+                SingleStep(params);
                 break;
             case CmdId::RUN:
                 cii_cpu.Reset();
+                if (history) history->Start();
                 Run();
                 break;
             case CmdId::RESET:
                 cii_cpu.Reset();
+                if (history) history->Start();
                 SaveRegs();
                 DisplayRegs();
                 break;
             case CmdId::CONTINUE:
                 Run();
                 break;
+            case CmdId::PROFILE:
+                Profile(params);
+                break;
+            case CmdId::TRACE:
+                Trace(params);
+                break;
+            case CmdId::REVERSE_STEP:
+                ReverseStep(params);
+                break;
+            case CmdId::REVERSE_CONTINUE:
+                ReverseContinue();
+                break;
+            case CmdId::WATCH_POINT:
+                SetWatchPoint(params);
+                break;
+            case CmdId::CLEAR_WATCH_POINTS:
+                ClearWatchPoints(params);
+                break;
+            case CmdId::LIST_WATCH_POINTS:
+                DisplayWatchPoints();
+                break;
             case CmdId::QUIT:
                 quit = true;
                 break;
@@ -200,9 +239,232 @@ void Debugger::Start() {
     }
 }
 
-void Debugger::SingleStep() {
-    SetSingleStep();
-    Run();
+void Debugger::StartProfile() {
+    if (profiler)
+        profiler->Clear();
+    else
+        profiler = std::make_unique<Profiler>(cii_cpu.GetMemory().size);
+    cii_cpu.SetProfiler(profiler.get());
+}
+
+void Debugger::StartHistory(size_t budget) {
+    history = std::make_unique<History>(cii_cpu, budget);
+    cii_cpu.SetHistory(history.get());
+}
+
+void Debugger::Profile(const std::vector<std::string>& params) {
+    if (params.size() > 0 && params[0] == "ON") {
+        StartProfile();
+        cmn::C << "プロファイルを開始しました。\n";
+        return;
+    }
+    if (params.size() > 0 && params[0] == "OFF") {
+        cii_cpu.SetProfiler(nullptr);
+        cmn::C << "プロファイルを終了しました。\n";
+        return;
+    }
+    if (!profiler) {
+        cmn::C << "プロファイルを開始していません。PROF ONで開始してください。\n";
+        return;
+    }
+    size_t top = Profiler::DEFAULT_TOP;
+    if (params.size() > 0) {
+        if (!ass::Reader::IsDigit(params[0]) || params[0].size() > 9 || std::stoul(params[0]) == 0) {
+            cmn::C << cmn::Format("'%s'は行数ではありません。\n", params[0].c_str());
+            return;
+        }
+        top = std::stoul(params[0]);
+    }
+    std::ostringstream os;
+    profiler->Report(os, dbg_infos, mem.GetSyms(), top);
+    cmn::C << C_LIST << os.str() << C_RESET << std::flush;
+}
+
+void Debugger::Trace(const std::vector<std::string>& params) {
+    if (params.size() > 0 && params[0] == "ON") {
+        if (tracer)
+            tracer->Clear();
+        else
+            tracer = std::make_unique<Tracer>();
+        cii_cpu.SetTracer(tracer.get());
+        cmn::C << "トレースを開始しました。\n";
+        return;
+    }
+    if (params.size() > 0 && params[0] == "OFF") {
+        cii_cpu.SetTracer(nullptr);
+        cmn::C << "トレースを終了しました。\n";
+        return;
+    }
+    if (!tracer) {
+        cmn::C << "トレースを開始していません。T ONで開始してください。\n";
+        return;
+    }
+    size_t steps = DEFAULT_TRACE_STEPS;
+    if (params.size() > 0) {
+        if (!ass::Reader::IsDigit(params[0]) || params[0].size() > 9 || std::stoul(params[0]) == 0) {
+            cmn::C << cmn::Format("'%s'は命令数ではありません。\n", params[0].c_str());
+            return;
+        }
+        steps = std::stoul(params[0]);
+    }
+    std::ostringstream os;
+    for (auto& step : tracer->GetLast(steps)) {
+        os << C_ADDR;
+        Tracer::Print(os, step);
+        os << C_RESET;
+        if (uint32_t i = dbg_infos.FindLine(step.adr); i != ass::LineTable::NO_LINE) {
+            os << "  " << C_OP << dbg_infos.Text(i) << C_RESET;
+        }
+        os << "\n";
+    }
+    cmn::C << os.str() << std::flush;
+}
+
+void Debugger::SingleStep(const std::vector<std::string>& params) {
+    if (params.size() == 0) {
+        SetSingleStep();
+        Run();
+        return;
+    }
+    uint32_t steps = 0;
+    if (ass::Reader::IsDigit(params[0]) && params[0].size() <= 9) steps = std::stoul(params[0]);
+    if (steps == 0) {
+        cmn::C << cmn::Format("'%s'はステップ数ではありません。\n", params[0].c_str());
+        return;
+    }
+    Run(steps);
+}
+
+void Debugger::ReverseStep(const std::vector<std::string>& params) {
+    if (!history) {
+        cmn::C << "実行履歴を記録していません。--historyを指定して開始してください。\n";
+        return;
+    }
+    uint32_t steps = 1;
+    if (params.size() > 0) {
+        steps = 0;
+        if (ass::Reader::IsDigit(params[0]) && params[0].size() <= 9) steps = std::stoul(params[0]);
+        if (steps == 0) {
+            cmn::C << cmn::Format("'%s'はステップ数ではありません。\n", params[0].c_str());
+            return;
+        }
+    }
+    SaveRegs();
+    // 記録の先頭より前には戻らない
+    uint32_t counter = cii_cpu.GetExcutedCounter();
+    uint32_t oldest = history->GetOldest();
+    bool clipped = counter - oldest < steps;
+    history->GoTo(clipped ? oldest : counter - steps);
+    if (clipped) cmn::C << C_ERROR << "* HISTORY START" << C_RESET << std::endl;
+    DisplayPosition();
+}
+
+void Debugger::ReverseContinue() {
+    if (!history) {
+        cmn::C << "実行履歴を記録していません。--historyを指定して開始してください。\n";
+        return;
+    }
+    SaveRegs();
+    cii::CauseOfStop status = history->ReverseContinue();
+    if (status == cii::CauseOfStop::BREAK_POINT) {
+        cmn::C << C_ERROR << "* BREAK POINT" << C_RESET << std::endl;
+    } else if (status == cii::CauseOfStop::WATCH_POINT) {
+        cmn::C << C_ERROR << "* WATCH POINT" << C_RESET << std::endl;
+        DisplayWatchHit();
+    } else {
+        cmn::C << C_ERROR << "* HISTORY START" << C_RESET << std::endl;
+    }
+    DisplayPosition();
+}
+
+void Debugger::SetWatchPoint(const std::vector<std::string>& params) {
+    if (params.size() == 0) {
+        cmn::C << "W: offsetを指定してください。\n";
+        return;
+    }
+    uint16_t start;
+    uint16_t end;
+    WatchType type = WatchType::WRITE;
+    uint16_t value = 0;
+    if (!CheckAddr(params[0], start)) {
+        cmn::C << cmn::Format("'%s'はoffset形式ではありません。\n16進数で指定するときは'#12ab'です。\n",
+                              params[0].c_str());
+        return;
+    }
+    end = start;
+    for (size_t i = 1; i < params.size(); i++) {
+        const std::string& param = params[i];
+        // 種類の指定はラベルより優先する
+        if (param == "W") {
+            type = WatchType::WRITE;
+        } else if (param == "R") {
+            type = WatchType::READ;
+        } else if (param == "RW") {
+            type = WatchType::ACCESS;
+        } else if (param[0] == '=') {
+            if (!CheckAddr(param.substr(1), value)) {
+                cmn::C << cmn::Format("'%s'は値ではありません。\n", param.c_str());
+                return;
+            }
+            type = WatchType::VALUE;
+        } else if (i == 1 && CheckAddr(param, end)) {
+            continue;
+        } else {
+            cmn::C << cmn::Format("'%s'はoffsetまたはウォッチの種類ではありません。\n", param.c_str());
+            return;
+        }
+    }
+    if (start > end || end >= cii_cpu.GetMemory().size) {
+        cmn::C << cmn::Format("Offset'%s'は範囲外です。\n", params[0].c_str());
+        return;
+    }
+    cii_cpu.SetWatchPoint(start, end, type, value);
+    DisplayWatchPoints();
+}
+
+void Debugger::ClearWatchPoints(const std::vector<std::string>& params) {
+    for (auto& param : params) {
+        if (param == "*") {
+            while (!cii_cpu.GetWatchPoints().empty()) cii_cpu.DeleteWatchPoint(cii_cpu.GetWatchPoints()[0].start);
+            break;
+        }
+        uint16_t point;
+        if (CheckAddr(param, point)) cii_cpu.DeleteWatchPoint(point);
+    }
+}
+
+std::string Debugger::AdrName(uint16_t adr) const {
+    // 同じアドレスのシンボルは最初のものにする。リテラル(=定数)は使用しない
+    for (auto& sym : mem.GetSyms()) {
+        if (sym.second == adr && !sym.first.empty() && sym.first[0] != '=') {
+            return cmn::Format("#%04x(%s)", adr, sym.first.c_str());
+        }
+    }
+    return cmn::Format("#%04x", adr);
+}
+
+void Debugger::DisplayWatchPoints() const {
+    static const char* const type_names[] = {"W", "R", "RW", "="};
+    std::ostringstream os;
+    for (auto& wp : cii_cpu.GetWatchPoints()) {
+        os << C_ADDR << AdrName(wp.start);
+        if (wp.end != wp.start) os << " - " << AdrName(wp.end);
+        os << "  " << type_names[static_cast<int>(wp.type)];
+        if (wp.type == WatchType::VALUE) os << cmn::Format("%04x(%d)", wp.value, (int16_t)wp.value);
+        os << C_RESET << "\n";
+    }
+    if (cii_cpu.GetWatchPoints().empty()) os << "ウォッチポイントはありません。\n";
+    cmn::C << os.str() << std::flush;
+}
+
+void Debugger::DisplayWatchHit() const {
+    const WatchHit& hit = cii_cpu.GetWatchHit();
+    cmn::C << C_ADDR << (hit.write ? "  W " : "  R ") << AdrName(hit.adr);
+    if (hit.write)
+        cmn::C << cmn::Format(" = %04x -> %04x", hit.old_data, hit.data);
+    else
+        cmn::C << cmn::Format(" = %04x", hit.data);
+    cmn::C << C_RESET << std::endl;
 }
 
 void Debugger::SaveRegs() {
@@ -222,9 +484,9 @@ void Debugger::SaveRegs() {
     save_regs.executed_counter = cii_cpu.GetExcutedCounter();
 }
 
-void Debugger::Run() {
+void Debugger::Run(uint32_t max_steps) {
     SaveRegs();
-    cii::CauseOfStop status = cii_cpu.Run();
+    cii::CauseOfStop status = max_steps == 0 ? cii_cpu.Run() : cii_cpu.RunFor(max_steps).cause;
     if (status != cii::CauseOfStop::OK) {
         if (status == cii::CauseOfStop::STACK_UNDERFLOW) {
             cmn::C << C_ERROR << "* STACK UNDERFLOW" << C_RESET << std::endl;
@@ -240,22 +502,24 @@ void Debugger::Run() {
             cmn::C << C_ERROR << "* SINGLE STEP" << C_RESET << std::endl;
         } else if (status == cii::CauseOfStop::BREAK_POINT) {
             cmn::C << C_ERROR << "* BREAK POINT" << C_RESET << std::endl;
+        } else if (status == cii::CauseOfStop::STEP_LIMIT) {
+            cmn::C << C_ERROR << "* STEP LIMIT" << C_RESET << std::endl;
+        } else if (status == cii::CauseOfStop::WATCH_POINT) {
+            cmn::C << C_ERROR << "* WATCH POINT" << C_RESET << std::endl;
+            DisplayWatchHit();
         } else {
             cmn::C << C_ERROR << "* OTHER ERROR" << C_RESET << std::endl;
         }
     }
+    DisplayPosition();
+}
+
+void Debugger::DisplayPosition() {
     DisplayRegs();
     cmn::C << std::endl;
 
-    if (auto itr = std::find_if(dbg_infos.rbegin(), dbg_infos.rend(),
-                                [&](ass::DbgInfo dbg_info) {
-                                    return (dbg_info.start_offset <= cii_cpu.PR && dbg_info.end_offset > cii_cpu.PR) &&
-                                           (dbg_info.end_offset - dbg_info.start_offset) > 0;
-                                    // return dbg_info.start_offset == cii_cpu.PR &&
-                                    //        (dbg_info.end_offset - dbg_info.start_offset) > 0;
-                                });
-        itr != dbg_infos.rend()) {
-        DisplaySrc(itr->start_offset, itr->end_offset + 1, true);
+    if (uint32_t i = dbg_infos.FindLine(cii_cpu.PR); i != ass::LineTable::NO_LINE) {
+        DisplaySrc(dbg_infos.StartOffset(i), dbg_infos.EndOffset(i) + 1, true);
     }
 }
 
@@ -298,51 +562,86 @@ void Debugger::DisplayReg(CmdId cmd_id) const {
     cmn::C << C_REG << cmn::Format("GR%d = %04x(%d)\n", reg_no, cii_cpu.GetReg(reg_no), cii_cpu.GetReg(reg_no));
 }
 
-int Debugger::DisplayLine(const ass::DbgInfo dbg_info) const {
-    const ass::Tokens& tokens = dbg_info.tokens;
-    if (auto itr = std::find_if(tokens.begin(), tokens.end(),
-                                [](ass::TokenInfo token_info) { return token_info.token_id == ass::TokenId::DC; });
-        itr != tokens.end()) {
-        // TODO:DC
-    }
-
-    //! 一行をトークンに分割するための正規表現
-    const std::regex regsp = std::regex(R"(([,\s]*)([^,\s]+))");
+namespace {
+//! 行を分ける区切り(カンマと空白)か
+bool IsSeparator(char c) {
+    return c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
 
-    int index = 0;
+/**
+ * @brief ソースの行を区切りと語に分け、トークンに合わせて色付けする
+ *
+ * @param os 出力先
+ * @param line ソースの行
+ * @param tokens 行を解析したトークン
+ * @return int 命令の表示開始位置
+ */
+int ColorLine(std::ostream& os, std::string_view line, const ass::Tokens& tokens) {
+    size_t index = 0;
     int start = 0;
     bool is_label = tokens.size() > 0 && tokens[0].token_id == ass::TokenId::LABEL;
 
-    for (std::sregex_iterator it(dbg_info.line.cbegin(), dbg_info.line.cend(), regsp), end; it != end; ++it) {
-        auto&& m = *it;
+    size_t pos = 0;
+    while (true) {
+        size_t word_top = pos;
+        while (word_top < line.size() && IsSeparator(line[word_top])) word_top++;
+        size_t word_end = word_top;
+        while (word_end < line.size() && !IsSeparator(line[word_end])) word_end++;
+        // 末尾の区切りは表示しない
+        if (word_top == word_end) break;
+
+        std::string_view sep = line.substr(pos, word_top - pos);
+        std::string_view word = line.substr(word_top, word_end - word_top);
+        pos = word_end;
 
-        cmn::C << C_OP << m[1].str();
+        os << C_OP << sep;
 
-        if (index == 0) start = (int)m[1].str().size();
+        if (index == 0) start = (int)sep.size();
 
         if (index >= 1 && is_label) {
-            start += (int)m[1].str().size();
+            start += (int)sep.size();
             is_label = false;
         }
 
         if (index < tokens.size() && tokens[index].token_id == ass::TokenId::COMMA) index++;
         if (index < tokens.size()) {
             if (tokens[index].token_id == ass::TokenId::LABEL) {
-                cmn::C << C_LABEL;
+                os << C_LABEL;
             } else if (ass::GetTokenClass(tokens[index].token_id) == ass::REG_CLASS) {
-                cmn::C << C_REGSTER;
+                os << C_REGSTER;
             } else if (ass::GetTokenClass(tokens[index].token_id) == ass::ASEM_CLASS) {
-                cmn::C << C_ASMOP;
+                os << C_ASMOP;
             }
         }
-        cmn::C << m[2].str();
-        if (is_label) start += (int)m[2].str().size();
+        os << word;
+        if (is_label) start += (int)word.size();
         index++;
     }
-    cmn::C << C_RESET << std::endl;
-
     return start;
 }
+}  // namespace
+
+const Debugger::ListLine& Debugger::GetListLine(uint32_t i) const {
+    if (auto itr = list_lines.find(i); itr != list_lines.end()) return itr->second;
+
+    std::string_view line = dbg_infos.Text(i);
+    const ass::Tokens& tokens = reader.Parse(line);
+
+    ListLine list_line;
+    // label以外のTokenIdを取得
+    list_line.token_id = ass::TokenId::OTHER;
+    if (tokens.size() > 0) list_line.token_id = tokens[0].token_id;
+    if (list_line.token_id == ass::TokenId::LABEL && tokens.size() > 1) list_line.token_id = tokens[1].token_id;
+
+    std::ostringstream os;
+    list_line.start = ColorLine(os, line, tokens);
+    list_line.text = os.str();
+    return list_lines.emplace(i, std::move(list_line)).first->second;
+}
+
+void Debugger::DisplayLine(std::ostream& os, const ListLine& list_line) const {
+    os << list_line.text << C_RESET << std::endl;
+}
 
 void Debugger::DisplaySrc(std::vector<std::string>& params) const {
     if (params.size() == 0)
@@ -360,145 +659,151 @@ void Debugger::DisplaySrc(std::vector<std::string>& params) const {
     }
 }
 void Debugger::DisplaySrc(uint16_t start, uint16_t end, bool opt) const {
-    for (const auto& dbg_info : dbg_infos) {
-        // cmn::C << "dbg_info.start_offset:" << dbg_info.start_offset << std::endl;
-        // cmn::C << "dbg_info.end_offset:" << dbg_info.end_offset << std::endl;
-
-        uint16_t off = dbg_info.end_offset - dbg_info.start_offset;
+    // 行ごとに書き込まず、リスト全体を1つのバッファにまとめて1回で出力する
+    std::ostringstream os;
+    auto [first, last] = dbg_infos.FindLines(start, end);
+    for (uint32_t i = first; i < last; i++) {
+        uint16_t start_offset = dbg_infos.StartOffset(i);
+        uint16_t end_offset = dbg_infos.EndOffset(i);
+
+        uint16_t off = end_offset - start_offset;
         bool next = true;
         if (opt) {
             if (off == 0) next = false;
         }
 
-        if (dbg_info.start_offset >= start && dbg_info.end_offset < end && next) {
+        if (next) {
             const Memory& mem = cii_cpu.GetMemory();
-            int offset_len = dbg_info.end_offset - dbg_info.start_offset;
+            int offset_len = end_offset - start_offset;
 
-            // label以外のTokenIdを取得
-            ass::TokenId token_id = ass::TokenId::OTHER;
-            if (dbg_info.tokens.size() > 0) token_id = dbg_info.tokens[0].token_id;
-            if (token_id == ass::TokenId::LABEL && dbg_info.tokens.size() > 1) token_id = dbg_info.tokens[1].token_id;
+            // 表示する行だけトークンに分けて色付けする
+            const ListLine& list_line = GetListLine(i);
+            ass::TokenId token_id = list_line.token_id;
 
             // アドレス表示
             if (!(token_id == ass::TokenId::IN || token_id == ass::TokenId::OUT) && offset_len > 0 &&
-                dbg_info.start_offset == cii_cpu.PR)
-                cmn::C << C_EXEC_ADR;
-            cmn::C << C_ADDR << cmn::Format("%04x", dbg_info.start_offset);
-            cmn::C << cmn::Color::RESET;
+                start_offset == cii_cpu.PR)
+                os << C_EXEC_ADR;
+            os << C_ADDR << cmn::Format("%04x", start_offset);
+            os << cmn::Color::RESET;
 
             // ブレークポイント表示
-            if (dbg_info.is_break)
-                cmn::C << C_BREAK;
+            if (dbg_infos.IsBreak(i))
+                os << C_BREAK;
             else
-                cmn::C << "  ";
-            cmn::C << C_ADDR;
+                os << "  ";
+            os << C_ADDR;
 
             // マクロ表示
             if (token_id == ass::TokenId::IN || token_id == ass::TokenId::OUT) {
-                cmn::C << "++++" << std::string(6, ' ');
-                int start_offset = DisplayLine(dbg_info);
-                DisplayMacro(start_offset, token_id, dbg_info);
+                os << "++++" << std::string(6, ' ');
+                DisplayLine(os, list_line);
+                DisplayMacro(os, list_line.start, token_id, i);
                 continue;
             }
 
             if (offset_len >= 1) {
-                cmn::C << cmn::Format("%04x ", mem.memory[dbg_info.start_offset].data);
+                os << cmn::Format("%04x ", mem.memory[start_offset].data);
             }
             if (offset_len >= 2) {
-                cmn::C << cmn::Format("%04x ", mem.memory[dbg_info.start_offset + 1].data);
+                os << cmn::Format("%04x ", mem.memory[start_offset + 1].data);
             }
-            if (offset_len == 0) cmn::C << std::string(10, ' ');
-            if (offset_len == 1) cmn::C << std::string(5, ' ');
+            if (offset_len == 0) os << std::string(10, ' ');
+            if (offset_len == 1) os << std::string(5, ' ');
 
-            DisplayLine(dbg_info);
+            DisplayLine(os, list_line);
 
             offset_len -= 2;
-            int offset = dbg_info.start_offset + 2;
+            int offset = start_offset + 2;
 
             // DSのときは、長さが長いと表示が長くなってしまうため、ちじめる
-            // auto itr = std::find_if(dbg_info.tokens.begin(), dbg_info.tokens.end(), [](const ass::TokenInfo& info) {
+            // auto itr = std::find_if(tokens.begin(), tokens.end(), [](const ass::TokenInfo& info) {
             //     return info.token_id == ass::TokenId::DS || info.token_id == ass::TokenId::DC;
             // });
             bool is_ds = token_id == ass::TokenId::DS || token_id == ass::TokenId::DC;
             while (offset_len > 0) {
-                cmn::C << C_ADDR << cmn::Format("%04x  ", offset);
+                os << C_ADDR << cmn::Format("%04x  ", offset);
 
                 if (is_ds) {
                     for (int i = 0; i < 8 && offset_len > 0; i++) {
                         if (offset_len >= 1) {
-                            cmn::C << cmn::Format("%04x ", mem.memory[offset].data);
+                            os << cmn::Format("%04x ", mem.memory[offset].data);
                             offset_len--;
                             offset++;
                         }
                     }
                 } else {
                     if (offset_len >= 1) {
-                        cmn::C << cmn::Format("%04x ", mem.memory[offset].data);
+                        os << cmn::Format("%04x ", mem.memory[offset].data);
                         offset_len--;
                         offset++;
                     }
                     if (offset_len >= 1) {
-                        cmn::C << cmn::Format("%04x ", mem.memory[offset].data);
+                        os << cmn::Format("%04x ", mem.memory[offset].data);
                         offset_len--;
                         offset++;
                     }
                 }
-                cmn::C << std::endl;
+                os << std::endl;
             }
         }
     }
-    cmn::C << cmn::Color::RESET;
+    os << cmn::Color::RESET;
+    cmn::C << os.str() << std::flush;
 }
 
-void Debugger::DisplayContents(int start, uint16_t offset, std::string line, int no, uint16_t data1,
-                               uint16_t data2) const {
-    cmn::C << C_ADDR;
-    if (offset == cii_cpu.PR) cmn::C << C_EXEC_ADR;
+void Debugger::DisplayContents(std::ostream& os, int start, uint16_t offset, std::string line, int no,
+                               uint16_t data1, uint16_t data2) const {
+    os << C_ADDR;
+    if (offset == cii_cpu.PR) os << C_EXEC_ADR;
 
-    cmn::C << cmn::Format("%04x", offset) << C_RESET;
-    cmn::C << "  " << C_ADDR;
-    cmn::C << cmn::Format("%04x ", data1);
+    os << cmn::Format("%04x", offset) << C_RESET;
+    os << "  " << C_ADDR;
+    os << cmn::Format("%04x ", data1);
     if (no == 2)
-        cmn::C << cmn::Format("%04x ", data2);
+        os << cmn::Format("%04x ", data2);
     else
-        cmn::C << "     ";
+        os << "     ";
 
-    cmn::C << std::string(start, ' ');
-    cmn::C << C_MACRO << line << C_RESET;
+    os << std::string(start, ' ');
+    os << C_MACRO << line << C_RESET;
 }
 
-void Debugger::DisplayMacro(int start, ass::TokenId token_id, const ass::DbgInfo& dbg_info) const {
+void Debugger::DisplayMacro(std::ostream& os, int start, ass::TokenId token_id, uint32_t i) const {
+    // オペランドのラベルはキャッシュしていないため、行を解析し直す
+    const ass::Tokens& tokens = reader.Parse(dbg_infos.Text(i));
+    uint16_t start_offset = dbg_infos.StartOffset(i);
     int label_off = 1;
-    if (dbg_info.tokens[0].token_id == ass::TokenId::LABEL) label_off = 2;
+    if (tokens[0].token_id == ass::TokenId::LABEL) label_off = 2;
 
-    std::string buf_name = dbg_info.tokens[label_off].label;
-    std::string len_name = dbg_info.tokens[label_off + 2].label;
+    std::string buf_name = tokens[label_off].label;
+    std::string len_name = tokens[label_off + 2].label;
 
     std::string svc_no = token_id == ass::TokenId::IN ? "1" : "2";
 
     int index = 0;
 
-    DisplayContents(start, dbg_info.start_offset + index, "PUSH\tGR1,0\n", 2,
-                    mem.memory[dbg_info.start_offset + index].data, mem.memory[dbg_info.start_offset + index + 1].data);
+    DisplayContents(os, start, start_offset + index, "PUSH\tGR1,0\n", 2,
+                    mem.memory[start_offset + index].data, mem.memory[start_offset + index + 1].data);
     index += 2;
 
-    DisplayContents(start, dbg_info.start_offset + index, "PUSH\tGR2,0\n", 2,
-                    mem.memory[dbg_info.start_offset + index].data, mem.memory[dbg_info.start_offset + index + 1].data);
+    DisplayContents(os, start, start_offset + index, "PUSH\tGR2,0\n", 2,
+                    mem.memory[start_offset + index].data, mem.memory[start_offset + index + 1].data);
     index += 2;
-    DisplayContents(start, dbg_info.start_offset + index, "LAD\tGR1," + buf_name + "\n", 2,
-                    mem.memory[dbg_info.start_offset + index].data, mem.memory[dbg_info.start_offset + index + 1].data);
+    DisplayContents(os, start, start_offset + index, "LAD\tGR1," + buf_name + "\n", 2,
+                    mem.memory[start_offset + index].data, mem.memory[start_offset + index + 1].data);
     index += 2;
-    DisplayContents(start, dbg_info.start_offset + index, "LAD\tGR2," + len_name + "\n", 2,
-                    mem.memory[dbg_info.start_offset + index].data, mem.memory[dbg_info.start_offset + index + 1].data);
+    DisplayContents(os, start, start_offset + index, "LAD\tGR2," + len_name + "\n", 2,
+                    mem.memory[start_offset + index].data, mem.memory[start_offset + index + 1].data);
     index += 2;
-    DisplayContents(start, dbg_info.start_offset + index, "SVC\t" + svc_no + "\n", 2,
-                    mem.memory[dbg_info.start_offset + index].data, mem.memory[dbg_info.start_offset + index + 1].data);
+    DisplayContents(os, start, start_offset + index, "SVC\t" + svc_no + "\n", 2,
+                    mem.memory[start_offset + index].data, mem.memory[start_offset + index + 1].data);
     index += 2;
-    DisplayContents(start, dbg_info.start_offset + index, "POP\tGR2\n", 1,
-                    mem.memory[dbg_info.start_offset + index].data, 0);
+    DisplayContents(os, start, start_offset + index, "POP\tGR2\n", 1,
+                    mem.memory[start_offset + index].data, 0);
     index += 1;
-    DisplayContents(start, dbg_info.start_offset + index, "POP\tGR1\n", 1,
-                    mem.memory[dbg_info.start_offset + index].data, 0);
+    DisplayContents(os, start, start_offset + index, "POP\tGR1\n", 1,
+                    mem.memory[start_offset + index].data, 0);
 }
 void Debugger::SetSingleStep() { cii_cpu.FR.SetSingleStep(ON); }
 
@@ -533,17 +838,12 @@ bool Debugger::SetBreakPoint(const std::vector<std::string>& params) {
 }
 
 bool Debugger::SetBreakPoint(uint16_t point) {
-    if (auto itr = std::find_if(dbg_infos.begin(), dbg_infos.end(),
-                                [&point](auto dbg_info) {
-                                    return dbg_info.end_offset > dbg_info.start_offset &&
-                                           point >= dbg_info.start_offset && point < dbg_info.end_offset;
-                                });
-        itr != dbg_infos.end()) {
-        itr->is_break = true;
-        cii_cpu.SetBreakPoint(itr->start_offset);
-        return true;
-    }
-    return false;
+    uint32_t i = dbg_infos.FindLine(point);
+    if (i == ass::LineTable::NO_LINE) return false;
+
+    dbg_infos.SetBreak(i, true);
+    cii_cpu.SetBreakPoint(dbg_infos.StartOffset(i));
+    return true;
 }
 
 void Debugger::ClearBreakPoints(std::vector<std::string>& params) {
@@ -558,19 +858,18 @@ void Debugger::ClearBreakPoints(std::vector<std::string>& params) {
 }
 
 void Debugger::ClearBreakPoint(uint16_t point) {
-    if (auto itr =
-            std::find_if(dbg_infos.begin(), dbg_infos.end(), [&point](auto dbg_info) { return dbg_info.is_break; });
-        itr != dbg_infos.end()) {
-        itr->is_break = false;
-        cii_cpu.DeleteBreakPoint(itr->start_offset);
+    if (uint32_t i = dbg_infos.FindLine(point); i != ass::LineTable::NO_LINE && dbg_infos.IsBreak(i)) {
+        dbg_infos.SetBreak(i, false);
+        cii_cpu.DeleteBreakPoint(dbg_infos.StartOffset(i));
     }
 }
 void Debugger::ClearAllBreakPoints() {
-    for (auto& dbg_info : dbg_infos) {
-        if (dbg_info.is_break) {
-            cii_cpu.DeleteBreakPoint(dbg_info.start_offset);
-            dbg_info.is_break = false;
-        }
+    // 設定したブレークポイントの行だけを戻す
+    std::vector<uint16_t> points;
+    for (auto& bp : cii_cpu.GetBreakPoints()) points.push_back(bp.adr);
+    for (uint16_t point : points) {
+        if (uint32_t i = dbg_infos.FindLine(point); i != ass::LineTable::NO_LINE) dbg_infos.SetBreak(i, false);
+        cii_cpu.DeleteBreakPoint(point);
     }
 }
 
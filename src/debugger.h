@@ -1,7 +1,14 @@
 #ifndef DEBUGGER_H_
 #define DEBUGGER_H_
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+
 #include "assembler.h"
 #include "common.h"
+#include "history.h"
+#include "profiler.h"
+#include "tracer.h"
 
 namespace cii {
 /**
@@ -26,6 +33,13 @@ enum class CmdId {
     CONTINUE,            //!< 実行
     RUN,                 //!< 実行
     RESET,               //!< レジスタの初期化
+    PROFILE,             //!< プロファイル
+    TRACE,               //!< 命令トレース
+    REVERSE_STEP,        //!< 逆ステップ
+    REVERSE_CONTINUE,    //!< 逆実行
+    WATCH_POINT,         //!< ウォッチポイントの設定
+    CLEAR_WATCH_POINTS,  //!< ウォッチポイントのクリア
+    LIST_WATCH_POINTS,   //!< ウォッチポイントの一覧
     HELP,                //!< コマンドのヘルプ
     QUIT,                //!< デバッガの終了
 };
@@ -87,18 +101,64 @@ inline std::ostream& operator<<(std::ostream& os, ColorChar cb) {
  *
  */
 class Debugger {
-    CometII& cii_cpu;          //!< コメットCPU
-    ass::DbgInfos& dbg_infos;  //!< デバッグソース情報
+    CometII& cii_cpu;            //!< コメットCPU
+    ass::LineTable& dbg_infos;   //!< デバッグソース情報
     const cii::AssmMem& mem;
+    mutable ass::Reader reader;  //!< 表示する行のトークンの解析
+
+    /**
+     * @brief 色付けしたソースリストの行
+     */
+    struct ListLine {
+        std::string text;       //!< 色のエスケープシーケンスを埋め込んだ行(改行なし)
+        int start;              //!< 命令の表示開始位置(マクロの展開表示で使う)
+        ass::TokenId token_id;  //!< ラベル以外の最初のトークン
+    };
+    mutable std::unordered_map<uint32_t, ListLine> list_lines;  //!< 表示した行の色付けのキャッシュ
+    std::unique_ptr<Profiler> profiler;                         //!< 実行プロファイラ(開始するまではnullptr)
+    std::unique_ptr<Tracer> tracer;                             //!< 命令トレース(開始するまではnullptr)
+    std::unique_ptr<History> history;                           //!< 実行履歴(記録しないときはnullptr)
 
    public:
-    Debugger(CometII& cii_cpu, ass::DbgInfos& dbg_infos, cii::AssmMem& mem)
-        : cii_cpu(cii_cpu), dbg_infos(dbg_infos), mem(mem) {}
+    //! Tコマンドで表示する命令数の既定値
+    static constexpr size_t DEFAULT_TRACE_STEPS = 20;
+
+    /**
+     * @brief Construct a new Debugger object
+     *
+     * @param cii_cpu コメットCPU
+     * @param dbg_infos デバッグソース情報(BuildIndexで索引を作成しておく)
+     * @param mem メモリ
+     */
+    Debugger(CometII& cii_cpu, ass::LineTable& dbg_infos, cii::AssmMem& mem)
+        : cii_cpu(cii_cpu), dbg_infos(dbg_infos), mem(mem) {
+        // 対話用のためSVC OUTは1行ごとに出力する
+        cii_cpu.SetSvcOutBuffer(0);
+    }
+    ~Debugger() {
+        cii_cpu.SetProfiler(nullptr);
+        cii_cpu.SetTracer(nullptr);
+        cii_cpu.SetHistory(nullptr);
+    }
 
     /**
      * @brief デバッガ開始
      */
     void Start();
+    /**
+     * @brief プロファイルを開始する。開始済みのときは記録を消して開始し直す
+     */
+    void StartProfile();
+    /**
+     * @brief 実行プロファイラを取得する
+     * @return const Profiler* プロファイラ、開始していないときはnullptr
+     */
+    const Profiler* GetProfiler() const { return profiler.get(); }
+    /**
+     * @brief 逆実行のための実行履歴の記録を開始する
+     * @param budget 使用量の上限(バイト)
+     */
+    void StartHistory(size_t budget);
 
    private:
     /**
@@ -117,8 +177,47 @@ class Debugger {
     static void DisplayHelp();
     /**
      * @brief 実行
+     * @param max_steps 実行する最大命令数(0のときは停止するまで実行する)
+     */
+    void Run(uint32_t max_steps = 0);
+    /**
+     * @brief レジスタと実行位置のソースを表示する
      */
-    void Run();
+    void DisplayPosition();
+    /**
+     * @brief 逆ステップ
+     *
+     * @param params 戻る命令数(指定がないときは1命令)
+     */
+    void ReverseStep(const std::vector<std::string>& params);
+    /**
+     * @brief 前に到達したブレークポイントまたはウォッチポイントまで戻る
+     */
+    void ReverseContinue();
+    /**
+     * @brief ウォッチポイントを設定する
+     *
+     * @param params 開始位置、[終了位置]、[W | R | RW | =値]
+     */
+    void SetWatchPoint(const std::vector<std::string>& params);
+    /**
+     * @brief ウォッチポイントをクリアする
+     *
+     * @param params *:すべて、開始位置:その位置から始まるウォッチポイント
+     */
+    void ClearWatchPoints(const std::vector<std::string>& params);
+    /**
+     * @brief ウォッチポイントの一覧を表示する
+     */
+    void DisplayWatchPoints() const;
+    /**
+     * @brief 最後にウォッチポイントで停止したアクセスを表示する
+     */
+    void DisplayWatchHit() const;
+    /**
+     * @brief アドレスを"#xxxx"の形式で、シンボルがあるときは"#xxxx(シンボル)"の形式で返す
+     */
+    std::string AdrName(uint16_t adr) const;
     /**
      * @brief 複数のブレークポイントが正しいかどうかチェックし、正しい場合ブレークポイントを設定する
      * @param params ブレークポイント文字列
@@ -146,13 +245,35 @@ class Debugger {
      */
     void DisplaySrc(uint16_t start, uint16_t end = -1, bool opt = false) const;
 
-    void DisplayMacro(int start, ass::TokenId token_id, const ass::DbgInfo& dbg_info) const;
-    void DisplayContents(int start, uint16_t offset, std::string line, int no, uint16_t data1, uint16_t data2) const;
+    /**
+     * @brief IN/OUTマクロを展開した命令を表示する
+     *
+     * @param os 出力先
+     * @param start 命令の表示開始位置
+     * @param token_id IN/OUT
+     * @param i マクロの行
+     */
+    void DisplayMacro(std::ostream& os, int start, ass::TokenId token_id, uint32_t i) const;
+    void DisplayContents(std::ostream& os, int start, uint16_t offset, std::string line, int no, uint16_t data1,
+                         uint16_t data2) const;
+    /**
+     * @brief プロファイルを開始、終了、または表示する
+     *
+     * @param params ON:開始、OFF:終了、数値:表示する行数(指定がないときはProfiler::DEFAULT_TOP)
+     */
+    void Profile(const std::vector<std::string>& params);
+    /**
+     * @brief 命令トレースを開始、終了、または最後の命令を表示する
+     *
+     * @param params ON:開始、OFF:終了、数値:表示する命令数(指定がないときはDEFAULT_TRACE_STEPS)
+     */
+    void Trace(const std::vector<std::string>& params);
     /**
      * @brief シングルスッテップ
      *
+     * @param params 実行する命令数(指定がないときは1命令)
      */
-    void SingleStep();
+    void SingleStep(const std::vector<std::string>& params);
     /**
      * @brief Set the Single Step object
      *
@@ -185,12 +306,19 @@ class Debugger {
      * @param pre_flag レジスタフラグ値の前回値
      */
     void DisplayOneReg(const char* reg_name, bool flag, bool pre_flag) const;
+    /**
+     * @brief 色付けしたソースリストの行を取得する。初めて表示する行はトークンに分けて色付けする
+     *
+     * @param i 行
+     */
+    const ListLine& GetListLine(uint32_t i) const;
     /**
      * @brief ソースリストの一行を表示する
      *
-     * @param dbg_info ソースリスト情報
+     * @param os 出力先
+     * @param list_line 色付けした行
      */
-    int DisplayLine(const ass::DbgInfo dbg_info) const;
+    void DisplayLine(std::ostream& os, const ListLine& list_line) const;
     /**
      * @brief 入力されたparamが数値かラベルかチェックし数値に変換する
      *
@@ -0,0 +1,198 @@
+#include "exec_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "conf.h"
+#include "page_array.h"
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cii {
+namespace {
+//! 実行イメージファイルの識別子
+constexpr char MAGIC[4] = {'C', 'I', 'I', 'X'};
+//! 実行イメージファイルの形式のバージョン。形式を変えたら上げる
+constexpr uint32_t VERSION = 1;
+
+static_assert(sizeof(ExecImage::Header) == 48, "ExecImage::Header layout");
+static_assert(sizeof(ExecImage::Sym) == 8, "ExecImage::Sym layout");
+static_assert(sizeof(ExecImage::Line) == 16, "ExecImage::Line layout");
+
+//! 4バイト境界に切り上げる
+uint32_t Align4(uint32_t pos) { return (pos + 3) & ~3u; }
+
+void Pad(std::ostream &os, uint32_t from, uint32_t to) {
+    for (; from < to; from++) os.put(0);
+}
+
+//! 領域がファイルに収まっているか
+bool InRange(size_t size, uint32_t pos, uint64_t count, size_t elem) { return pos + count * elem <= size; }
+}  // namespace
+
+bool ExecImage::Save(std::ostream &os, const AssmMem &mem, uint16_t start, const ass::LineTable &dbg_infos) {
+    std::vector<SymValue> sym_values = mem.GetSyms();
+    std::sort(sym_values.begin(), sym_values.end());
+
+    std::string strs;
+    std::vector<Sym> sym_table;
+    sym_table.reserve(sym_values.size());
+    for (auto &sym : sym_values) {
+        sym_table.push_back({(uint32_t)strs.size(), (uint16_t)sym.first.size(), sym.second});
+        strs += sym.first;
+    }
+    std::vector<Line> line_table;
+    line_table.reserve(dbg_infos.Size());
+    for (uint32_t i = 0; i < dbg_infos.Size(); i++) {
+        std::string_view line = dbg_infos.Text(i);
+        line_table.push_back({(uint32_t)strs.size(), (uint32_t)line.size(), dbg_infos.StartOffset(i),
+                              dbg_infos.EndOffset(i), (uint8_t)dbg_infos.Err(i), {}});
+        strs += line;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.mem_size = mem.size;
+    header.used = std::min(mem.GetOffset(), mem.size);
+    header.start = start;
+    header.syms = (uint32_t)sym_table.size();
+    header.lines = (uint32_t)line_table.size();
+    header.strs_size = (uint32_t)strs.size();
+    header.words_pos = sizeof(Header);
+    header.syms_pos = Align4(header.words_pos + header.used * sizeof(uint16_t));
+    header.lines_pos = header.syms_pos + header.syms * sizeof(Sym);
+    header.strs_pos = header.lines_pos + header.lines * sizeof(Line);
+
+    os.write((const char *)&header, sizeof(header));
+    std::vector<uint16_t> words(header.used);
+    for (uint32_t i = 0; i < header.used; i++) words[i] = mem.memory[i].data;
+    os.write((const char *)words.data(), words.size() * sizeof(uint16_t));
+    Pad(os, header.words_pos + header.used * sizeof(uint16_t), header.syms_pos);
+    os.write((const char *)sym_table.data(), sym_table.size() * sizeof(Sym));
+    os.write((const char *)line_table.data(), line_table.size() * sizeof(Line));
+    os.write(strs.data(), strs.size());
+    return (bool)os;
+}
+
+bool ExecImage::Open(const std::string &file) {
+    Close();
+#ifdef _MSC_VER
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open()) return false;
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    std::string contents = ss.str();
+    buf.assign(contents.begin(), contents.end());
+    data = buf.data();
+    size = buf.size();
+#else
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    void *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    data = (const char *)p;
+    size = st.st_size;
+#endif
+    if (Map()) return true;
+
+    Close();
+    return false;
+}
+
+void ExecImage::Close() {
+#ifndef _MSC_VER
+    if (data != nullptr) ::munmap((void *)data, size);
+#endif
+    buf.clear();
+    data = nullptr;
+    size = 0;
+    header = nullptr;
+    words = nullptr;
+    syms = nullptr;
+    lines = nullptr;
+    strs = nullptr;
+}
+
+bool ExecImage::Map() {
+    if (size < sizeof(Header)) return false;
+    const Header *h = (const Header *)data;
+    if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION) return false;
+    if (h->mem_size > CommetIIEnv::MAX_MEM_SIZE || h->used > h->mem_size) return false;
+    if (h->words_pos % alignof(uint16_t) != 0 || h->syms_pos % alignof(Sym) != 0 ||
+        h->lines_pos % alignof(Line) != 0)
+        return false;
+    if (!InRange(size, h->words_pos, h->used, sizeof(uint16_t)) || !InRange(size, h->syms_pos, h->syms, sizeof(Sym)) ||
+        !InRange(size, h->lines_pos, h->lines, sizeof(Line)) || !InRange(size, h->strs_pos, h->strs_size, 1))
+        return false;
+
+    header = h;
+    words = (const uint16_t *)(data + h->words_pos);
+    syms = (const Sym *)(data + h->syms_pos);
+    lines = (const Line *)(data + h->lines_pos);
+    strs = data + h->strs_pos;
+
+    // 参照する文字列とアドレスが範囲内か
+    for (uint32_t i = 0; i < h->syms; i++) {
+        if ((uint64_t)syms[i].name + syms[i].name_len > h->strs_size) return false;
+    }
+    // 行はアドレスの順に並んでいること
+    uint16_t pre_end = 0;
+    for (uint32_t i = 0; i < h->lines; i++) {
+        const Line &line = lines[i];
+        if ((uint64_t)line.text + line.text_len > h->strs_size) return false;
+        if (line.start_offset < pre_end || line.start_offset > line.end_offset || line.end_offset > h->used)
+            return false;
+        pre_end = line.end_offset;
+    }
+    return true;
+}
+
+bool ExecImage::Load(Memory &mem) const {
+    if (mem.size < header->used) return false;
+
+    for (uint32_t i = 0; i < header->used; i++) mem.memory[i].data = words[i];
+    // 使用領域以降を0にする。前の内容が残っているページだけに書き込む
+    cmn::ClearRange(mem.memory + header->used, (mem.size - header->used) * sizeof(WordData));
+    return true;
+}
+
+void ExecImage::LoadSyms(AssmMem &mem) const {
+    for (uint32_t i = 0; i < header->syms; i++) {
+        mem.DefineLinkedSym(std::string(strs + syms[i].name, syms[i].name_len), syms[i].adr);
+    }
+}
+
+void ExecImage::GetDbgInfos(ass::LineTable &dbg_infos) const {
+    dbg_infos.Clear();
+    dbg_infos.Reserve(header->lines, header->strs_size);
+    for (uint32_t i = 0; i < header->lines; i++) {
+        const Line &line = lines[i];
+        dbg_infos.Add(GetText(line), (ass::AsmErrCode)line.err, line.start_offset, line.end_offset);
+    }
+    dbg_infos.BuildIndex();
+}
+
+uint16_t ExecImage::FindSym(std::string_view sym) const {
+    const Sym *end = syms + header->syms;
+    const Sym *itr = std::lower_bound(syms, end, sym, [this](const Sym &e, std::string_view name) {
+        return std::string_view(strs + e.name, e.name_len) < name;
+    });
+    if (itr == end || std::string_view(strs + itr->name, itr->name_len) != sym) return UINT16_MAX;
+    return itr->adr;
+}
+
+}  // namespace cii
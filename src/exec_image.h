@@ -0,0 +1,131 @@
+#ifndef EXEC_IMAGE_H_
+#define EXEC_IMAGE_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "assem_mem.h"
+#include "assembler.h"
+#include "comet_ii.h"
+
+namespace cii {
+
+/**
+ * @class
+ * 実行イメージファイル
+ * @note
+ * リンク済みのメモリ内容、実行開始アドレス、シンボル表、デバッグ用の行テーブルを固定長の配列で保存する。
+ * 読み込みはファイルをmmapして配列をそのまま参照するため、解析も行ごとのメモリ確保もしない。
+ * 数値はホストのバイト順(リトルエンディアン)で保存する。
+ */
+class ExecImage {
+   public:
+    /**
+     * @brief ファイルヘッダ
+     */
+    struct Header {
+        char magic[4];       //!< 識別子"CIIX"
+        uint32_t version;    //!< 形式のバージョン
+        uint32_t mem_size;   //!< ビルドしたときのメモリワードサイズ
+        uint32_t used;       //!< 使用しているワード数
+        uint16_t start;      //!< 実行開始アドレス
+        uint16_t reserved;   //!< 未使用(0)
+        uint32_t syms;       //!< シンボル数
+        uint32_t lines;      //!< 行数
+        uint32_t strs_size;  //!< 文字列領域のバイト数
+        uint32_t words_pos;  //!< メモリ内容の位置
+        uint32_t syms_pos;   //!< シンボル表の位置
+        uint32_t lines_pos;  //!< 行テーブルの位置
+        uint32_t strs_pos;   //!< 文字列領域の位置
+    };
+    /**
+     * @brief シンボル(名前順)
+     */
+    struct Sym {
+        uint32_t name;      //!< 名前の文字列領域の位置
+        uint16_t name_len;  //!< 名前の長さ
+        uint16_t adr;       //!< アドレス
+    };
+    /**
+     * @brief ソースの行
+     */
+    struct Line {
+        uint32_t text;          //!< ソースの行の文字列領域の位置
+        uint32_t text_len;      //!< ソースの行の長さ
+        uint16_t start_offset;  //!< 開始アドレス
+        uint16_t end_offset;    //!< 終了アドレス
+        uint8_t err;            //!< アセンブルエラー(ass::AsmErrCode)
+        uint8_t reserved[3];    //!< 未使用(0)
+    };
+
+    ExecImage() = default;
+    ExecImage(const ExecImage &) = delete;
+    ExecImage &operator=(const ExecImage &) = delete;
+    ~ExecImage() { Close(); }
+
+    /**
+     * @brief 実行イメージを書き込む
+     * @param os 出力先(バイナリ)
+     * @param mem ビルド後のメモリ
+     * @param start 実行開始アドレス
+     * @param dbg_infos デバッグ情報
+     * @return true 成功
+     */
+    static bool Save(std::ostream &os, const AssmMem &mem, uint16_t start, const ass::LineTable &dbg_infos);
+    /**
+     * @brief 実行イメージファイルを開く
+     * @param file ファイル
+     * @return false 開けない、形式が違う、またはバージョンが違う
+     */
+    bool Open(const std::string &file);
+    void Close();
+
+    /**
+     * @brief メモリ内容をメモリに展開する
+     * @param mem 展開先のメモリ。使用領域以降は0にする
+     * @return false メモリサイズが足りない
+     */
+    bool Load(Memory &mem) const;
+    /**
+     * @brief シンボルをAssmMem::FindSymで引けるように定義する
+     */
+    void LoadSyms(AssmMem &mem) const;
+    /**
+     * @brief デバッガ用のデバッグ情報を作成する
+     * @param dbg_infos 出力先。アドレスの索引も作成する
+     */
+    void GetDbgInfos(ass::LineTable &dbg_infos) const;
+    /**
+     * @brief シンボルのアドレスを二分探索で取得する
+     * @return uint16_t アドレス、ないときはUINT16_MAX
+     */
+    uint16_t FindSym(std::string_view sym) const;
+
+    uint32_t GetMemSize() const { return header->mem_size; }
+    uint32_t GetUsed() const { return header->used; }
+    uint16_t GetStart() const { return header->start; }
+    uint32_t GetLineCount() const { return header->lines; }
+    const Line &GetLine(uint32_t i) const { return lines[i]; }
+    std::string_view GetText(const Line &line) const { return {strs + line.text, line.text_len}; }
+
+   private:
+    const char *data = nullptr;        //!< ファイルの内容
+    size_t size = 0;                   //!< ファイルのバイト数
+    std::vector<char> buf;             //!< mmapできないときのファイルの内容
+    const Header *header = nullptr;    //!< ファイルヘッダ
+    const uint16_t *words = nullptr;   //!< メモリ内容
+    const Sym *syms = nullptr;         //!< シンボル表
+    const Line *lines = nullptr;       //!< 行テーブル
+    const char *strs = nullptr;        //!< 文字列領域
+
+    /**
+     * @brief ヘッダと各領域が範囲内かチェックし、配列の位置を設定する
+     */
+    bool Map();
+};
+
+}  // namespace cii
+#endif
@@ -0,0 +1,204 @@
+#include "history.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+#include "tracer.h"
+
+namespace cii {
+
+History::History(CometII &cpu, size_t budget, uint32_t interval)
+    : cpu(cpu), budget(budget), interval(interval), replaying(false) {
+    Start();
+}
+
+void History::Start() {
+    const Memory &mem = cpu.GetMemory();
+    uint32_t pages = (mem.size + PAGE_WORDS - 1) / PAGE_WORDS;
+    base.state = cpu.GetState();
+    base.input_pos = 0;
+    base.pages.clear();
+    base.words.assign((size_t)pages * PAGE_WORDS, 0);
+    for (uint32_t adr = 0; adr < mem.size; adr++) base.words[adr] = mem.memory[adr].data;
+    checkpoints.clear();
+    dirty.assign(pages, 0);
+    dirty_pages.clear();
+    inputs.clear();
+    input_pos = 0;
+    last_input_len = 0;
+    last_counter = base.state.counter;
+    used = SnapshotSize(base);
+}
+
+void History::MarkInput() {
+    Mark(cpu.GR2);
+    // 範囲外の文字は格納しないため、範囲内のページだけを記録する
+    uint32_t end = std::min<uint32_t>(cpu.GR1 + last_input_len, cpu.GetMemory().size);
+    if (cpu.GR1 >= end) return;
+    for (uint32_t page = cpu.GR1 / PAGE_WORDS; page <= (end - 1) / PAGE_WORDS; page++) Mark(page * PAGE_WORDS);
+}
+
+void History::RecordInput(const char *line, uint32_t len, bool ok) {
+    inputs.push_back({ok ? std::string(line, len) : std::string(), ok});
+    input_pos = inputs.size();
+    last_input_len = ok ? len : 0;
+}
+
+bool History::ReplayInput(const char *&line, uint32_t &len, bool &ok) {
+    if (input_pos >= inputs.size()) return false;
+
+    const Input &input = inputs[input_pos++];
+    line = input.line.data();
+    len = (uint32_t)input.line.size();
+    ok = input.ok;
+    last_input_len = ok ? len : 0;
+    return true;
+}
+
+size_t History::SnapshotSize(const Snapshot &s) {
+    return sizeof(Snapshot) + s.pages.size() * sizeof(uint32_t) + s.words.size() * sizeof(uint16_t);
+}
+
+void History::Checkpoint() {
+    const Memory &mem = cpu.GetMemory();
+    Snapshot s;
+    s.state = cpu.GetState();
+    s.input_pos = input_pos;
+    std::sort(dirty_pages.begin(), dirty_pages.end());
+    s.pages = dirty_pages;
+    s.words.assign(s.pages.size() * PAGE_WORDS, 0);
+    for (size_t i = 0; i < s.pages.size(); i++) {
+        uint32_t top = s.pages[i] * PAGE_WORDS;
+        uint32_t n = std::min(PAGE_WORDS, mem.size - top);
+        for (uint32_t j = 0; j < n; j++) s.words[i * PAGE_WORDS + j] = mem.memory[top + j].data;
+        dirty[s.pages[i]] = 0;
+    }
+    dirty_pages.clear();
+    last_counter = s.state.counter;
+    used += SnapshotSize(s);
+    checkpoints.push_back(std::move(s));
+
+    // 上限を超えたときは一番古いチェックポイントを起点に統合する
+    while (used > budget && !checkpoints.empty()) {
+        const Snapshot &oldest = checkpoints.front();
+        for (size_t i = 0; i < oldest.pages.size(); i++) {
+            std::copy_n(&oldest.words[i * PAGE_WORDS], PAGE_WORDS, &base.words[oldest.pages[i] * PAGE_WORDS]);
+        }
+        base.state = oldest.state;
+        base.input_pos = oldest.input_pos;
+        used -= SnapshotSize(oldest);
+        checkpoints.pop_front();
+    }
+}
+
+const uint16_t *History::FindPage(size_t keep, uint32_t page) const {
+    for (size_t k = keep; k > 0; k--) {
+        const Snapshot &s = checkpoints[k - 1];
+        auto itr = std::lower_bound(s.pages.begin(), s.pages.end(), page);
+        if (itr != s.pages.end() && *itr == page) return &s.words[(itr - s.pages.begin()) * PAGE_WORDS];
+    }
+    return &base.words[page * PAGE_WORDS];
+}
+
+void History::Restore(size_t keep) {
+    Memory &mem = cpu.GetMemory();
+    // 戻すチェックポイントより後に書き換えたページだけを戻す
+    std::vector<uint32_t> pages = dirty_pages;
+    for (size_t k = keep; k < checkpoints.size(); k++) {
+        pages.insert(pages.end(), checkpoints[k].pages.begin(), checkpoints[k].pages.end());
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    for (uint32_t page : pages) {
+        const uint16_t *words = FindPage(keep, page);
+        uint32_t top = page * PAGE_WORDS;
+        uint32_t n = std::min(PAGE_WORDS, mem.size - top);
+        for (uint32_t j = 0; j < n; j++) {
+            if (mem.memory[top + j].data != words[j]) mem.memory[top + j].data = words[j];
+        }
+    }
+
+    while (checkpoints.size() > keep) {
+        used -= SnapshotSize(checkpoints.back());
+        checkpoints.pop_back();
+    }
+    for (uint32_t page : dirty_pages) dirty[page] = 0;
+    dirty_pages.clear();
+
+    const Snapshot &s = keep == 0 ? base : checkpoints[keep - 1];
+    cpu.SetState(s.state);
+    cpu.InvalidateDecodeCache();
+    input_pos = s.input_pos;
+    last_counter = s.state.counter;
+}
+
+void History::Replay(uint32_t end, const BreakCond &cond, const std::function<void()> &on_watch) {
+    // 再実行した命令はプロファイラとトレースに記録しない
+    Profiler *profiler = cpu.GetProfiler();
+    Tracer *tracer = cpu.GetTracer();
+    cpu.SetProfiler(nullptr);
+    cpu.SetTracer(nullptr);
+    replaying = true;
+    while (cpu.GetExcutedCounter() < end) {
+        uint32_t steps = end - cpu.GetExcutedCounter();
+        // 記録したときはHALTなどで停止したあとも続けて実行しているため、目的の命令数まで実行する
+        RunResult result = cond ? cpu.RunUntil(cond, steps) : cpu.RunFor(steps);
+        if (result.cause == CauseOfStop::WATCH_POINT && on_watch) on_watch();
+        if (result.steps == 0) break;
+    }
+    replaying = false;
+    cpu.SetProfiler(profiler);
+    cpu.SetTracer(tracer);
+}
+
+bool History::GoTo(uint32_t counter) {
+    if (counter < GetOldest() || counter > cpu.GetExcutedCounter()) return false;
+
+    size_t keep = checkpoints.size();
+    while (keep > 0 && checkpoints[keep - 1].state.counter > counter) keep--;
+    Restore(keep);
+    Replay(counter);
+    cpu.SkipBreakPoint();
+    return true;
+}
+
+CauseOfStop History::ReverseContinue() {
+    uint32_t end = cpu.GetExcutedCounter();
+    uint32_t hit = 0;
+    CauseOfStop found = CauseOfStop::OK;
+    auto cond = [&](const CometII &c) {
+        const BreakPoint *bp = c.FindBreakPoint(c.PR);
+        if (bp != nullptr && c.GetExcutedCounter() < end && (!bp->cond || bp->cond(c))) {
+            hit = c.GetExcutedCounter();
+            found = CauseOfStop::BREAK_POINT;
+        }
+        return false;
+    };
+    // ウォッチポイントはアクセスした命令の実行後に停止するため、停止したときの実行命令数を記録する
+    auto on_watch = [&]() {
+        if (cpu.GetExcutedCounter() < end) {
+            hit = cpu.GetExcutedCounter();
+            found = CauseOfStop::WATCH_POINT;
+        }
+    };
+
+    // 新しいチェックポイントから順に、次のチェックポイント(最初は現在)までを再実行してブレークポイントを探す
+    size_t keep = checkpoints.size();
+    while (keep > 0 && checkpoints[keep - 1].state.counter >= end) keep--;
+    for (;;) {
+        Restore(keep);
+        uint32_t start = cpu.GetExcutedCounter();
+        Replay(end, cond, on_watch);
+        if (found != CauseOfStop::OK) {
+            GoTo(hit);
+            return found;
+        }
+        if (keep == 0) break;
+        keep--;
+        end = start;
+    }
+    GoTo(GetOldest());
+    return CauseOfStop::OK;
+}
+
+}  // namespace cii
@@ -0,0 +1,186 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "comet_ii.h"
+
+namespace cii {
+
+/**
+ * @class
+ * 実行履歴(逆実行用のチェックポイント)
+ * @note
+ * 記録開始時のメモリ全体とCPUの状態を起点にし、一定の命令数ごとに、CPUの状態と前のチェックポイントから
+ * 書き換えたページだけを保存する。SVC INで読み込んだ行も記録する。
+ * 過去の実行命令数に戻るときは、その直前のチェックポイントまでメモリとCPUの状態を戻し、
+ * 記録した入力を使って目的の命令数まで再実行する。
+ * 使用量が上限を超えたときは、一番古いチェックポイントを起点に統合するため、戻れる範囲が短くなる。
+ */
+class History {
+   public:
+    static constexpr uint32_t PAGE_WORDS = 256;                  //!< ページのワード数
+    static constexpr uint32_t DEFAULT_INTERVAL = 1000;           //!< チェックポイントの間隔(命令数)の既定値
+    static constexpr size_t DEFAULT_BUDGET = 64 * 1024 * 1024;  //!< 使用量の上限(バイト)の既定値
+
+    /**
+     * @brief Construct a new History object
+     *
+     * @param cpu 記録するCPU。CometII::SetHistoryは呼び出し側で行う
+     * @param budget 使用量の上限(バイト)。起点のメモリ全体を含む
+     * @param interval チェックポイントの間隔(命令数)
+     */
+    explicit History(CometII &cpu, size_t budget = DEFAULT_BUDGET, uint32_t interval = DEFAULT_INTERVAL);
+
+    /**
+     * @brief 現在の状態を起点にして記録し直す
+     * @note
+     * CometII::Resetのあとなど、記録と連続しない状態にしたときに呼び出す
+     */
+    void Start();
+
+    /**
+     * @brief 実行した命令で書き換えたページを記録する。間隔に達したときはチェックポイントを保存する
+     * @param op_code 命令コード
+     * @param ea 実効アドレス(2語命令のとき)
+     */
+    inline void Record(OpCode op_code, uint16_t ea) {
+        switch (op_code) {
+        case OpCode::ST:
+            Mark(ea);
+            break;
+        case OpCode::PUSH:
+        case OpCode::CALL:
+            Mark(cpu.SP);
+            break;
+        case OpCode::SVC:
+            if (ea == static_cast<uint16_t>(SVCNo::SVC_IN)) MarkInput();
+            break;
+        default:
+            break;
+        }
+        if (cpu.GetExcutedCounter() - last_counter >= interval) Checkpoint();
+    }
+    /**
+     * @brief SVC INで読み込んだ行を記録する
+     * @param line 行の先頭
+     * @param len 行の長さ
+     * @param ok false:入力の終わり
+     */
+    void RecordInput(const char *line, uint32_t len, bool ok);
+    /**
+     * @brief 戻したあとの実行では、記録した入力を取り出す
+     * @param line 行の先頭
+     * @param len 行の長さ
+     * @param ok false:入力の終わり
+     * @return false 記録した入力をすべて読み込んだ(入力元から読み込む)
+     */
+    bool ReplayInput(const char *&line, uint32_t &len, bool &ok);
+    /**
+     * @brief 戻るための再実行中かどうかを返す
+     */
+    bool IsReplaying() const { return replaying; }
+
+    /**
+     * @brief 指定した実行命令数の状態に戻す
+     * @param counter 実行命令数(GetOldestから現在まで)
+     * @return false 範囲外
+     */
+    bool GoTo(uint32_t counter);
+    /**
+     * @brief 現在より前で、最後にブレークポイントに到達した、またはウォッチポイントで停止した状態に戻す
+     * @return CauseOfStop BREAK_POINT、WATCH_POINT、またはOK(どちらにも到達していないため記録の先頭に戻した)
+     * @note
+     * 停止条件はブレークポイントの条件で判定し、通過回数は数えない
+     */
+    CauseOfStop ReverseContinue();
+
+    /**
+     * @brief 戻れる最も古い実行命令数を返す
+     */
+    uint32_t GetOldest() const { return base.state.counter; }
+    /**
+     * @brief 保存しているチェックポイントの数(起点を含まない)
+     */
+    size_t GetCheckpoints() const { return checkpoints.size(); }
+    /**
+     * @brief 使用量(バイト)
+     */
+    size_t GetUsed() const { return used; }
+
+   private:
+    /**
+     * @brief チェックポイント
+     */
+    struct Snapshot {
+        CpuState state;               //!< CPUの状態
+        size_t input_pos;             //!< 読み込んだ入力の数
+        std::vector<uint32_t> pages;  //!< 保存したページ(昇順)
+        std::vector<uint16_t> words;  //!< 保存したページの内容
+    };
+    /**
+     * @brief SVC INで読み込んだ行
+     */
+    struct Input {
+        std::string line;  //!< 行
+        bool ok;           //!< false:入力の終わり
+    };
+
+    CometII &cpu;                       //!< 記録するCPU
+    size_t budget;                      //!< 使用量の上限
+    uint32_t interval;                  //!< チェックポイントの間隔
+    Snapshot base;                      //!< 起点(メモリ全体)
+    std::deque<Snapshot> checkpoints;   //!< 起点より後のチェックポイント(古い順)
+    std::vector<uint8_t> dirty;         //!< 最後のチェックポイントから書き換えたページ
+    std::vector<uint32_t> dirty_pages;  //!< 最後のチェックポイントから書き換えたページの一覧
+    std::vector<Input> inputs;          //!< 起点から読み込んだ入力
+    size_t input_pos;                   //!< 次に読み込む入力
+    uint32_t last_input_len;            //!< 最後に読み込んだ行の長さ
+    uint32_t last_counter;              //!< 最後のチェックポイントの実行命令数
+    size_t used;                        //!< 使用量
+    bool replaying;                     //!< 再実行中
+
+    inline void Mark(uint32_t adr) {
+        if (adr >= cpu.GetMemory().size) return;
+        uint32_t page = adr / PAGE_WORDS;
+        if (dirty[page] == 0) {
+            dirty[page] = 1;
+            dirty_pages.push_back(page);
+        }
+    }
+    /**
+     * @brief SVC INで書き換えた長さと文字列のページを記録する
+     */
+    void MarkInput();
+    /**
+     * @brief チェックポイントを保存する。上限を超えたときは古いものを起点に統合する
+     */
+    void Checkpoint();
+    static size_t SnapshotSize(const Snapshot &s);
+    /**
+     * @brief チェックポイントの状態に戻す。以降のチェックポイントは削除する
+     * @param keep 残すチェックポイントの数(0のときは起点に戻す)
+     */
+    void Restore(size_t keep);
+    /**
+     * @brief 指定したページのチェックポイントでの内容を取得する
+     * @param keep 対象のチェックポイント(0のときは起点)
+     * @param page ページ
+     */
+    const uint16_t *FindPage(size_t keep, uint32_t page) const;
+    /**
+     * @brief 出力とブレークポイントなしで再実行する
+     * @param end 再実行を終える実行命令数
+     * @param cond 各命令の実行前に評価する関数(nullptrのときは評価しない)
+     * @param on_watch ウォッチポイントで停止するたびに呼び出す関数(nullptrのときは呼び出さない)
+     */
+    void Replay(uint32_t end, const BreakCond &cond = nullptr, const std::function<void()> &on_watch = nullptr);
+};
+
+}  // namespace cii
+#endif
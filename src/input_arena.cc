@@ -0,0 +1,29 @@
+#include "input_arena.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace cii {
+
+bool InputArena::Load(const std::string &file) {
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open()) return false;
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    Assign(ss.str());
+    return true;
+}
+
+void InputArena::Assign(std::string contents) {
+    data = std::move(contents);
+    line_tops.clear();
+    line_tops.push_back(0);
+    for (size_t pos = data.find('\n'); pos != std::string::npos; pos = data.find('\n', pos + 1)) {
+        line_tops.push_back((uint32_t)pos + 1);
+    }
+    // 改行で終わらない最終行
+    if (line_tops.back() != data.size()) line_tops.push_back((uint32_t)data.size() + 1);
+    next = 0;
+}
+
+}  // namespace cii
@@ -0,0 +1,60 @@
+#ifndef INPUT_ARENA_H_
+#define INPUT_ARENA_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cii {
+
+/**
+ * @class
+ * SVC INの入力元。入力全体をメモリに読み込み、行の開始位置を索引にする
+ * @note
+ * 行の区切りはstd::getlineと同じく'\n'で、最後の行は改行がなくてもよい。
+ */
+class InputArena {
+    std::string data;                 //!< 入力全体
+    std::vector<uint32_t> line_tops;  //!< 各行の開始位置。末尾に番兵(最終行の終端+1)を置く
+    size_t next;                      //!< 次に読み込む行
+
+   public:
+    InputArena() : next(0) { line_tops.push_back(0); }
+    explicit InputArena(std::string contents) : InputArena() { Assign(std::move(contents)); }
+
+    /**
+     * @brief ファイルの内容を入力にする
+     * @param file ファイル名
+     * @return true 成功
+     */
+    bool Load(const std::string &file);
+    /**
+     * @brief 文字列を入力にする
+     * @param contents 入力全体
+     */
+    void Assign(std::string contents);
+
+    /**
+     * @brief 次の行を取り出す
+     * @param line 行の先頭(改行を含まない)
+     * @param len 行の長さ
+     * @return false 入力の終わり
+     */
+    bool Next(const char *&line, uint32_t &len) {
+        if (next + 1 >= line_tops.size()) return false;
+
+        uint32_t top = line_tops[next];
+        line = data.data() + top;
+        len = line_tops[next + 1] - 1 - top;
+        next++;
+        return true;
+    }
+    /**
+     * @brief 先頭の行から読み直す
+     */
+    void Rewind() { next = 0; }
+    size_t GetLines() const { return line_tops.size() - 1; }
+};
+
+}  // namespace cii
+#endif
@@ -0,0 +1,404 @@
+#include "jit_x64.h"
+
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define CII_JIT_X64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define CII_JIT_X64 0
+#endif
+
+namespace cii {
+
+#if CII_JIT_X64
+namespace {
+static_assert(offsetof(JitContext, flags) < 0x80, "JitContext must be addressable with disp8");
+
+constexpr uint8_t OFF_GR = offsetof(JitContext, gr);
+constexpr uint8_t OFF_MEMORY = offsetof(JitContext, memory);
+constexpr uint8_t OFF_CODE_MAP = offsetof(JitContext, code_map);
+constexpr uint8_t OFF_SIZE = offsetof(JitContext, size);
+constexpr uint8_t OFF_STEPS = offsetof(JitContext, steps);
+constexpr uint8_t OFF_SP = offsetof(JitContext, sp);
+constexpr uint8_t OFF_PR = offsetof(JitContext, pr);
+constexpr uint8_t OFF_FLAGS = offsetof(JitContext, flags);
+
+constexpr uint8_t FLAG_OF = 1;
+constexpr uint8_t FLAG_SF = 2;
+constexpr uint8_t FLAG_ZF = 4;
+
+/*
+ * レジスタ割り当て
+ *   rdi : JitContext*
+ *   rsi : GR[8]
+ *   rdx : メモリ
+ *   r8  : 命令領域フラグ
+ *   r9d : メモリワードサイズ
+ *   eax, ecx, r10, r11 : 作業用
+ */
+
+/**
+ * @brief x86-64 機械語の出力
+ */
+class Emitter {
+   public:
+    std::vector<uint8_t> buf;
+
+    void Byte(std::initializer_list<uint8_t> bytes) { buf.insert(buf.end(), bytes); }
+    void Imm16(uint16_t v) { Byte({(uint8_t)v, (uint8_t)(v >> 8)}); }
+    void Imm32(uint32_t v) { Byte({(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)}); }
+    /**
+     * @brief 条件ジャンプ(rel32)を出力する
+     * @param cc 条件コード(0F xx の xx)
+     * @return size_t 飛び先を書き込む位置
+     */
+    size_t Jcc(uint8_t cc) {
+        Byte({0x0f, cc});
+        size_t pos = buf.size();
+        Imm32(0);
+        return pos;
+    }
+    /**
+     * @brief 条件ジャンプの飛び先を書き込む
+     * @param pos Jccの戻り値
+     * @param target 飛び先
+     */
+    void Patch(size_t pos, size_t target) {
+        int32_t rel = (int32_t)(target - (pos + 4));
+        std::memcpy(&buf[pos], &rel, sizeof(rel));
+    }
+
+    // GR[reg] のディスプレースメント
+    static uint8_t Gr(uint8_t reg) { return (uint8_t)(reg * 2); }
+
+    void Prologue() {
+        Byte({0x48, 0x8b, 0x77, OFF_GR});        // mov rsi, [rdi+gr]
+        Byte({0x48, 0x8b, 0x57, OFF_MEMORY});    // mov rdx, [rdi+memory]
+        Byte({0x4c, 0x8b, 0x47, OFF_CODE_MAP});  // mov r8, [rdi+code_map]
+        Byte({0x44, 0x8b, 0x4f, OFF_SIZE});      // mov r9d, [rdi+size]
+    }
+    /**
+     * @brief PRと実行命令数を設定して戻る
+     */
+    void Exit(uint16_t pr, uint32_t steps) {
+        Byte({0x66, 0xc7, 0x47, OFF_PR});  // mov word [rdi+pr], imm16
+        Imm16(pr);
+        Byte({0xc7, 0x47, OFF_STEPS});  // mov dword [rdi+steps], imm32
+        Imm32(steps);
+        Byte({0xc3});  // ret
+    }
+    /**
+     * @brief 実効アドレスを ecx に求める
+     */
+    void EffectiveAdr(uint16_t adr, uint8_t x) {
+        Byte({0xb9});  // mov ecx, imm32
+        Imm32(adr);
+        if (x != 0) Byte({0x66, 0x03, 0x4e, Gr(x)});  // add cx, [rsi+x]
+    }
+    /**
+     * @brief ecx がメモリ範囲外のときに飛ぶ
+     * @return size_t 飛び先を書き込む位置
+     */
+    size_t CheckRangeEcx() {
+        Byte({0x44, 0x39, 0xc9});  // cmp ecx, r9d
+        return Jcc(0x83);          // jae
+    }
+    size_t CheckRangeEax() {
+        Byte({0x44, 0x39, 0xc8});  // cmp eax, r9d
+        return Jcc(0x83);          // jae
+    }
+    /**
+     * @brief x86のフラグからOF,SF,ZFを求めて保存する
+     * @param carry true:論理演算(CFをOFとする) false:算術演算
+     */
+    void Flags(bool carry) {
+        Byte({0x41, 0x0f, (uint8_t)(carry ? 0x92 : 0x90), 0xc2});  // setc/seto r10b
+        Byte({0x41, 0x0f, 0x98, 0xc3});                            // sets r11b
+        Byte({0x0f, 0x94, 0xc1});                                  // setz cl
+        Byte({0x41, 0xd0, 0xe3});                                  // shl r11b, 1
+        Byte({0xc0, 0xe1, 0x02});                                  // shl cl, 2
+        Byte({0x45, 0x08, 0xda});                                  // or r10b, r11b
+        Byte({0x41, 0x08, 0xca});                                  // or r10b, cl
+        Byte({0x44, 0x88, 0x57, OFF_FLAGS});                       // mov [rdi+flags], r10b
+    }
+};
+
+/**
+ * @brief 演算命令の機械語
+ */
+struct AluOp {
+    uint8_t rm_r;  //!< op r/m16, r16
+    uint8_t r_rm;  //!< op r16, r/m16
+    bool carry;    //!< 論理演算
+    bool store;    //!< 結果をレジスタに格納する
+};
+
+bool GetAluOp(OpCode op, AluOp &alu) {
+    switch (op) {
+    case OpCode::ADDA_R:
+    case OpCode::ADDA_M:
+        alu = {0x01, 0x03, false, true};
+        return true;
+    case OpCode::ADDL_R:
+    case OpCode::ADDL_M:
+        alu = {0x01, 0x03, true, true};
+        return true;
+    case OpCode::SUBA_R:
+    case OpCode::SUBA_M:
+        alu = {0x29, 0x2b, false, true};
+        return true;
+    case OpCode::SUBL_R:
+    case OpCode::SUBL_M:
+        alu = {0x29, 0x2b, true, true};
+        return true;
+    case OpCode::CPA_R:
+    case OpCode::CPA_M:
+        alu = {0x29, 0x2b, false, false};
+        return true;
+    case OpCode::CPL_R:
+    case OpCode::CPL_M:
+        alu = {0x29, 0x2b, true, false};
+        return true;
+    case OpCode::AND_R:
+    case OpCode::AND_M:
+        alu = {0x21, 0x23, false, true};
+        return true;
+    case OpCode::OR_R:
+    case OpCode::OR_M:
+        alu = {0x09, 0x0b, false, true};
+        return true;
+    case OpCode::XOR_R:
+    case OpCode::XOR_M:
+        alu = {0x31, 0x33, false, true};
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 分岐条件
+ * @param mask 判定するフラグ
+ * @param if_zero true:(flags & mask) == 0 で分岐する
+ */
+bool GetJumpCond(OpCode op, uint8_t &mask, bool &if_zero) {
+    switch (op) {
+    case OpCode::JPL:
+        mask = FLAG_SF | FLAG_ZF;
+        if_zero = true;
+        return true;
+    case OpCode::JMI:
+        mask = FLAG_SF;
+        if_zero = false;
+        return true;
+    case OpCode::JNZ:
+        mask = FLAG_ZF;
+        if_zero = true;
+        return true;
+    case OpCode::JZE:
+        mask = FLAG_ZF;
+        if_zero = false;
+        return true;
+    case OpCode::JOV:
+        mask = FLAG_OF;
+        if_zero = false;
+        return true;
+    case OpCode::JUMP:
+        mask = 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool IsRegReg(OpCode op) { return (static_cast<uint8_t>(op) & 0x04) != 0; }
+}  // namespace
+
+JitX64::JitX64(uint32_t mem_size)
+    : block_at(mem_size, NOT_COMPILED), hot(mem_size, 0), code(nullptr), code_used(0) {
+    // 書き込みと実行を同時に許可しない。ブロックを書き込んだページだけを実行可能にする
+    void *p = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) code = static_cast<uint8_t *>(p);
+}
+
+JitX64::~JitX64() {
+    if (code != nullptr) munmap(code, CODE_SIZE);
+}
+
+const JitX64::Block *JitX64::Compile(uint16_t start, const Memory &mem, uint8_t *code_map) {
+    struct Fallback {
+        size_t pos;      //!< jccの飛び先位置
+        uint16_t pr;     //!< インタプリタで再実行するアドレス
+        uint16_t steps;  //!< それまでに実行した命令数
+    };
+    Emitter e;
+    std::vector<Fallback> fallbacks;
+
+    e.Prologue();
+
+    uint32_t pc = start;
+    uint16_t n = 0;
+    bool terminated = false;
+    while (n < MAX_BLOCK_OPS && pc < mem.size) {
+        OpWord opword = mem.memory[pc].opword;
+        OpCode op = opword.GetOpCode();
+        uint8_t d = opword.des_reg;
+        uint8_t x = opword.src_reg;
+        AluOp alu;
+        uint8_t mask;
+        bool if_zero;
+
+        bool one_word = op == OpCode::LD_R || op == OpCode::POP || (GetAluOp(op, alu) && IsRegReg(op));
+        uint32_t len = one_word ? 1 : 2;
+        if (pc + len > mem.size) break;
+        uint16_t adr = one_word ? 0 : mem.memory[pc + 1].data;
+        auto fallback = [&](size_t pos) { fallbacks.push_back({pos, (uint16_t)pc, n}); };
+
+        if (GetAluOp(op, alu)) {
+            if (IsRegReg(op)) {
+                e.Byte({0x66, 0x8b, 0x46, Emitter::Gr(d)});  // mov ax, [rsi+d]
+                e.Byte({0x66, 0x8b, 0x4e, Emitter::Gr(x)});  // mov cx, [rsi+x]
+                e.Byte({0x66, alu.rm_r, 0xc8});              // op ax, cx
+            } else {
+                e.EffectiveAdr(adr, x);
+                fallback(e.CheckRangeEcx());
+                e.Byte({0x66, 0x8b, 0x46, Emitter::Gr(d)});  // mov ax, [rsi+d]
+                e.Byte({0x66, alu.r_rm, 0x04, 0x4a});        // op ax, [rdx+rcx*2]
+            }
+            if (alu.store) e.Byte({0x66, 0x89, 0x46, Emitter::Gr(d)});  // mov [rsi+d], ax
+            e.Flags(alu.carry);
+        } else if (op == OpCode::LD_R) {
+            e.Byte({0x66, 0x8b, 0x46, Emitter::Gr(x)});  // mov ax, [rsi+x]
+            e.Byte({0x66, 0x89, 0x46, Emitter::Gr(d)});  // mov [rsi+d], ax
+            e.Byte({0x66, 0x85, 0xc0});                  // test ax, ax
+            e.Flags(false);
+        } else if (op == OpCode::LD_M) {
+            e.EffectiveAdr(adr, x);
+            fallback(e.CheckRangeEcx());
+            e.Byte({0x66, 0x8b, 0x04, 0x4a});            // mov ax, [rdx+rcx*2]
+            e.Byte({0x66, 0x89, 0x46, Emitter::Gr(d)});  // mov [rsi+d], ax
+            e.Byte({0x66, 0x85, 0xc0});                  // test ax, ax
+            e.Flags(false);
+        } else if (op == OpCode::ST) {
+            e.EffectiveAdr(adr, x);
+            fallback(e.CheckRangeEcx());
+            e.Byte({0x41, 0x80, 0x3c, 0x08, 0x00});  // cmp byte [r8+rcx], 0
+            fallback(e.Jcc(0x85));                   // jne
+            e.Byte({0x66, 0x8b, 0x46, Emitter::Gr(d)});  // mov ax, [rsi+d]
+            e.Byte({0x66, 0x89, 0x04, 0x4a});            // mov [rdx+rcx*2], ax
+        } else if (op == OpCode::LAD) {
+            e.EffectiveAdr(adr, x);
+            e.Byte({0x66, 0x89, 0x4e, Emitter::Gr(d)});  // mov [rsi+d], cx
+        } else if (op == OpCode::PUSH) {
+            e.Byte({0x0f, 0xb7, 0x47, OFF_SP});  // movzx eax, word [rdi+sp]
+            e.Byte({0x66, 0xff, 0xc8});          // dec ax
+            fallback(e.CheckRangeEax());
+            e.Byte({0x41, 0x80, 0x3c, 0x00, 0x00});  // cmp byte [r8+rax], 0
+            fallback(e.Jcc(0x85));                   // jne
+            e.EffectiveAdr(adr, x);
+            e.Byte({0x66, 0x89, 0x0c, 0x42});    // mov [rdx+rax*2], cx
+            e.Byte({0x66, 0x89, 0x47, OFF_SP});  // mov [rdi+sp], ax
+        } else if (op == OpCode::POP) {
+            e.Byte({0x0f, 0xb7, 0x47, OFF_SP});  // movzx eax, word [rdi+sp]
+            fallback(e.CheckRangeEax());
+            e.Byte({0x66, 0x8b, 0x0c, 0x42});            // mov cx, [rdx+rax*2]
+            e.Byte({0x66, 0x89, 0x4e, Emitter::Gr(d)});  // mov [rsi+d], cx
+            e.Byte({0x66, 0xff, 0xc0});                  // inc ax
+            e.Byte({0x66, 0x89, 0x47, OFF_SP});          // mov [rdi+sp], ax
+        } else if (GetJumpCond(op, mask, if_zero)) {
+            e.EffectiveAdr(adr, x);
+            size_t not_taken = 0;
+            if (mask != 0) {
+                e.Byte({0xf6, 0x47, OFF_FLAGS, mask});     // test byte [rdi+flags], mask
+                not_taken = e.Jcc(if_zero ? 0x85 : 0x84);  // jnz / jz
+            }
+            fallback(e.CheckRangeEcx());
+            e.Byte({0x66, 0x89, 0x4f, OFF_PR});  // mov [rdi+pr], cx
+            e.Byte({0xc7, 0x47, OFF_STEPS});     // mov dword [rdi+steps], n+1
+            e.Imm32(n + 1);
+            e.Byte({0xc3});  // ret
+            if (mask != 0) {
+                e.Patch(not_taken, e.buf.size());
+                e.Exit((uint16_t)(pc + len), n + 1);
+            }
+            terminated = true;
+        } else {
+            // CALL/RET/SVC/HLT/シフト命令などはインタプリタで実行する
+            break;
+        }
+        pc += len;
+        n++;
+        if (terminated) break;
+    }
+
+    if (n == 0) {
+        block_at[start] = UNCOMPILABLE;
+        return nullptr;
+    }
+    if (!terminated) e.Exit((uint16_t)pc, n);
+    for (auto &fb : fallbacks) {
+        e.Patch(fb.pos, e.buf.size());
+        e.Exit(fb.pr, fb.steps);
+    }
+
+    if (code == nullptr || e.buf.size() > CODE_SIZE) {
+        block_at[start] = UNCOMPILABLE;
+        return nullptr;
+    }
+    if (code_used + e.buf.size() > CODE_SIZE) Clear();
+
+    // 書き込むページを書き込み可能に戻し、書き込んだあとに実行可能にする
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t page_begin = code_used / page_size * page_size;
+    size_t page_len = code_used + e.buf.size() - page_begin;
+    if (mprotect(code + page_begin, page_len, PROT_READ | PROT_WRITE) != 0) {
+        block_at[start] = UNCOMPILABLE;
+        return nullptr;
+    }
+    std::memcpy(code + code_used, e.buf.data(), e.buf.size());
+    if (mprotect(code + page_begin, page_len, PROT_READ | PROT_EXEC) != 0) {
+        block_at[start] = UNCOMPILABLE;
+        return nullptr;
+    }
+    BlockFunc func = reinterpret_cast<BlockFunc>(code + code_used);
+    code_used += e.buf.size();
+
+    for (uint32_t adr = start; adr < pc; adr++) code_map[adr] = 1;
+
+    block_at[start] = (int32_t)blocks.size();
+    blocks.push_back({start, (uint16_t)pc, func});
+    return &blocks.back();
+}
+
+#else
+
+JitX64::JitX64(uint32_t mem_size) : block_at(mem_size, NOT_COMPILED), hot(mem_size, 0), code(nullptr), code_used(0) {}
+JitX64::~JitX64() {}
+const JitX64::Block *JitX64::Compile(uint16_t start, const Memory &, uint8_t *) {
+    block_at[start] = UNCOMPILABLE;
+    return nullptr;
+}
+
+#endif
+
+void JitX64::Invalidate(uint16_t adr) {
+    for (auto &block : blocks) {
+        if (block.func != nullptr && block.start <= adr && adr < block.end) {
+            block_at[block.start] = NOT_COMPILED;
+            hot[block.start] = 0;
+            block.func = nullptr;
+        }
+    }
+}
+
+void JitX64::Clear() {
+    std::fill(block_at.begin(), block_at.end(), NOT_COMPILED);
+    std::fill(hot.begin(), hot.end(), 0);
+    blocks.clear();
+    code_used = 0;
+}
+
+}  // namespace cii
@@ -0,0 +1,116 @@
+#ifndef JIT_X64_H_
+#define JIT_X64_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "comet_ii.h"
+
+namespace cii {
+
+/**
+ * @struct
+ * ネイティブコードとのインタフェース
+ * @note
+ * ネイティブコードはオフセットでアクセスするため、メンバの順番を変えないこと
+ */
+struct JitContext {
+    uint16_t *gr;              //!< 汎用レジスタ配列 GR[8]
+    WordData *memory;          //!< メモリ
+    const uint8_t *code_map;   //!< アドレスごとの命令(デコード済み)フラグ
+    uint32_t size;             //!< メモリワードサイズ
+    uint32_t steps;            //!< 実行した命令数(出力)
+    uint16_t sp;               //!< スタックポインタ(入出力)
+    uint16_t pr;               //!< 次に実行するアドレス(出力)
+    uint8_t flags;             //!< フラグ(入出力) bit0:OF bit1:SF bit2:ZF
+};
+
+/**
+ * @class
+ * 基本ブロック単位のx86-64 JITコンパイラ
+ * @note
+ * 基本ブロックはJPL/JMI/JNZ/JZE/JOV/JUMPで終わる。
+ * CALL/RET/SVC/HLT、シフト命令、範囲外アクセス、命令領域への書き込みでは
+ * インタプリタに戻る。
+ */
+class JitX64 {
+   public:
+    using BlockFunc = void (*)(JitContext *ctx);
+
+    /**
+     * @brief コンパイル済みブロック
+     */
+    struct Block {
+        uint16_t start;  //!< 先頭アドレス
+        uint16_t end;    //!< 終了アドレス(含まない)
+        BlockFunc func;  //!< ネイティブコード
+    };
+
+    //! コンパイルするまでの実行回数
+    static constexpr uint16_t HOT_THRESHOLD = 16;
+    //! 1ブロックの最大命令数
+    static constexpr uint16_t MAX_BLOCK_OPS = 64;
+
+    explicit JitX64(uint32_t mem_size);
+    ~JitX64();
+    JitX64(const JitX64 &) = delete;
+    JitX64 &operator=(const JitX64 &) = delete;
+
+    /**
+     * @brief この環境でJITが使用できるかどうか
+     * @return true 使用できる(x86-64で、コード領域を確保できた)
+     */
+    bool IsAvailable() const { return code != nullptr; }
+
+    /**
+     * @brief 最後にClearしてからコンパイルしたブロック数(Invalidateで破棄したものを含む)
+     */
+    size_t GetCompiledCount() const { return blocks.size(); }
+    /**
+     * @brief 指定アドレスから始まるコンパイル済みブロックを取得する
+     * @param adr アドレス
+     * @return const Block* ブロック、ないときはnullptr
+     */
+    inline const Block *Find(uint16_t adr) const {
+        int32_t index = block_at[adr];
+        return index >= 0 ? &blocks[index] : nullptr;
+    }
+    /**
+     * @brief ブロックの実行回数を数え、コンパイルする時期かどうかを返す
+     * @param adr ブロックの先頭アドレス
+     * @return true コンパイルする
+     */
+    inline bool IsHot(uint16_t adr) { return block_at[adr] == NOT_COMPILED && ++hot[adr] >= HOT_THRESHOLD; }
+    /**
+     * @brief 指定アドレスから始まるブロックをコンパイルする
+     * @param start 先頭アドレス
+     * @param mem メモリ
+     * @param code_map 命令領域フラグ。コンパイルした範囲を設定する
+     * @return const Block* ブロック、コンパイルできないときはnullptr
+     */
+    const Block *Compile(uint16_t start, const Memory &mem, uint8_t *code_map);
+    /**
+     * @brief 指定アドレスを含むブロックを破棄する
+     * @param adr 書き換えたアドレス
+     */
+    void Invalidate(uint16_t adr);
+    /**
+     * @brief すべてのブロックを破棄する
+     */
+    void Clear();
+
+   private:
+    static constexpr int32_t NOT_COMPILED = -1;  //!< 未コンパイル
+    static constexpr int32_t UNCOMPILABLE = -2;  //!< コンパイルできない
+    static constexpr size_t CODE_SIZE = 1024 * 1024;
+
+    std::vector<int32_t> block_at;  //!< アドレスごとのブロック番号
+    std::vector<uint16_t> hot;      //!< アドレスごとの実行回数
+    std::vector<Block> blocks;      //!< コンパイル済みブロック
+    uint8_t *code;                  //!< コード領域(書き込んだページは読み込みと実行のみ可能にする)
+    size_t code_used;               //!< コード領域の使用量
+};
+
+}  // namespace cii
+#endif
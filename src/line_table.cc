@@ -0,0 +1,81 @@
+#include "line_table.h"
+
+#include <algorithm>
+
+namespace ass {
+
+void LineTable::AddFile(const std::string &name) {
+    files.push_back(name);
+    file_tops.push_back(Size());
+}
+
+void LineTable::Add(std::string_view text, AsmErrCode err, uint16_t start_offset, uint16_t end_offset) {
+    if (files.empty()) AddFile("");
+
+    source.append(text);
+    text_tops.push_back((uint32_t)source.size());
+    start_offsets.push_back(start_offset);
+    end_offsets.push_back(end_offset);
+    file_ids.push_back((uint16_t)(files.size() - 1));
+    line_nos.push_back(Size() - file_tops.back());
+    flags.push_back((uint8_t)err);
+}
+
+void LineTable::Append(const LineTable &lines) {
+    if (files.empty()) AddFile("");
+
+    uint32_t base = (uint32_t)source.size();
+    uint32_t line_no = Size() - file_tops.back();
+    source.append(lines.source);
+    for (uint32_t i = 1; i < lines.text_tops.size(); i++) text_tops.push_back(base + lines.text_tops[i]);
+    start_offsets.insert(start_offsets.end(), lines.start_offsets.begin(), lines.start_offsets.end());
+    end_offsets.insert(end_offsets.end(), lines.end_offsets.begin(), lines.end_offsets.end());
+    file_ids.resize(Size(), (uint16_t)(files.size() - 1));
+    for (uint32_t i = 0; i < lines.Size(); i++) line_nos.push_back(++line_no);
+    flags.insert(flags.end(), lines.flags.begin(), lines.flags.end());
+}
+
+void LineTable::Relocate(uint16_t base) {
+    for (auto &offset : start_offsets) offset += base;
+    for (auto &offset : end_offsets) offset += base;
+}
+
+void LineTable::Reserve(uint32_t lines, size_t text_size) {
+    source.reserve(text_size);
+    text_tops.reserve(lines + 1);
+    start_offsets.reserve(lines);
+    end_offsets.reserve(lines);
+    file_ids.reserve(lines);
+    line_nos.reserve(lines);
+    flags.reserve(lines);
+}
+
+void LineTable::Clear() {
+    source.clear();
+    text_tops.assign(1, 0);
+    start_offsets.clear();
+    end_offsets.clear();
+    file_ids.clear();
+    line_nos.clear();
+    flags.clear();
+    files.clear();
+    file_tops.clear();
+    adr_lines.clear();
+}
+
+void LineTable::BuildIndex() {
+    adr_lines.assign(end_offsets.empty() ? 0 : *std::max_element(end_offsets.begin(), end_offsets.end()), NO_LINE);
+    for (uint32_t i = 0; i < Size(); i++) {
+        std::fill(adr_lines.begin() + start_offsets[i], adr_lines.begin() + end_offsets[i], i);
+    }
+}
+
+std::pair<uint32_t, uint32_t> LineTable::FindLines(uint16_t start, uint16_t end) const {
+    // 開始アドレスも終了アドレスも行の順に増えるため、条件を満たす行は連続する
+    uint32_t first = (uint32_t)(std::lower_bound(start_offsets.begin(), start_offsets.end(), start) - start_offsets.begin());
+    uint32_t last = first;
+    while (last < Size() && end_offsets[last] < end) last++;
+    return {first, last};
+}
+
+}  // namespace ass
@@ -0,0 +1,123 @@
+#ifndef LINE_TABLE_H_
+#define LINE_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ass {
+
+enum class AsmErrCode {
+    OK,
+    NO_OPERATION,     //<! 命令コードがない
+    NO_OPERAND,       //<! オペランドがない
+    INVALID_OPERAND,  //<! 余計なオペランド
+    NO_DC_OR_DS,      //<! 定数、文字列が指定されたがDC,DSが宣言されていない
+    NO_DEF_SYM,       //<! シンボルの定義が見つからない
+    MULTI_DEF_SYM,    //<! シンボル多重定義
+    ERR,              //!< その他のエラー
+};
+
+/**
+ * @class
+ * デバッグ情報の行テーブル
+ * @note
+ * 行ごとの項目を項目ごとの配列に持つ。ソースの行は1つのバッファに連結し、行はその範囲で表す。
+ * トークンは持たないため、必要なときはTextをReaderで解析し直す。
+ */
+class LineTable {
+    std::string source;                   //!< 全行のソース(改行なしで連結)
+    std::vector<uint32_t> text_tops;      //!< 行のsource内の開始位置(末尾は番兵)
+    std::vector<uint16_t> start_offsets;  //!< 行の開始アドレス
+    std::vector<uint16_t> end_offsets;    //!< 行の終了アドレス
+    std::vector<uint16_t> file_ids;       //!< 行のファイル番号
+    std::vector<uint32_t> line_nos;       //!< ファイル内の行番号(1から)
+    std::vector<uint8_t> flags;           //!< エラーコード(ERR_MASK)とブレークポイント(BREAK)
+    std::vector<std::string> files;       //!< ファイル名(ファイル番号順)
+    std::vector<uint32_t> file_tops;      //!< ファイルの最初の行
+    std::vector<uint32_t> adr_lines;      //!< アドレスからそのアドレスを含む行(BuildIndexで作成)
+
+    static constexpr uint8_t ERR_MASK = 0x0f;  //!< エラーコード
+    static constexpr uint8_t BREAK = 0x80;     //!< ブレークポイント
+
+   public:
+    static constexpr uint32_t NO_LINE = UINT32_MAX;  //!< 行なし
+
+    LineTable() : text_tops{0} {}
+
+    /**
+     * @brief ファイルを追加する。以降に追加する行はこのファイルの行になる
+     * @param name ファイル名
+     */
+    void AddFile(const std::string &name);
+    /**
+     * @brief 行を追加する
+     * @param text ソースの行
+     * @param err アセンブルエラー
+     * @param start_offset 開始アドレス
+     * @param end_offset 終了アドレス
+     * @note
+     * ファイルを追加していないときは、名前が空のファイルを追加する
+     */
+    void Add(std::string_view text, AsmErrCode err, uint16_t start_offset, uint16_t end_offset);
+    /**
+     * @brief 別の行テーブルの行を現在のファイルの行として追加する
+     */
+    void Append(const LineTable &lines);
+    /**
+     * @brief 全行のアドレスをずらす
+     * @param base ずらすワード数
+     */
+    void Relocate(uint16_t base);
+    /**
+     * @brief 行を追加する領域を確保しておく
+     * @param lines 行数
+     * @param text_size ソースの行のバイト数の合計
+     */
+    void Reserve(uint32_t lines, size_t text_size);
+    void Clear();
+    /**
+     * @brief アドレスから行を引く索引を作成する
+     * @note
+     * 行はアドレスの順に並んでいること。行を追加、再配置したら作成し直す
+     */
+    void BuildIndex();
+    /**
+     * @brief アドレスを含む行を取得する
+     * @param adr アドレス
+     * @return uint32_t アドレスを含む行(長さが0の行は含まない)、ないときはNO_LINE
+     */
+    uint32_t FindLine(uint16_t adr) const { return adr < adr_lines.size() ? adr_lines[adr] : NO_LINE; }
+    /**
+     * @brief 開始アドレスがstart以上、終了アドレスがend未満の行の範囲を取得する
+     * @return std::pair<uint32_t, uint32_t> 行の範囲[first, second)
+     */
+    std::pair<uint32_t, uint32_t> FindLines(uint16_t start, uint16_t end) const;
+
+    uint32_t Size() const { return (uint32_t)start_offsets.size(); }
+    bool Empty() const { return start_offsets.empty(); }
+
+    std::string_view Text(uint32_t i) const {
+        return std::string_view(source).substr(text_tops[i], text_tops[i + 1] - text_tops[i]);
+    }
+    AsmErrCode Err(uint32_t i) const { return (AsmErrCode)(flags[i] & ERR_MASK); }
+    void SetErr(uint32_t i, AsmErrCode err) { flags[i] = (flags[i] & ~ERR_MASK) | (uint8_t)err; }
+    bool IsBreak(uint32_t i) const { return (flags[i] & BREAK) != 0; }
+    void SetBreak(uint32_t i, bool on) { flags[i] = on ? flags[i] | BREAK : flags[i] & ~BREAK; }
+    uint16_t StartOffset(uint32_t i) const { return start_offsets[i]; }
+    uint16_t EndOffset(uint32_t i) const { return end_offsets[i]; }
+    uint16_t FileId(uint32_t i) const { return file_ids[i]; }
+    uint32_t LineNo(uint32_t i) const { return line_nos[i]; }
+
+    uint16_t GetFiles() const { return (uint16_t)files.size(); }
+    const std::string &FileName(uint16_t id) const { return files[id]; }
+    //! ファイルの最初の行
+    uint32_t FileBegin(uint16_t id) const { return file_tops[id]; }
+    //! ファイルの最後の行の次
+    uint32_t FileEnd(uint16_t id) const { return id + 1u < files.size() ? file_tops[id + 1] : Size(); }
+};
+
+}  // namespace ass
+#endif
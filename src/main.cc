@@ -1,4 +1,7 @@
 
+#include <algorithm>
+#include <chrono>
+#include <ctime>
 #include <fstream>
 #include <iostream>
 
@@ -6,9 +9,13 @@
 #include "builder.h"
 #include "conf.h"
 #include "debugger.h"
+#include "exec_image.h"
 
 #ifdef _MSC_VER
 #include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
 #endif
 
 namespace {
@@ -16,7 +23,98 @@ const cii::ColorChar C_START(cmn::Color::F_BLUE);
 const cii::ColorChar C_ERROR(cmn::Color::F_BRIGHT_RED);
 const cii::ColorChar C_RESET(cmn::Color::RESET);
 
-cii::CommetIIEnv commetII_env;
+/**
+ * @brief メモリワードサイズのオプションを変換する
+ *
+ * @param s オプション値
+ * @param mem_size メモリワードサイズ
+ * @return true 成功
+ */
+bool ParseMemSize(const std::string& s, uint32_t& mem_size) {
+    if (s.empty() || s.size() > 6 || s.find_first_not_of("0123456789") != std::string::npos) return false;
+    mem_size = std::stoul(s);
+    return mem_size > 0 && mem_size <= cii::CommetIIEnv::MAX_MEM_SIZE;
+}
+
+/**
+ * @brief 標準入力が端末かどうかを返す
+ */
+bool IsInteractive() {
+#ifdef _MSC_VER
+    return _isatty(_fileno(stdin)) != 0;
+#else
+    return isatty(fileno(stdin)) != 0;
+#endif
+}
+
+/**
+ * @brief --runの停止要因から終了コードを返す
+ * @note
+ * 0:正常終了、1:オプションまたはビルドのエラー、2以降:異常停止
+ */
+int ExitCode(cii::CauseOfStop cause) {
+    switch (cause) {
+    // STARTからのRETもHALTで停止する
+    case cii::CauseOfStop::HALT:
+        return 0;
+    case cii::CauseOfStop::ILLEGAL_ACCESS:
+        return 2;
+    case cii::CauseOfStop::INVALID_OPERATION:
+        return 3;
+    case cii::CauseOfStop::STACK_OVERFLOW:
+        return 4;
+    case cii::CauseOfStop::STACK_UNDERFLOW:
+        return 5;
+    case cii::CauseOfStop::STEP_LIMIT:
+        return 6;
+    default:
+        return 7;
+    }
+}
+
+/**
+ * @brief デバッガを使用せずに、停止するまで実行する
+ * @param cpu ビルドしたプログラムを配置したCPU
+ * @param start 開始アドレス
+ * @param max_steps 最大命令数(0のときは停止するまで実行する)
+ * @param profile_file プロファイルの出力先(空のときはプロファイルしない)
+ * @param syms 関数の名前にするシンボル
+ * @return int 終了コード
+ * @note
+ * SVC INは標準入力から、SVC OUTは標準出力に行う。停止要因、実行命令数、経過時間とCPU時間を標準エラー出力に出力する
+ */
+int RunHeadless(cii::CometII& cpu, uint16_t start, uint32_t max_steps, const std::string& profile_file,
+                const std::vector<cii::SymValue>& syms) {
+    // 端末から入力するときは入力を促す出力を先に表示する
+    if (IsInteractive()) cpu.SetSvcOutBuffer(0);
+    std::unique_ptr<cii::Profiler> profiler;
+    if (!profile_file.empty()) {
+        profiler = std::make_unique<cii::Profiler>(cpu.GetMemory().size);
+        cpu.SetProfiler(profiler.get());
+    }
+    cpu.Reset();
+    cpu.PR = start;
+
+    auto wall_start = std::chrono::steady_clock::now();
+    std::clock_t cpu_start = std::clock();
+    cii::CauseOfStop cause = max_steps == 0 ? cpu.Run() : cpu.RunFor(max_steps).cause;
+    double cpu_sec = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    double wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    cpu.SetProfiler(nullptr);
+    std::cout.flush();
+
+    std::cerr << cmn::Format("cause: %s, steps: %u, wall: %.3f ms, cpu: %.3f ms\n", cii::GetCauseName(cause),
+                             cpu.GetExcutedCounter(), wall_sec * 1000, cpu_sec * 1000);
+    if (profiler) {
+        std::ofstream ofs(profile_file);
+        if (!ofs.is_open()) {
+            std::cerr << "プロファイルを書き込めません:" << profile_file << std::endl;
+            return 1;
+        }
+        profiler->WriteFolded(ofs, syms);
+    }
+    return ExitCode(cause);
+}
 }  // namespace
 
 int main(int argc, char* argv[]) {
@@ -27,29 +125,134 @@ int main(int argc, char* argv[]) {
     setvbuf(stdout, nullptr, _IOFBF, 1000);
 #endif
 
-    if (argc < 2) {
-        cmn::C << "ファイル名が指定されていません。";
+    uint32_t mem_size = cii::CommetIIEnv::DEFAULT_MEM_SIZE;
+    bool has_mem_size = false;
+    std::string cache_dir;
+    std::string emit_image;
+    std::string run_image;
+    std::string profile_file;
+    bool run = std::find_if(argv + 1, argv + argc, [](const char* a) { return std::string(a) == "--run"; }) !=
+               argv + argc;
+    // --runのときは、オプションやビルドのエラー表示でプログラムの出力を汚さないように、標準エラー出力に切り替える
+    cmn::CoutToCerr diag{run};
+    uint32_t max_steps = 0;
+    // 実行履歴の記録中は命令ごとに記録するため、--historyを指定したときだけ記録する
+    size_t history_budget = 0;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-m") {
+            if (i + 1 >= argc || !ParseMemSize(argv[++i], mem_size)) {
+                cmn::C << cmn::Format("-m: メモリワードサイズは1から%uで指定してください。\n",
+                                      cii::CommetIIEnv::MAX_MEM_SIZE);
+                return 1;
+            }
+            has_mem_size = true;
+        } else if (arg == "--run") {
+            // 先に判定済み
+        } else if (arg == "--max-steps") {
+            std::string value = i + 1 < argc ? argv[++i] : "";
+            if (value.empty() || value.size() > 9 || value.find_first_not_of("0123456789") != std::string::npos) {
+                cmn::C << "--max-steps: 最大命令数を指定してください(0のときは停止するまで実行する)。\n";
+                return 1;
+            }
+            max_steps = std::stoul(value);
+        } else if (arg == "--history") {
+            std::string value = i + 1 < argc ? argv[++i] : "";
+            if (value.empty() || value.size() > 6 || value.find_first_not_of("0123456789") != std::string::npos) {
+                cmn::C << "--history: 実行履歴の上限をMiBで指定してください(0のときは記録しない)。\n";
+                return 1;
+            }
+            history_budget = std::stoul(value) * 1024 * 1024;
+        } else if (arg == "--cache" || arg == "--emit-image" || arg == "--run-image" || arg == "--profile") {
+            if (i + 1 >= argc) {
+                cmn::C << arg << ": " << (arg == "--cache" ? "キャッシュディレクトリ" : "ファイル名")
+                       << "を指定してください。\n";
+                return 1;
+            }
+            std::string& value = arg == "--cache"        ? cache_dir
+                                 : arg == "--emit-image" ? emit_image
+                                 : arg == "--run-image"  ? run_image
+                                                         : profile_file;
+            value = argv[++i];
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (run_image.empty() == files.empty()) {
+        cmn::C << (files.empty() ? "ファイル名が指定されていません。"
+                                 : "--run-imageとソースファイルは同時に指定できません。");
         return 1;
     }
 
-    std::vector<std::string> files;
+    // 実行イメージはビルドしたときのメモリワードサイズで実行する
+    cii::ExecImage image;
+    if (!run_image.empty()) {
+        if (!image.Open(run_image)) {
+            cmn::C << "実行イメージを読み込めません:" << run_image << std::endl;
+            return 1;
+        }
+        if (!has_mem_size) mem_size = image.GetMemSize();
+    }
 
-    std::copy(&argv[1], &argv[argc], std::back_inserter(files));
+    cii::CommetIIEnv commetII_env{mem_size};
 
-    Builder build{commetII_env};
+    ass::LineTable all_dbg_infos;
+    uint32_t used;
+    uint16_t start;
+    if (!run_image.empty()) {
+        if (!image.Load(commetII_env.mem)) {
+            cmn::C << cmn::Format("メモリワードサイズが足りません。%u以上を指定してください。\n", image.GetUsed());
+            return 1;
+        }
+        image.LoadSyms(commetII_env.mem);
+        image.GetDbgInfos(all_dbg_infos);
+        used = image.GetUsed();
+        start = image.GetStart();
+    } else {
+        Builder build{commetII_env};
+        build.SetCacheDir(cache_dir);
+        if (!build.Build(files, all_dbg_infos)) return 1;
+        used = commetII_env.mem.GetOffset();
+        start = build.GetStart();
 
-    ass::DbgInfos all_dbg_infos;
-    bool is_ok = build.Build(files, all_dbg_infos);
+        if (!emit_image.empty()) {
+            std::ofstream ofs(emit_image, std::ios::binary);
+            if (!ofs.is_open() ||
+                !cii::ExecImage::Save(ofs, commetII_env.mem, build.GetStart(), all_dbg_infos)) {
+                cmn::C << "実行イメージを書き込めません:" << emit_image << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+    }
 
-    if (!is_ok) return 1;
+    if (run) {
+        diag.Restore();
+        return RunHeadless(commetII_env.cii_cpu, start, max_steps, profile_file, commetII_env.mem.GetSyms());
+    }
 
     cmn::C << C_START << "Casl Debugger 1.0\n"
            << "Debugger Starting...\n"
            << "Memory Word Size: " << commetII_env.mem.size << std::endl
-           << "Used Word Size: " << commetII_env.mem.GetOffset() << std::endl
+           << "Used Word Size: " << used << std::endl
            << C_RESET << std::endl;
 
     cii::Debugger debug(commetII_env.cii_cpu, all_dbg_infos, commetII_env.mem);
+    if (history_budget > 0) debug.StartHistory(history_budget);
+    if (!profile_file.empty()) debug.StartProfile();
     debug.Start();
+
+    // 終了時にコールスタックごとの実行命令数をflamegraphのfolded形式で書き込む
+    if (!profile_file.empty() && debug.GetProfiler() != nullptr) {
+        std::ofstream ofs(profile_file);
+        if (!ofs.is_open()) {
+            cmn::C << "プロファイルを書き込めません:" << profile_file << std::endl;
+            return 1;
+        }
+        debug.GetProfiler()->WriteFolded(ofs, commetII_env.mem.GetSyms());
+    }
     return 0;
 }
\ No newline at end of file
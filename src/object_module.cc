@@ -0,0 +1,212 @@
+#include "object_module.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string_view>
+
+#include "common.h"
+
+namespace cii {
+namespace {
+//! オブジェクトファイルの識別子
+constexpr char MAGIC[4] = {'C', 'I', 'I', 'O'};
+//! オブジェクトファイルの形式のバージョン。形式を変えたら上げる
+constexpr uint32_t VERSION = 3;
+
+/**
+ * @brief 整数を可変長(7ビットずつ)で書き込む
+ */
+void PutVar(std::ostream &os, uint32_t v) {
+    while (v >= 0x80) {
+        os.put((char)(v | 0x80));
+        v >>= 7;
+    }
+    os.put((char)v);
+}
+void PutString(std::ostream &os, std::string_view s) {
+    PutVar(os, (uint32_t)s.size());
+    os.write(s.data(), s.size());
+}
+void PutSyms(std::ostream &os, const std::vector<SymValue> &syms) {
+    PutVar(os, (uint32_t)syms.size());
+    for (auto &sym : syms) {
+        PutString(os, sym.first);
+        PutVar(os, sym.second);
+    }
+}
+
+bool GetVar(std::istream &is, uint32_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = is.get();
+        if (c == EOF) return false;
+        v |= (uint32_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) return true;
+    }
+    return false;
+}
+bool GetVar(std::istream &is, uint16_t &v) {
+    uint32_t v32;
+    if (!GetVar(is, v32)) return false;
+    v = (uint16_t)v32;
+    return true;
+}
+/**
+ * @brief ストリームの残りのバイト数を返す
+ * @note
+ * 読み込んだ長さの検査に使う。位置を取得できないストリームは0を返す(長さが1以上のときは壊れたファイルとして扱う)
+ */
+uint64_t Remaining(std::istream &is) {
+    std::streampos pos = is.tellg();
+    if (pos < 0) return 0;
+    is.seekg(0, std::ios::end);
+    std::streampos end = is.tellg();
+    is.seekg(pos);
+    return end > pos ? (uint64_t)(end - pos) : 0;
+}
+/**
+ * @brief 要素数の上限を超えない長さを読み込む
+ * @param limit 要素数の上限(各要素は1バイト以上のため、ファイルの残りのバイト数)
+ */
+bool GetSize(std::istream &is, uint64_t limit, uint32_t &size) { return GetVar(is, size) && size <= limit; }
+bool GetString(std::istream &is, uint64_t limit, std::string &s) {
+    uint32_t size;
+    if (!GetSize(is, limit, size)) return false;
+    s.resize(size);
+    return (bool)is.read(s.data(), size);
+}
+bool GetSyms(std::istream &is, uint64_t limit, std::vector<SymValue> &syms) {
+    uint32_t size;
+    if (!GetSize(is, limit, size)) return false;
+    syms.resize(size);
+    for (auto &sym : syms) {
+        if (!GetString(is, limit, sym.first) || !GetVar(is, sym.second)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief デバッグ情報の各行がソースの各行(std::getlineで分けた行)と一致するかどうか
+ */
+bool SameLines(std::string_view source, const ass::LineTable &dbg_infos) {
+    uint32_t i = 0;
+    size_t pos = 0;
+    while (pos < source.size()) {
+        size_t end = source.find('\n', pos);
+        if (end == std::string_view::npos) end = source.size();
+        if (i >= dbg_infos.Size() || dbg_infos.Text(i) != source.substr(pos, end - pos)) return false;
+        i++;
+        pos = end + 1;
+    }
+    return i == dbg_infos.Size();
+}
+
+/**
+ * @brief FNV-1a 64ビットハッシュ
+ */
+uint64_t Hash(const std::string &s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+}  // namespace
+
+bool ObjectModule::Save(std::ostream &os) const {
+    os.write(MAGIC, sizeof(MAGIC));
+    PutVar(os, VERSION);
+    os.put((char)((is_error ? 1 : 0) | (overflow ? 2 : 0)));
+    PutVar(os, source_size);
+
+    PutVar(os, (uint32_t)words.size());
+    for (uint16_t w : words) PutVar(os, w);
+    PutSyms(os, locals);
+    PutSyms(os, externs);
+    PutSyms(os, refs);
+    PutSyms(os, consts);
+
+    // 行のオフセットは直前の行の終わりからの差分にする
+    PutVar(os, dbg_infos.Size());
+    uint16_t pre_end = 0;
+    for (uint32_t i = 0; i < dbg_infos.Size(); i++) {
+        PutString(os, dbg_infos.Text(i));
+        os.put((char)dbg_infos.Err(i));
+        PutVar(os, (uint16_t)(dbg_infos.StartOffset(i) - pre_end));
+        PutVar(os, (uint16_t)(dbg_infos.EndOffset(i) - dbg_infos.StartOffset(i)));
+        pre_end = dbg_infos.EndOffset(i);
+    }
+    return (bool)os;
+}
+
+bool ObjectModule::Load(std::istream &is) {
+    char magic[sizeof(MAGIC)];
+    uint32_t version;
+    if (!is.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), MAGIC)) return false;
+    if (!GetVar(is, version) || version != VERSION) return false;
+    int flags = is.get();
+    if (flags == EOF) return false;
+    is_error = (flags & 1) != 0;
+    overflow = (flags & 2) != 0;
+    if (!GetVar(is, source_size)) return false;
+
+    // 壊れたファイルの長さで大きな領域を確保しないように、長さはファイルの残りのバイト数以下に限る
+    uint64_t limit = Remaining(is);
+    uint32_t size;
+    if (!GetSize(is, limit, size)) return false;
+    words.resize(size);
+    for (auto &w : words) {
+        if (!GetVar(is, w)) return false;
+    }
+    if (!GetSyms(is, limit, locals) || !GetSyms(is, limit, externs) || !GetSyms(is, limit, refs) ||
+        !GetSyms(is, limit, consts)) {
+        return false;
+    }
+
+    if (!GetSize(is, limit, size)) return false;
+    dbg_infos.Clear();
+    uint16_t pre_end = 0;
+    std::string line;
+    for (uint32_t i = 0; i < size; i++) {
+        uint16_t start;
+        uint16_t len;
+        int err;
+        if (!GetString(is, limit, line) || (err = is.get()) == EOF || !GetVar(is, start) || !GetVar(is, len)) return false;
+        uint16_t start_offset = pre_end + start;
+        pre_end = start_offset + len;
+        dbg_infos.Add(line, (ass::AsmErrCode)err, start_offset, pre_end);
+    }
+    return true;
+}
+
+std::string ObjectCache::GetPath(const std::string &source) const {
+    return (std::filesystem::path(dir) / cmn::Format("%016llx.cobj", (unsigned long long)Hash(source))).string();
+}
+
+bool ObjectCache::Load(const std::string &source, ObjectModule &module) const {
+    std::ifstream ifs(GetPath(source), std::ios::binary);
+    if (!ifs.is_open() || !module.Load(ifs)) return false;
+    // ファイル名のハッシュ値が同じ別のソースのモジュールは使わない
+    return module.source_size == source.size() && SameLines(source, module.dbg_infos);
+}
+
+bool ObjectCache::Save(const std::string &source, const ObjectModule &module) const {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    std::string path = GetPath(source);
+    std::string tmp = path + cmn::Format(".%08x.tmp", std::random_device{}());
+    {
+        std::ofstream ofs(tmp, std::ios::binary);
+        if (!ofs.is_open() || !module.Save(ofs)) return false;
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (!ec) return true;
+
+    std::filesystem::remove(tmp, ec);
+    return false;
+}
+
+}  // namespace cii
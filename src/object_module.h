@@ -0,0 +1,81 @@
+#ifndef OBJECT_MODULE_H_
+#define OBJECT_MODULE_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "assem_mem.h"
+#include "assembler.h"
+
+namespace cii {
+
+/**
+ * @brief 再配置可能なオブジェクトモジュール
+ * @note
+ * 1ファイルを0番地からアセンブルした結果。AssmMem::Appendで出力位置に再配置してリンクする。
+ */
+struct ObjectModule {
+    std::vector<uint16_t> words;    //!< コード(0番地から)
+    std::vector<SymValue> locals;   //!< ローカルシンボルの定義(定義順)
+    std::vector<SymValue> externs;  //!< STARTのシンボルの定義(定義順)
+    std::vector<SymValue> refs;     //!< シンボル参照(再配置表)
+    std::vector<SymValue> consts;   //!< リテラル(=定数)のシンボルと値
+    ass::LineTable dbg_infos;       //!< デバッグ情報
+    bool is_error = false;          //!< アセンブルエラーがある
+    bool overflow = false;          //!< メモリサイズを超えた
+    uint32_t source_size = 0;       //!< ソースのバイト数(キャッシュのソースとの照合に使う)
+
+    /**
+     * @brief オブジェクトファイルに書き込む
+     * @param os 出力先(バイナリ)
+     * @return true 成功
+     */
+    bool Save(std::ostream &os) const;
+    /**
+     * @brief オブジェクトファイルから読み込む
+     * @param is 入力元(バイナリ)
+     * @return false 形式が違う、またはバージョンが違う
+     */
+    bool Load(std::istream &is);
+};
+
+/**
+ * @class
+ * オブジェクトモジュールのキャッシュ
+ * @note
+ * ソースの内容のハッシュ値をファイル名にしてディレクトリに保存する。
+ * 内容が変わらないソースはReader、Assemblerを通さずにオブジェクトモジュールを読み込む。
+ * ハッシュ値は衝突しうるため、読み込んだモジュールのソースのバイト数とデバッグ情報の各行をソースと照合する。
+ */
+class ObjectCache {
+    std::string dir;  //!< キャッシュディレクトリ
+
+   public:
+    explicit ObjectCache(std::string dir) : dir(std::move(dir)) {}
+
+    /**
+     * @brief キャッシュからオブジェクトモジュールを読み込む
+     * @param source ソースの内容
+     * @param module オブジェクトモジュール
+     * @return false キャッシュにない、またはキャッシュのモジュールが別のソースのもの
+     */
+    bool Load(const std::string &source, ObjectModule &module) const;
+    /**
+     * @brief オブジェクトモジュールをキャッシュに保存する
+     * @param source ソースの内容
+     * @param module オブジェクトモジュール
+     * @return true 成功
+     * @note
+     * 一時ファイルに書き込んでから名前を変えるため、複数のプロセスから同時に保存してよい
+     */
+    bool Save(const std::string &source, const ObjectModule &module) const;
+    /**
+     * @brief ソースのキャッシュファイル名
+     */
+    std::string GetPath(const std::string &source) const;
+};
+
+}  // namespace cii
+#endif
@@ -0,0 +1,72 @@
+#include "page_array.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define CII_MMAP 1
+#endif
+
+namespace cmn {
+
+void *AllocPages(size_t bytes) {
+    if (bytes == 0) return nullptr;
+#if defined(_WIN32)
+    void *p = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (p == nullptr) throw std::bad_alloc();
+#elif defined(CII_MMAP)
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+#else
+    void *p = std::calloc(1, bytes);
+    if (p == nullptr) throw std::bad_alloc();
+#endif
+    return p;
+}
+
+void FreePages(void *p, size_t bytes) {
+    if (p == nullptr) return;
+#if defined(_WIN32)
+    VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(CII_MMAP)
+    munmap(p, bytes);
+#else
+    std::free(p);
+#endif
+}
+
+void ClearPages(void *p, size_t bytes) {
+    if (p == nullptr) return;
+#if defined(__linux__)
+    // 匿名マッピングのページは次のアクセスで0のページになる
+    if (madvise(p, bytes, MADV_DONTNEED) == 0) return;
+#endif
+    std::memset(p, 0, bytes);
+}
+
+void ClearRange(void *p, size_t bytes) {
+    uint8_t *begin = static_cast<uint8_t *>(p);
+    uint8_t *end = begin + bytes;
+#if defined(__linux__)
+    static const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t top = (reinterpret_cast<uintptr_t>(begin) + page_size - 1) & ~(page_size - 1);
+    uint8_t *page_begin = reinterpret_cast<uint8_t *>(top);
+    uint8_t *page_end = reinterpret_cast<uint8_t *>(reinterpret_cast<uintptr_t>(end) & ~(page_size - 1));
+    if (page_begin < page_end && madvise(page_begin, page_end - page_begin, MADV_DONTNEED) == 0) {
+        std::memset(begin, 0, page_begin - begin);
+        std::memset(page_end, 0, end - page_end);
+        return;
+    }
+#endif
+    for (uint8_t *b = begin; b < end; b++) {
+        if (*b != 0) *b = 0;
+    }
+}
+
+}  // namespace cmn
@@ -0,0 +1,94 @@
+#ifndef PAGE_ARRAY_H_
+#define PAGE_ARRAY_H_
+
+#include <cstddef>
+#include <type_traits>
+
+namespace cmn {
+
+/**
+ * @brief 0で初期化したメモリを確保する
+ * @param bytes バイト数
+ * @return void* 確保したメモリ
+ * @note
+ * 物理ページは最初にアクセスしたときに割り当てられる(対応していない環境では一括で確保する)
+ */
+void *AllocPages(size_t bytes);
+/**
+ * @brief AllocPagesで確保したメモリを解放する
+ * @param p メモリ
+ * @param bytes バイト数
+ */
+void FreePages(void *p, size_t bytes);
+/**
+ * @brief AllocPagesで確保したメモリを0に戻す
+ * @param p メモリ
+ * @param bytes バイト数
+ * @note
+ * 対応している環境では、書き込まずに物理ページを解放する
+ */
+void ClearPages(void *p, size_t bytes);
+/**
+ * @brief AllocPagesで確保したメモリの一部を0に戻す
+ * @param p 先頭(ページ境界でなくてよい)
+ * @param bytes バイト数
+ * @note
+ * 対応している環境では、範囲に含まれるページは書き込まずに物理ページを解放し、前後の端数だけを書き込む。
+ * 対応していない環境では0でないバイトだけを書き込む(物理ページを割り当てていないページには触れない)
+ */
+void ClearRange(void *p, size_t bytes);
+
+/**
+ * @class
+ * ページ単位で遅延確保される0初期化済み配列
+ * @note
+ * Tはすべてのバイトが0の状態を初期値とする型に限る
+ */
+template <class T>
+class PageArray {
+    static_assert(std::is_trivially_destructible<T>::value, "PageArray requires a trivially destructible type");
+
+    T *ptr = nullptr;  //!< 配列
+    size_t n = 0;      //!< 要素数
+
+   public:
+    PageArray() = default;
+    explicit PageArray(size_t n) : ptr(static_cast<T *>(AllocPages(n * sizeof(T)))), n(n) {}
+    ~PageArray() {
+        if (ptr != nullptr) FreePages(ptr, n * sizeof(T));
+    }
+    PageArray(const PageArray &) = delete;
+    PageArray &operator=(const PageArray &) = delete;
+    PageArray(PageArray &&other) noexcept : ptr(other.ptr), n(other.n) {
+        other.ptr = nullptr;
+        other.n = 0;
+    }
+    PageArray &operator=(PageArray &&other) noexcept {
+        if (this != &other) {
+            if (ptr != nullptr) FreePages(ptr, n * sizeof(T));
+            ptr = other.ptr;
+            n = other.n;
+            other.ptr = nullptr;
+            other.n = 0;
+        }
+        return *this;
+    }
+
+    T &operator[](size_t i) { return ptr[i]; }
+    const T &operator[](size_t i) const { return ptr[i]; }
+    T *data() { return ptr; }
+    const T *data() const { return ptr; }
+    size_t size() const { return n; }
+    T *begin() { return ptr; }
+    T *end() { return ptr + n; }
+    const T *begin() const { return ptr; }
+    const T *end() const { return ptr + n; }
+    /**
+     * @brief すべての要素を0に戻す
+     */
+    void Clear() { ClearPages(ptr, n * sizeof(T)); }
+};
+
+}  // namespace cmn
+
+#endif
@@ -0,0 +1,205 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <string>
+
+#include "common.h"
+
+namespace cii {
+namespace {
+/**
+ * @brief アドレスからシンボル名を引く表を作成する
+ * @note
+ * 同じアドレスのシンボルは最初のものにする。リテラル(=定数)は使用しない
+ */
+std::unordered_map<uint16_t, std::string> SymNames(const std::vector<SymValue> &syms) {
+    std::unordered_map<uint16_t, std::string> names;
+    for (auto &sym : syms) {
+        if (!sym.first.empty() && sym.first[0] != '=') names.emplace(sym.second, sym.first);
+    }
+    return names;
+}
+
+std::string AdrName(const std::unordered_map<uint16_t, std::string> &names, uint16_t adr) {
+    auto itr = names.find(adr);
+    return itr != names.end() ? itr->second : cmn::Format("#%04x", adr);
+}
+
+double Percent(uint64_t count, uint64_t total) { return total == 0 ? 0 : count * 100.0 / total; }
+}  // namespace
+
+Profiler::Profiler(uint32_t mem_size) : steps(0), counts(mem_size), taken(mem_size), not_taken(mem_size), op_counts{} {}
+
+void Profiler::Clear() {
+    steps = 0;
+    counts.Clear();
+    taken.Clear();
+    not_taken.Clear();
+    op_counts.fill(0);
+    funcs.clear();
+    nodes.clear();
+    children.clear();
+    frames.clear();
+}
+
+uint32_t Profiler::Child(uint32_t parent, uint16_t func) {
+    uint64_t key = ((uint64_t)parent << 16) | func;
+    auto [itr, inserted] = children.emplace(key, (uint32_t)nodes.size());
+    if (inserted) nodes.push_back({func, parent, 0});
+    return itr->second;
+}
+
+void Profiler::Enter(uint16_t func) {
+    FuncCount &f = funcs[func];
+    f.calls++;
+    f.depth++;
+    frames.push_back({Child(frames.back().node, func), steps});
+}
+
+void Profiler::Leave() {
+    // 根からのRETは呼び出し元がないため記録しない
+    if (frames.size() <= 1) return;
+
+    const Frame &frame = frames.back();
+    FuncCount &f = funcs[nodes[frame.node].func];
+    if (--f.depth == 0) f.inclusive += steps - frame.entry;
+    frames.pop_back();
+}
+
+void Profiler::EndRun() {
+    while (frames.size() > 1) Leave();
+    frames.clear();
+}
+
+void Profiler::Merge(const Profiler &other) {
+    steps += other.steps;
+    size_t n = std::min(counts.size(), other.counts.size());
+    for (size_t adr = 0; adr < n; adr++) {
+        // 実行していないアドレスには書き込まない(ページを割り当てないため)
+        if (other.counts[adr] != 0) counts[adr] += other.counts[adr];
+        if (other.taken[adr] != 0) taken[adr] += other.taken[adr];
+        if (other.not_taken[adr] != 0) not_taken[adr] += other.not_taken[adr];
+    }
+    for (size_t i = 0; i < op_counts.size(); i++) op_counts[i] += other.op_counts[i];
+
+    for (auto &func : other.GetFuncs()) {
+        FuncCount &f = funcs[func.adr];
+        f.calls += func.calls;
+        f.inclusive += func.inclusive;
+    }
+    // 親は子より前にあるため、先頭から順に対応するノードを引ける
+    std::vector<uint32_t> node_map(other.nodes.size());
+    for (size_t i = 0; i < other.nodes.size(); i++) {
+        const Node &node = other.nodes[i];
+        node_map[i] = Child(node.parent == NO_NODE ? NO_NODE : node_map[node.parent], node.func);
+        nodes[node_map[i]].self += node.self;
+    }
+}
+
+std::vector<Profiler::FuncStat> Profiler::GetFuncs() const {
+    std::unordered_map<uint16_t, FuncStat> stats;
+    for (auto &[adr, f] : funcs) stats[adr] = {adr, f.calls, f.inclusive};
+    // 戻っていない呼び出しは、一番外側の呼び出しから現在までを数える
+    std::vector<uint16_t> active;
+    for (size_t i = 1; i < frames.size(); i++) {
+        uint16_t func = nodes[frames[i].node].func;
+        if (std::find(active.begin(), active.end(), func) != active.end()) continue;
+        active.push_back(func);
+        stats[func].inclusive += steps - frames[i].entry;
+    }
+
+    std::vector<FuncStat> result;
+    result.reserve(stats.size());
+    for (auto &stat : stats) result.push_back(stat.second);
+    std::sort(result.begin(), result.end(), [](const FuncStat &a, const FuncStat &b) {
+        return a.inclusive != b.inclusive ? a.inclusive > b.inclusive : a.adr < b.adr;
+    });
+    return result;
+}
+
+std::vector<Profiler::LineStat> Profiler::GetHotLines(const ass::LineTable &dbg_infos, size_t top) const {
+    std::vector<LineStat> lines;
+    for (uint32_t i = 0; i < dbg_infos.Size(); i++) {
+        uint64_t count = 0;
+        for (uint32_t adr = dbg_infos.StartOffset(i); adr < dbg_infos.EndOffset(i) && adr < counts.size(); adr++) {
+            count += counts[adr];
+        }
+        if (count > 0) lines.push_back({i, count});
+    }
+    auto last = lines.begin() + std::min(top, lines.size());
+    std::partial_sort(lines.begin(), last, lines.end(), [](const LineStat &a, const LineStat &b) {
+        return a.count != b.count ? a.count > b.count : a.line < b.line;
+    });
+    lines.erase(last, lines.end());
+    return lines;
+}
+
+void Profiler::Report(std::ostream &os, const ass::LineTable &dbg_infos, const std::vector<SymValue> &syms,
+                      size_t top) const {
+    auto names = SymNames(syms);
+    auto line_name = [&](uint32_t i) {
+        const std::string &file = dbg_infos.FileName(dbg_infos.FileId(i));
+        return cmn::Format("%s:%u", file.c_str(), dbg_infos.LineNo(i));
+    };
+
+    os << "steps: " << steps << "\n";
+
+    os << "hot lines:\n";
+    for (auto &line : GetHotLines(dbg_infos, top)) {
+        os << cmn::Format("  %12llu %6.2f%%  %04x  %-16s ", (unsigned long long)line.count,
+                          Percent(line.count, steps), dbg_infos.StartOffset(line.line), line_name(line.line).c_str())
+           << dbg_infos.Text(line.line) << "\n";
+    }
+
+    os << "opcodes:\n";
+    std::vector<std::pair<uint64_t, int>> ops;
+    for (int op = 0; op < (int)op_counts.size(); op++) {
+        if (op_counts[op] > 0) ops.emplace_back(op_counts[op], op);
+    }
+    std::sort(ops.begin(), ops.end(),
+              [](auto &a, auto &b) { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+    for (auto &[count, op] : ops) {
+        const char *name = GetOpName(static_cast<OpCode>(op));
+        os << cmn::Format("  %12llu %6.2f%%  %s\n", (unsigned long long)count, Percent(count, steps),
+                          name != nullptr ? name : cmn::Format("#%02x", op).c_str());
+    }
+
+    os << "branches:          taken    not taken\n";
+    std::vector<uint16_t> branches;
+    for (uint32_t adr = 0; adr < counts.size(); adr++) {
+        if (taken[adr] + not_taken[adr] > 0) branches.push_back((uint16_t)adr);
+    }
+    auto total = [this](uint16_t adr) { return taken[adr] + not_taken[adr]; };
+    std::sort(branches.begin(), branches.end(), [&](uint16_t a, uint16_t b) {
+        return total(a) != total(b) ? total(a) > total(b) : a < b;
+    });
+    if (branches.size() > top) branches.resize(top);
+    for (uint16_t adr : branches) {
+        os << cmn::Format("  %04x  %12llu %12llu", adr, (unsigned long long)taken[adr],
+                          (unsigned long long)not_taken[adr]);
+        if (uint32_t i = dbg_infos.FindLine(adr); i != ass::LineTable::NO_LINE) os << "  " << line_name(i);
+        os << "\n";
+    }
+
+    os << "calls:             calls    inclusive\n";
+    std::vector<FuncStat> stats = GetFuncs();
+    if (stats.size() > top) stats.resize(top);
+    for (auto &stat : stats) {
+        os << cmn::Format("  %04x  %12llu %12llu %6.2f%%  %s\n", stat.adr, (unsigned long long)stat.calls,
+                          (unsigned long long)stat.inclusive, Percent(stat.inclusive, steps),
+                          AdrName(names, stat.adr).c_str());
+    }
+}
+
+void Profiler::WriteFolded(std::ostream &os, const std::vector<SymValue> &syms) const {
+    auto names = SymNames(syms);
+    // 親は子より前にあるため、先頭から順に経路の名前を作成できる
+    std::vector<std::string> paths(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const Node &node = nodes[i];
+        paths[i] = (node.parent == NO_NODE ? "" : paths[node.parent] + ";") + AdrName(names, node.func);
+        if (node.self > 0) os << paths[i] << " " << node.self << "\n";
+    }
+}
+
+}  // namespace cii
@@ -0,0 +1,182 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "assem_mem.h"
+#include "comet_ii.h"
+#include "line_table.h"
+#include "page_array.h"
+
+namespace cii {
+
+/**
+ * @class
+ * 実行プロファイラ
+ * @note
+ * CometII::SetProfilerで設定すると、命令を実行するたびにRecordが呼ばれる。
+ * アドレスごと、命令コードごとの実行回数、分岐ごとの成立回数、CALL先ごとの呼び出し回数と包含ステップ数、
+ * コールスタックごとの実行命令数を数える。
+ * コールスタックはCALLとRETで追跡するため、スタックを直接書き換えて戻るプログラムでは正確でない。
+ */
+class Profiler {
+   public:
+    /**
+     * @brief CALL先ごとの統計
+     */
+    struct FuncStat {
+        uint16_t adr;        //!< CALL先のアドレス
+        uint64_t calls;      //!< 呼び出し回数
+        uint64_t inclusive;  //!< 呼び出しからRETまでの命令数(再帰呼び出しは一番外側だけ数える)
+    };
+    /**
+     * @brief 行ごとの実行回数
+     */
+    struct LineStat {
+        uint32_t line;   //!< 行
+        uint64_t count;  //!< 行の命令を実行した回数
+    };
+
+    //! Reportで表示する行数の既定値
+    static constexpr size_t DEFAULT_TOP = 10;
+
+    /**
+     * @brief Construct a new Profiler object
+     *
+     * @param mem_size メモリワードサイズ
+     */
+    explicit Profiler(uint32_t mem_size);
+    /**
+     * @brief 記録をすべて消す
+     */
+    void Clear();
+
+    /**
+     * @brief 実行した命令を記録する
+     * @param adr 命令のアドレス
+     * @param op_code 命令コード
+     * @param len 命令語長
+     * @param next_pr 実行後のPR
+     * @param ok 命令が停止要因なしで終わった(falseのときは分岐、CALL、RETを記録しない)
+     */
+    inline void Record(uint16_t adr, OpCode op_code, uint8_t len, uint16_t next_pr, bool ok) {
+        steps++;
+        counts[adr]++;
+        op_counts[static_cast<uint8_t>(op_code)]++;
+        // 最初の命令を記録したときに、そのアドレスをコールスタックの根にする
+        if (frames.empty()) frames.push_back({Child(NO_NODE, adr), steps - 1});
+        nodes[frames.back().node].self++;
+        if (!ok) return;
+
+        if (op_code >= OpCode::JPL && op_code <= OpCode::JOV) {
+            if (next_pr != (uint16_t)(adr + len))
+                taken[adr]++;
+            else
+                not_taken[adr]++;
+        } else if (op_code == OpCode::CALL) {
+            Enter(next_pr);
+        } else if (op_code == OpCode::RET) {
+            Leave();
+        }
+    }
+    /**
+     * @brief 1回の実行の記録を終える
+     * @note
+     * 戻っていない呼び出しを現在の命令数で閉じ、次に記録する命令を新しいコールスタックの根にする。
+     * 1つのプロファイラで複数回の実行を合計するときに、実行の間に呼び出す
+     */
+    void EndRun();
+    /**
+     * @brief 別のプロファイラの記録を足し込む
+     * @note
+     * コールスタックは呼び出し経路が同じものをまとめる
+     */
+    void Merge(const Profiler &other);
+
+    uint64_t GetSteps() const { return steps; }
+    uint64_t GetCount(uint16_t adr) const { return adr < counts.size() ? counts[adr] : 0; }
+    uint64_t GetOpCount(OpCode op_code) const { return op_counts[static_cast<uint8_t>(op_code)]; }
+    uint64_t GetTaken(uint16_t adr) const { return adr < taken.size() ? taken[adr] : 0; }
+    uint64_t GetNotTaken(uint16_t adr) const { return adr < not_taken.size() ? not_taken[adr] : 0; }
+    /**
+     * @brief CALL先ごとの統計を取得する
+     * @return std::vector<FuncStat> 包含ステップ数の多い順。戻っていない呼び出しは現在までの命令数を含める
+     */
+    std::vector<FuncStat> GetFuncs() const;
+    /**
+     * @brief 実行回数の多い行を取得する
+     * @param dbg_infos デバッグ情報
+     * @param top 取得する行数
+     * @return std::vector<LineStat> 実行回数の多い順(実行していない行は含まない)
+     */
+    std::vector<LineStat> GetHotLines(const ass::LineTable &dbg_infos, size_t top) const;
+
+    /**
+     * @brief 実行回数の多い行、命令、分岐、CALL先を表示する
+     * @param os 出力先
+     * @param dbg_infos デバッグ情報
+     * @param syms アドレスの名前にするシンボル
+     * @param top 行、分岐、CALL先ごとに表示する数
+     */
+    void Report(std::ostream &os, const ass::LineTable &dbg_infos, const std::vector<SymValue> &syms,
+                size_t top = DEFAULT_TOP) const;
+    /**
+     * @brief コールスタックごとの実行命令数をflamegraphのfolded形式で出力する
+     * @param os 出力先
+     * @param syms 関数の名前にするシンボル。シンボルがないアドレスは"#xxxx"にする
+     * @note
+     * 1行に"根;呼び出し先;... 命令数"を出力する
+     */
+    void WriteFolded(std::ostream &os, const std::vector<SymValue> &syms) const;
+
+   private:
+    static constexpr uint32_t NO_NODE = UINT32_MAX;  //!< 親なし(根)
+
+    /**
+     * @brief 呼び出し経路の木のノード
+     */
+    struct Node {
+        uint16_t func;    //!< 関数のアドレス
+        uint32_t parent;  //!< 親(呼び出し元)のノード
+        uint64_t self;    //!< この経路で実行した命令数(呼び出し先を含まない)
+    };
+    /**
+     * @brief 呼び出し中の関数
+     */
+    struct Frame {
+        uint32_t node;   //!< 経路のノード
+        uint64_t entry;  //!< 呼び出したときの命令数
+    };
+    /**
+     * @brief CALL先ごとの集計
+     */
+    struct FuncCount {
+        uint64_t calls;      //!< 呼び出し回数
+        uint64_t inclusive;  //!< 戻った呼び出しの包含ステップ数
+        uint32_t depth;      //!< 呼び出し中の数
+    };
+
+    uint64_t steps;                                   //!< 記録した命令数
+    cmn::PageArray<uint64_t> counts;                  //!< アドレスごとの実行回数
+    cmn::PageArray<uint64_t> taken;                   //!< アドレスごとの分岐成立回数
+    cmn::PageArray<uint64_t> not_taken;               //!< アドレスごとの分岐不成立回数
+    std::array<uint64_t, 256> op_counts;              //!< 命令コードごとの実行回数
+    std::unordered_map<uint16_t, FuncCount> funcs;    //!< CALL先ごとの集計
+    std::vector<Node> nodes;                          //!< 呼び出し経路の木(親は子より前)
+    std::unordered_map<uint64_t, uint32_t> children;  //!< (親のノード, 関数)から子のノード
+    std::vector<Frame> frames;                        //!< コールスタック(先頭は根)
+
+    /**
+     * @brief 子のノードを取得する。ないときは追加する
+     */
+    uint32_t Child(uint32_t parent, uint16_t func);
+    void Enter(uint16_t func);
+    void Leave();
+};
+
+}  // namespace cii
+#endif
@@ -0,0 +1,30 @@
+#include "program_image.h"
+
+#include <algorithm>
+
+#include "page_array.h"
+
+namespace cii {
+
+ProgramImage::ProgramImage(const Memory &mem, uint32_t used, uint16_t start, ass::LineTable dbg_infos,
+                           std::vector<SymValue> syms)
+    : words(mem.memory, mem.memory + used), start(start), dbg_infos(std::move(dbg_infos)), syms(std::move(syms)) {}
+
+bool ProgramImage::Load(Memory &mem) const {
+    if (mem.size < words.size()) return false;
+
+    std::copy(words.begin(), words.end(), mem.memory);
+    // 使用領域以降は、前の実行で書き込んだページだけを0に戻す(メモリワードサイズに比例する走査をしない)
+    cmn::ClearRange(mem.memory + words.size(), (mem.size - words.size()) * sizeof(WordData));
+    return true;
+}
+
+bool ProgramImage::Fork(CometII &cpu) const {
+    if (!Load(cpu.GetMemory())) return false;
+
+    cpu.Reset();
+    cpu.PR = start;
+    return true;
+}
+
+}  // namespace cii
@@ -0,0 +1,60 @@
+#ifndef PROGRAM_IMAGE_H_
+#define PROGRAM_IMAGE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "assem_mem.h"
+#include "assembler.h"
+#include "comet_ii.h"
+
+namespace cii {
+
+/**
+ * @class
+ * ビルド済みのプログラムイメージ
+ * @note
+ * 作成後は変更しない。複数のCometIIで同時にForkしてよい。
+ */
+class ProgramImage {
+    std::vector<WordData> words;  //!< 使用領域のメモリ内容
+    uint16_t start;               //!< 実行開始アドレス
+    ass::LineTable dbg_infos;     //!< デバッグ情報
+    std::vector<SymValue> syms;   //!< シンボル
+
+   public:
+    /**
+     * @brief Construct a new Program Image object
+     *
+     * @param mem ビルド後のメモリ
+     * @param used 使用しているワード数
+     * @param start 実行開始アドレス
+     * @param dbg_infos デバッグ情報
+     * @param syms シンボル(プロファイルの表示に使う)
+     */
+    ProgramImage(const Memory &mem, uint32_t used, uint16_t start, ass::LineTable dbg_infos,
+                 std::vector<SymValue> syms = {});
+
+    /**
+     * @brief イメージをメモリに展開する
+     * @param mem 展開先のメモリ。使用領域以降は0にする
+     * @return true 成功
+     * @return false メモリサイズが足りない
+     */
+    bool Load(Memory &mem) const;
+    /**
+     * @brief イメージをCometIIのメモリに展開し、実行開始アドレスから実行できる状態にする
+     * @param cpu CometII
+     * @return true 成功
+     * @return false メモリサイズが足りない
+     */
+    bool Fork(CometII &cpu) const;
+
+    uint16_t GetStart() const { return start; }
+    uint32_t GetUsed() const { return (uint32_t)words.size(); }
+    const ass::LineTable &GetDbgInfos() const { return dbg_infos; }
+    const std::vector<SymValue> &GetSyms() const { return syms; }
+};
+
+}  // namespace cii
+#endif
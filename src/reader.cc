@@ -1,86 +1,206 @@
 
 #include "reader.h"
 
-#include <iostream>
+#include <algorithm>
+#include <array>
 #include <map>
-#include <regex>
 #include <string>
+#include <string_view>
 
 namespace ass {
 
-std::map<std::string, TokenInfo> Reader::key_words = {
-    {"GR0", TokenInfo(TokenId::GR0)},
-    {"GR1", TokenInfo(TokenId::GR1)},
-    {"GR2", TokenInfo(TokenId::GR2)},
-    {"GR3", TokenInfo(TokenId::GR3)},
-    {"GR4", TokenInfo(TokenId::GR4)},
-    {"GR5", TokenInfo(TokenId::GR5)},
-    {"GR6", TokenInfo(TokenId::GR6)},
-    {"GR7", TokenInfo(TokenId::GR7)},
-    {"ST", TokenInfo(TokenId::ST, REG_EADR)},
-    {"LD", TokenInfo(TokenId::LD, REG_REGorMEM)},
-    {"LAD", TokenInfo(TokenId::LAD, REG_EADR)},
-    {"ADDA", TokenInfo(TokenId::ADDA, REG_REGorMEM)},
-    {"ADDL", TokenInfo(TokenId::ADDL, REG_REGorMEM)},
-    {"SUBA", TokenInfo(TokenId::SUBA, REG_REGorMEM)},
-    {"SUBL", TokenInfo(TokenId::SUBL, REG_REGorMEM)},
-    {"AND", TokenInfo(TokenId::AND, REG_REGorMEM)},
-    {"OR", TokenInfo(TokenId::OR, REG_REGorMEM)},
-    {"XOR", TokenInfo(TokenId::XOR, REG_REGorMEM)},
-    {"CPA", TokenInfo(TokenId::CPA, REG_REGorMEM)},
-    {"CPL", TokenInfo(TokenId::CPL, REG_REGorMEM)},
-    {"SLA", TokenInfo(TokenId::SLA, REG_EADR)},
-    {"SRA", TokenInfo(TokenId::SRA, REG_EADR)},
-    {"SLL", TokenInfo(TokenId::SLL, REG_EADR)},
-    {"SRL", TokenInfo(TokenId::SRL, REG_EADR)},
-    {"JPL", TokenInfo(TokenId::JPL, EADR)},
-    {"JMI", TokenInfo(TokenId::JMI, EADR)},
-    {"JNZ", TokenInfo(TokenId::JNZ, EADR)},
-    {"JZE", TokenInfo(TokenId::JZE, EADR)},
-    {"JOV", TokenInfo(TokenId::JOV, EADR)},
-    {"JUMP", TokenInfo(TokenId::JUMP, EADR)},
-    {"PUSH", TokenInfo(TokenId::PUSH, EADR)},
-    {"POP", TokenInfo(TokenId::POP, REG)},
-    {"CALL", TokenInfo(TokenId::CALL, EADR)},
-    {"RET", TokenInfo(TokenId::RET, NONE)},
-    {"CALL", TokenInfo(TokenId::CALL, EADR)},
-    {"SVC", TokenInfo(TokenId::SVC, EADR)},
-    {"NOP", TokenInfo(TokenId::NOP, NONE)},
-    {"HLT", TokenInfo(TokenId::HLT, NONE)},
-    {"START", TokenInfo(TokenId::START)},
-    {"END", TokenInfo(TokenId::END)},
-    {"DC", TokenInfo(TokenId::DC, DC_CONST)},
-    {"DS", TokenInfo(TokenId::DS, DS_CONST)},
-    {"IN", TokenInfo(TokenId::IN, ADR_ADR)},
-    {"OUT", TokenInfo(TokenId::OUT, ADR_ADR)},
-    {",", TokenInfo(TokenId::COMMA)},
-    {";", TokenInfo(TokenId::COMMENT)},
+namespace {
+/**
+ * @brief キーワードの定義
+ */
+struct KeyWordDef {
+    std::string_view name;     //!< キーワード
+    TokenId token_id;          //!< トークンID
+    OperandType operand_type;  //!< オペランドの種類
 };
 
-const Tokens& Reader::Parse(const std::string& line) {
+constexpr KeyWordDef KEY_WORD_DEFS[] = {
+    {"GR0", TokenId::GR0, NONE},
+    {"GR1", TokenId::GR1, NONE},
+    {"GR2", TokenId::GR2, NONE},
+    {"GR3", TokenId::GR3, NONE},
+    {"GR4", TokenId::GR4, NONE},
+    {"GR5", TokenId::GR5, NONE},
+    {"GR6", TokenId::GR6, NONE},
+    {"GR7", TokenId::GR7, NONE},
+    {"ST", TokenId::ST, REG_EADR},
+    {"LD", TokenId::LD, REG_REGorMEM},
+    {"LAD", TokenId::LAD, REG_EADR},
+    {"ADDA", TokenId::ADDA, REG_REGorMEM},
+    {"ADDL", TokenId::ADDL, REG_REGorMEM},
+    {"SUBA", TokenId::SUBA, REG_REGorMEM},
+    {"SUBL", TokenId::SUBL, REG_REGorMEM},
+    {"AND", TokenId::AND, REG_REGorMEM},
+    {"OR", TokenId::OR, REG_REGorMEM},
+    {"XOR", TokenId::XOR, REG_REGorMEM},
+    {"CPA", TokenId::CPA, REG_REGorMEM},
+    {"CPL", TokenId::CPL, REG_REGorMEM},
+    {"SLA", TokenId::SLA, REG_EADR},
+    {"SRA", TokenId::SRA, REG_EADR},
+    {"SLL", TokenId::SLL, REG_EADR},
+    {"SRL", TokenId::SRL, REG_EADR},
+    {"JPL", TokenId::JPL, EADR},
+    {"JMI", TokenId::JMI, EADR},
+    {"JNZ", TokenId::JNZ, EADR},
+    {"JZE", TokenId::JZE, EADR},
+    {"JOV", TokenId::JOV, EADR},
+    {"JUMP", TokenId::JUMP, EADR},
+    {"PUSH", TokenId::PUSH, EADR},
+    {"POP", TokenId::POP, REG},
+    {"CALL", TokenId::CALL, EADR},
+    {"RET", TokenId::RET, NONE},
+    {"SVC", TokenId::SVC, EADR},
+    {"NOP", TokenId::NOP, NONE},
+    {"HLT", TokenId::HLT, NONE},
+    {"START", TokenId::START, NONE},
+    {"END", TokenId::END, NONE},
+    {"DC", TokenId::DC, DC_CONST},
+    {"DS", TokenId::DS, DS_CONST},
+    {"IN", TokenId::IN, ADR_ADR},
+    {"OUT", TokenId::OUT, ADR_ADR},
+    {",", TokenId::COMMA, NONE},
+    {";", TokenId::COMMENT, NONE},
+};
+constexpr size_t KEY_WORD_NUM = sizeof(KEY_WORD_DEFS) / sizeof(KEY_WORD_DEFS[0]);
+constexpr size_t KEY_WORD_MAX_LEN = 5;
+
+//! キーワードのハッシュ表のサイズ
+constexpr size_t KEY_WORD_HASH_SIZE = 128;
+/**
+ * @brief キーワードのハッシュ値。KEY_WORD_DEFSに対して衝突しない(完全ハッシュ)
+ * @param s 空でない文字列
+ */
+constexpr size_t KeyWordHash(std::string_view s) {
+    size_t c0 = (unsigned char)s[0];
+    size_t c1 = s.size() > 1 ? (unsigned char)s[1] : 0;
+    size_t cl = (unsigned char)s[s.size() - 1];
+    return (c0 * 2 + c1 * 3 + cl * 6 + s.size()) % KEY_WORD_HASH_SIZE;
+}
+
+/**
+ * @brief ハッシュ値からKEY_WORD_DEFSの添字を引く表を作る
+ * @return 添字の表(-1:キーワードなし)。衝突したときは空の表
+ */
+constexpr std::array<int8_t, KEY_WORD_HASH_SIZE> MakeKeyWordSlots() {
+    std::array<int8_t, KEY_WORD_HASH_SIZE> slots{};
+    for (auto &slot : slots) slot = -1;
+    for (size_t i = 0; i < KEY_WORD_NUM; i++) {
+        size_t h = KeyWordHash(KEY_WORD_DEFS[i].name);
+        if (slots[h] != -1) return {};
+        slots[h] = (int8_t)i;
+    }
+    return slots;
+}
+constexpr std::array<int8_t, KEY_WORD_HASH_SIZE> KEY_WORD_SLOTS = MakeKeyWordSlots();
+static_assert(KEY_WORD_SLOTS[KeyWordHash(";")] == KEY_WORD_NUM - 1, "キーワードのハッシュ値が衝突しています");
+
+/**
+ * @brief キーワードを検索する
+ * @param s トークン
+ * @return const KeyWordDef* キーワードの定義、キーワードでないときはnullptr
+ */
+inline const KeyWordDef *FindKeyWord(std::string_view s) {
+    if (s.empty() || s.size() > KEY_WORD_MAX_LEN) return nullptr;
+    int8_t i = KEY_WORD_SLOTS[KeyWordHash(s)];
+    return (i >= 0 && KEY_WORD_DEFS[i].name == s) ? &KEY_WORD_DEFS[i] : nullptr;
+}
+
+//! std::regexの\sと同じ空白文字
+inline bool IsSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+inline bool IsAlpha(char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'); }
+inline bool IsDec(char c) { return c >= '0' && c <= '9'; }
+
+/**
+ * @brief 数値文字列を変換する
+ * @param s IsDigitまたはIsHex('#'を除く)を満たす文字列
+ * @param base 基数(10, 16)
+ * @return 16ビットに切り詰めた値
+ */
+uint16_t ToDigit(std::string_view s, uint32_t base) {
+    bool minus = s[0] == '-';
+    uint32_t value = 0;
+    for (size_t i = minus ? 1 : 0; i < s.size(); i++) {
+        char c = s[i];
+        value = value * base + (IsDec(c) ? c - '0' : c - 'A' + 10);
+    }
+    return (uint16_t)(minus ? 0 - value : value);
+}
+
+/**
+ * @brief 1行をトークンに区切る
+ * @note
+ * 正規表現 \s*([^,;'\s]+|,|;|')\s* と同じ区切り方をする。
+ * tokenはグループ1、matchは前後の空白を含むマッチ全体に相当する。
+ */
+class Lexer {
+    std::string_view line;
+    size_t pos = 0;
+
+    void SkipSpace() {
+        while (pos < line.size() && IsSpace(line[pos])) pos++;
+    }
+
+   public:
+    explicit Lexer(std::string_view line) : line(line) {}
+
+    bool Next(std::string_view &token, std::string_view &match) {
+        size_t match_top = pos;
+        SkipSpace();
+        if (pos >= line.size()) return false;
+
+        size_t top = pos;
+        char c = line[pos++];
+        if (c != ',' && c != ';' && c != '\'') {
+            while (pos < line.size()) {
+                c = line[pos];
+                if (c == ',' || c == ';' || c == '\'' || IsSpace(c)) break;
+                pos++;
+            }
+        }
+        token = line.substr(top, pos - top);
+        SkipSpace();
+        match = line.substr(match_top, pos - match_top);
+        return true;
+    }
+};
+}  // namespace
+
+std::map<std::string, TokenInfo> Reader::key_words = [] {
+    std::map<std::string, TokenInfo> key_words;
+    for (auto &def : KEY_WORD_DEFS) {
+        key_words.emplace(std::string(def.name), TokenInfo(def.token_id, def.operand_type));
+    }
+    return key_words;
+}();
+
+const Tokens& Reader::Parse(std::string_view line) {
     tokenes.clear();
     enum STRING_MODE { NONE, START, CONTINUE, END };
     STRING_MODE st_mode = NONE;
     std::string string_s;
     bool check_const_char = false;
 
-    for (std::sregex_iterator it(line.cbegin(), line.cend(), reg), end; it != end; ++it) {
-        auto&& m = *it;
-
-        // std::cout << m[1].str() << std::endl;
+    Lexer lexer{line};
+    std::string_view s;
+    std::string_view match;
+    while (lexer.Next(s, match)) {
         if (st_mode == START) {
             // 文字列の最後の'\''まで検索
-            if (m[1].str()[0] == '\'') {
+            if (s[0] == '\'') {
                 // '\'\''をチェック
                 st_mode = CONTINUE;
             } else {
-                string_s += m[0].str();
+                string_s += match;
             }
-            // std::cout << string_s << std::endl;
             continue;
 
         } else if (st_mode == CONTINUE) {
-            if (m[1].str()[0] == '\'') {
+            if (s[0] == '\'') {
                 // '\'\''だった
                 st_mode = START;
                 string_s += '\'';
@@ -96,47 +216,36 @@ const Tokens& Reader::Parse(const std::string& line) {
                 st_mode = NONE;
             }
         }
-        if (auto itr = key_words.find(m[1].str()); itr != key_words.end()) {
-            // std::cout << "OP:" << m[1].str() << std::endl;
-            if (itr->second.token_id == TokenId::COMMENT) {
+        if (const KeyWordDef *key_word = FindKeyWord(s); key_word != nullptr) {
+            if (key_word->token_id == TokenId::COMMENT) {
                 // コメントはtokenにいれない
                 break;
             }
-            tokenes.push_back(itr->second);
-        } else {
-            //      std::cout << "NP:" << m[1].str() << std::endl;
-            std::string s = m[1].str();
-
-            if (s[0] == '=') {
-                if (s.size() > 1) {
-                    std::string x{s.begin() + 1, s.end()};
-                    if (IsHex(x)) {
-                        std::string hex{x.begin() + 1, x.end()};
-
-                        tokenes.push_back(TokenInfo(TokenId::CONST, std::stoi(hex, nullptr, 16), s));
-                    } else if (IsDigit(x)) {
-                        tokenes.push_back(TokenInfo(TokenId::CONST, std::stoi(x, nullptr, 10), s));
-                    } else {
-                        tokenes.push_back(TokenInfo(TokenId::OTHER, s));
-                    }
+            tokenes.push_back(TokenInfo(key_word->token_id, key_word->operand_type));
+        } else if (s[0] == '=') {
+            if (s.size() > 1) {
+                std::string_view x = s.substr(1);
+                if (IsHex(x)) {
+                    tokenes.push_back(TokenInfo(TokenId::CONST, ToDigit(x.substr(1), 16), std::string(s)));
+                } else if (IsDigit(x)) {
+                    tokenes.push_back(TokenInfo(TokenId::CONST, ToDigit(x, 10), std::string(s)));
                 } else {
-                    check_const_char = true;
+                    tokenes.push_back(TokenInfo(TokenId::OTHER, std::string(s)));
                 }
-            } else if (IsHex(s)) {
-                std::string hex{s.begin() + 1, s.end()};
-                tokenes.push_back(TokenInfo(TokenId::DIGIT, std::stoi(hex, nullptr, 16)));
-            } else if (IsDigit(s)) {
-                tokenes.push_back(TokenInfo(TokenId::DIGIT, std::stoi(s, nullptr, 10)));
-            } else if (s[0] == '\'') {
-                st_mode = START;
-                string_s = "";
-                // std::string str{s.begin() + 1, s.end() - 1};
-                // tokenes.push_back(TokenInfo(TokenId::STRING, str));
-            } else if (IsLabel(s)) {
-                tokenes.push_back(TokenInfo(TokenId::LABEL, s));
             } else {
-                tokenes.push_back(TokenInfo(TokenId::OTHER, s));
+                check_const_char = true;
             }
+        } else if (IsHex(s)) {
+            tokenes.push_back(TokenInfo(TokenId::DIGIT, ToDigit(s.substr(1), 16)));
+        } else if (IsDigit(s)) {
+            tokenes.push_back(TokenInfo(TokenId::DIGIT, ToDigit(s, 10)));
+        } else if (s[0] == '\'') {
+            st_mode = START;
+            string_s.clear();
+        } else if (IsLabel(s)) {
+            tokenes.push_back(TokenInfo(TokenId::LABEL, std::string(s)));
+        } else {
+            tokenes.push_back(TokenInfo(TokenId::OTHER, std::string(s)));
         }
     }
 
@@ -151,28 +260,19 @@ const Tokens& Reader::Parse(const std::string& line) {
     return tokenes;
 }
 
-bool Reader::IsDigit(const std::string& s) {
-    if (s[0] == '-') {
-        return std::all_of(s.cbegin() + 1, s.cend(), isdigit);
-    }
-    return std::all_of(s.cbegin(), s.cend(), isdigit);
+bool Reader::IsDigit(std::string_view s) {
+    if (!s.empty() && s[0] == '-') s.remove_prefix(1);
+    return !s.empty() && std::all_of(s.cbegin(), s.cend(), IsDec);
 }
 
-bool Reader::IsHex(const std::string& s) {
-    return s[0] == '#' && std::all_of(s.cbegin() + 1, s.cend(),
-                                      [](char c) { return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F'); });
+bool Reader::IsHex(std::string_view s) {
+    return s.size() > 1 && s[0] == '#' && std::all_of(s.cbegin() + 1, s.cend(), [](char c) {
+               return IsDec(c) || (c >= 'A' && c <= 'F');
+           });
 }
-bool Reader::IsLabel(const std::string& s) {
-    if (isalpha(s[0])) {
-        if (s.size() > 1) {
-            if (std::all_of(s.cbegin() + 1, s.cend(), [](char c) { return isdigit(c) || isalpha(c); })) {
-                // TODO:長さはノーチェック
-                return true;
-            }
-        } else {
-            return true;
-        }
-    }
-    return false;
+bool Reader::IsLabel(std::string_view s) {
+    // TODO:長さはノーチェック
+    return !s.empty() && IsAlpha(s[0]) &&
+           std::all_of(s.cbegin() + 1, s.cend(), [](char c) { return IsDec(c) || IsAlpha(c); });
 }
 }  // namespace ass
\ No newline at end of file
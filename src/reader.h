@@ -3,8 +3,8 @@
 
 #include <cctype>
 #include <map>
-#include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ass {
@@ -97,8 +97,8 @@ inline TokenClass GetTokenClass(TokenId tid) { return (TokenClass)((uint16_t)TOK
 
 struct TokenInfo {
     TokenId token_id;
-    OperandType operand_type;
-    uint16_t digit;
+    OperandType operand_type = NONE;
+    uint16_t digit = 0;
     std::string label;
     TokenInfo(TokenId id, OperandType ope_type = NONE) : token_id(id), operand_type(ope_type) {}
     TokenInfo(TokenId id, uint16_t digit) : token_id(id), digit(digit) {}
@@ -114,8 +114,6 @@ using Tokens = std::vector<TokenInfo>;
  */
 class Reader {
    protected:
-    //! 一行をトークンに分割するための正規表現
-    const std::regex reg = std::regex(R"(\s*([^,;'\s]+|,|;|')\s*)");
     //! 解析した一行分のトークン
     Tokens tokenes;
 
@@ -127,26 +125,26 @@ class Reader {
      * @param line パースする1行の文字列
      * @return パースしたトークンを返す
      */
-    const Tokens& Parse(const std::string& line);
+    const Tokens& Parse(std::string_view line);
 
     /**
      * 文字列が10進数かどうかチェックする
      * @param s 文字列
      * @retval true 10進数文字列
      */
-    static bool IsDigit(const std::string& s);
+    static bool IsDigit(std::string_view s);
     /**
      * 文字列が16進数かどうかチェックする
      * @param s 文字列
      * @retval true 16進数文字列
      */
-    static bool IsHex(const std::string& s);
+    static bool IsHex(std::string_view s);
     /**
      * 文字列がラベルかどうかチェックする
      * @param s 文字列
      * @retval true ラベル
      */
-    static bool IsLabel(const std::string& s);
+    static bool IsLabel(std::string_view s);
 };
 }  // namespace ass
 
@@ -0,0 +1,104 @@
+#ifndef SYM_TABLE_H_
+#define SYM_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cii {
+
+/**
+ * @class
+ * シンボル表
+ * @note
+ * シンボル名はシンボル番号にインターンし、外部シンボル(START)と
+ * アセンブル中のモジュールのローカルシンボルを番号で引く。
+ */
+class SymTable {
+    std::unordered_map<std::string, uint32_t> ids;  //!< シンボル名からシンボル番号
+    std::vector<const std::string *> names;         //!< シンボル番号からシンボル名(idsのキー)
+    std::vector<int32_t> externs;                   //!< 外部シンボルのアドレス
+    std::vector<int32_t> locals;                    //!< アセンブル中のモジュールのローカルシンボルのアドレス
+    std::vector<int32_t> firsts;                    //!< 終了したモジュールで最初に定義したアドレス
+    std::vector<uint32_t> local_ids;                //!< アセンブル中のモジュールで定義したシンボル番号
+
+   public:
+    static constexpr uint32_t NO_SYM = UINT32_MAX;  //!< シンボルなし
+    static constexpr int32_t NO_ADR = -1;           //!< 未定義
+
+    /**
+     * @brief シンボル名をインターンする
+     * @param name シンボル名
+     * @return uint32_t シンボル番号
+     */
+    uint32_t Intern(const std::string &name) {
+        auto [itr, inserted] = ids.emplace(name, (uint32_t)ids.size());
+        if (inserted) {
+            names.push_back(&itr->first);
+            externs.push_back(NO_ADR);
+            locals.push_back(NO_ADR);
+            firsts.push_back(NO_ADR);
+        }
+        return itr->second;
+    }
+    /**
+     * @brief シンボル番号を検索する
+     * @param name シンボル名
+     * @return uint32_t シンボル番号、インターンしていないときはNO_SYM
+     */
+    uint32_t Find(const std::string &name) const {
+        auto itr = ids.find(name);
+        return itr == ids.end() ? NO_SYM : itr->second;
+    }
+
+    /**
+     * @brief 外部シンボルを定義する。定義済みのときは最初の定義を残す
+     * @return false 定義済み
+     */
+    bool DefineExtern(uint32_t id, uint16_t adr) {
+        if (externs[id] != NO_ADR) return false;
+        externs[id] = adr;
+        return true;
+    }
+    /**
+     * @brief ローカルシンボルを定義する。定義済みのときは最初の定義を残す
+     * @return false 定義済み
+     */
+    bool DefineLocal(uint32_t id, uint16_t adr) {
+        if (locals[id] != NO_ADR) return false;
+        locals[id] = adr;
+        local_ids.push_back(id);
+        return true;
+    }
+    const std::string &Name(uint32_t id) const { return *names[id]; }
+    int32_t Extern(uint32_t id) const { return externs[id]; }
+    int32_t Local(uint32_t id) const { return locals[id]; }
+    int32_t First(uint32_t id) const { return firsts[id]; }
+    //! インターンしたシンボル数
+    uint32_t Size() const { return (uint32_t)names.size(); }
+    //! アセンブル中のモジュールで定義したシンボル番号(定義順)
+    const std::vector<uint32_t> &GetLocalIds() const { return local_ids; }
+
+    /**
+     * @brief モジュールのアセンブルを終了し、ローカルシンボルを空にする
+     */
+    void EndModule() {
+        for (uint32_t id : local_ids) {
+            if (firsts[id] == NO_ADR) firsts[id] = locals[id];
+            locals[id] = NO_ADR;
+        }
+        local_ids.clear();
+    }
+    void Clear() {
+        ids.clear();
+        names.clear();
+        externs.clear();
+        locals.clear();
+        firsts.clear();
+        local_ids.clear();
+    }
+};
+
+}  // namespace cii
+#endif
@@ -0,0 +1,149 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+#include "common.h"
+
+namespace cii {
+namespace {
+//! トレースファイルの識別子
+constexpr char MAGIC[4] = {'C', 'I', 'I', 'T'};
+//! トレースファイルの形式のバージョン。形式を変えたら上げる
+constexpr uint32_t VERSION = 1;
+
+static_assert(sizeof(Tracer::Block) == Tracer::BLOCK_SIZE, "Tracer::Block layout");
+
+uint16_t Get16(const uint8_t *&p) {
+    uint16_t v = (uint16_t)(p[0] | (p[1] << 8));
+    p += 2;
+    return v;
+}
+}  // namespace
+
+Tracer::Tracer(size_t size) : blocks(std::max<size_t>(size / sizeof(Block), 2)), sink(nullptr) { Clear(); }
+
+void Tracer::Clear() {
+    head = 0;
+    filled = 0;
+    sealed = true;
+    last_step = 0;
+    expected_pr = 0;
+    std::fill(std::begin(state_gr), std::end(state_gr), 0);
+    state_sp = 0;
+    state_fr = 0;
+    total = 0;
+}
+
+void Tracer::SetSink(std::ostream *os) {
+    sink = os;
+    if (sink == nullptr) return;
+
+    uint32_t header[3] = {0, VERSION, (uint32_t)sizeof(Block)};
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    sink->write((const char *)header, sizeof(header));
+}
+
+void Tracer::Flush() {
+    if (!sealed && sink != nullptr) sink->write((const char *)&blocks[head], sizeof(Block));
+    if (sink != nullptr) sink->flush();
+    sealed = true;
+}
+
+Tracer::Block *Tracer::NewBlock(uint32_t step, uint16_t adr) {
+    if (!sealed && sink != nullptr) sink->write((const char *)&blocks[head], sizeof(Block));
+    // 最初のブロックは先頭から使う。埋まったら一番古いブロックを上書きする
+    if (filled > 0) head = (head + 1) % blocks.size();
+    filled = std::min(filled + 1, blocks.size());
+    sealed = false;
+
+    Block &b = blocks[head];
+    b.step = step;
+    b.count = 0;
+    b.used = 0;
+    std::copy(std::begin(state_gr), std::end(state_gr), b.gr);
+    b.sp = state_sp;
+    b.pr = adr;
+    b.fr = state_fr;
+    std::fill(std::begin(b.reserved), std::end(b.reserved), 0);
+    return &b;
+}
+
+void Tracer::DecodeBlock(const Block &b, const std::function<void(const TraceStep &)> &fn) {
+    TraceStep s{};
+    std::copy(std::begin(b.gr), std::end(b.gr), s.gr);
+    s.sp = b.sp;
+    s.fr = b.fr;
+    uint16_t pr = b.pr;
+
+    const uint8_t *p = b.data;
+    const uint8_t *end = b.data + std::min<size_t>(b.used, sizeof(b.data));
+    for (uint16_t i = 0; i < b.count && p < end; i++) {
+        uint8_t f = *p++;
+        s.step = b.step + i;
+        s.adr = pr;
+        s.opword = Get16(p);
+        s.has_ea = (f & EA) != 0;
+        s.ea = s.has_ea ? Get16(p) : 0;
+        if (f & JUMP)
+            s.next_pr = Get16(p);
+        else if (f & TAKEN)
+            s.next_pr = s.ea;
+        else
+            s.next_pr = (uint16_t)(s.adr + (s.has_ea ? 2 : 1));
+        s.fr_changed = (f & FR) != 0;
+        if (s.fr_changed) s.fr = *p++;
+        s.sp_changed = (f & SP) != 0;
+        if (s.sp_changed) s.sp = Get16(p);
+        s.gr_changed = 0;
+        if (f & GR) {
+            s.gr_changed = *p++;
+            for (int r = 0; r < 8; r++) {
+                if (s.gr_changed & (1 << r)) s.gr[r] = Get16(p);
+            }
+        }
+        fn(s);
+        pr = s.next_pr;
+    }
+}
+
+void Tracer::ForEach(const std::function<void(const TraceStep &)> &fn) const {
+    size_t oldest = filled < blocks.size() ? 0 : (head + 1) % blocks.size();
+    for (size_t i = 0; i < filled; i++) DecodeBlock(blocks[(oldest + i) % blocks.size()], fn);
+}
+
+std::vector<TraceStep> Tracer::GetLast(size_t n) const {
+    std::deque<TraceStep> last;
+    ForEach([&](const TraceStep &s) {
+        last.push_back(s);
+        if (last.size() > n) last.pop_front();
+    });
+    return {last.begin(), last.end()};
+}
+
+bool Tracer::ReadFile(std::istream &is, const std::function<void(const TraceStep &)> &fn) {
+    uint32_t header[3];
+    if (!is.read((char *)header, sizeof(header)) || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0 ||
+        header[1] != VERSION || header[2] != sizeof(Block))
+        return false;
+
+    Block b;
+    while (is.read((char *)&b, sizeof(b))) DecodeBlock(b, fn);
+    return is.eof() && is.gcount() == 0;
+}
+
+void Tracer::Print(std::ostream &os, const TraceStep &s) {
+    os << cmn::Format("%10u  %04x  %04x ", s.step, s.adr, s.opword);
+    os << (s.has_ea ? cmn::Format("%04x ", s.ea) : std::string(5, ' '));
+    for (int r = 0; r < 8; r++) {
+        if (s.gr_changed & (1 << r)) os << cmn::Format(" GR%d=%04x", r, s.gr[r]);
+    }
+    if (s.sp_changed) os << cmn::Format(" SP=%04x", s.sp);
+    if (s.fr_changed) {
+        os << " FR=" << (s.fr & 1 ? "O" : "-") << (s.fr & 2 ? "S" : "-") << (s.fr & 4 ? "Z" : "-");
+    }
+    if (s.next_pr != (uint16_t)(s.adr + (s.has_ea ? 2 : 1))) os << cmn::Format(" PR=%04x", s.next_pr);
+}
+
+}  // namespace cii
@@ -0,0 +1,237 @@
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+namespace cii {
+
+/**
+ * @brief トレースの1ステップ
+ */
+struct TraceStep {
+    uint32_t step;       //!< 実行命令数(EC)
+    uint16_t adr;        //!< 命令のアドレス
+    uint16_t opword;     //!< 命令の第1語
+    uint16_t ea;         //!< 実効アドレス(2語命令のとき)
+    uint16_t next_pr;    //!< 実行後のPR
+    bool has_ea;         //!< 2語命令
+    uint8_t gr_changed;  //!< 値が変わった汎用レジスタ(ビットごと)
+    bool sp_changed;     //!< SPが変わった
+    bool fr_changed;     //!< FRが変わった
+    uint16_t gr[8];      //!< 実行後の汎用レジスタ
+    uint16_t sp;         //!< 実行後のSP
+    uint8_t fr;          //!< 実行後のFR(OF:bit0、SF:bit1、ZF:bit2)
+};
+
+/**
+ * @class
+ * 命令トレースのリングバッファ
+ * @note
+ * 記録は固定長のブロック(キャッシュライン境界に配置)に詰める。ブロックの先頭には最初の命令を実行する前の
+ * レジスタを持ち、各命令は前の命令からの差分(変わったレジスタ、順に実行しなかったときの次のPR)だけを持つ。
+ * ブロックは単独で復元できるため、古いブロックから上書きする。
+ * 出力先を設定すると、埋まったブロックをそのまま書き込むため、全ステップをファイルに残せる。
+ */
+class Tracer {
+   public:
+    static constexpr size_t BLOCK_SIZE = 256;            //!< ブロックのバイト数
+    static constexpr size_t DEFAULT_SIZE = 1024 * 1024;  //!< リングバッファのバイト数の既定値
+
+    /**
+     * @brief ブロック
+     */
+    struct alignas(64) Block {
+        uint32_t step;    //!< 最初の命令の実行命令数
+        uint16_t count;   //!< 命令数
+        uint16_t used;    //!< dataの使用バイト数
+        uint16_t gr[8];   //!< 最初の命令を実行する前の汎用レジスタ
+        uint16_t sp;      //!< 最初の命令を実行する前のSP
+        uint16_t pr;      //!< 最初の命令のアドレス
+        uint8_t fr;       //!< 最初の命令を実行する前のFR
+        uint8_t reserved[3];
+        uint8_t data[BLOCK_SIZE - 32];  //!< 命令ごとの差分
+    };
+
+    /**
+     * @brief Construct a new Tracer object
+     *
+     * @param size リングバッファのバイト数(2ブロック以上)
+     */
+    explicit Tracer(size_t size = DEFAULT_SIZE);
+
+    /**
+     * @brief 記録をすべて消す
+     */
+    void Clear();
+    /**
+     * @brief 埋まったブロックの出力先を設定する
+     * @param os 出力先(バイナリ)。nullptrのときは出力しない。設定したときにファイルヘッダを書き込む
+     */
+    void SetSink(std::ostream *os);
+    /**
+     * @brief 記録中のブロックを出力先に書き込む
+     * @note
+     * 以降の命令は新しいブロックに記録する
+     */
+    void Flush();
+
+    /**
+     * @brief 次の命令が記録中のブロックに続くか
+     * @param step 実行命令数
+     * @param adr 命令のアドレス
+     * @return false 新しいブロックから記録する(Seedで実行前のレジスタを渡す)
+     */
+    bool Continues(uint32_t step, uint16_t adr) const {
+        return !sealed && step == last_step + 1 && adr == expected_pr;
+    }
+    /**
+     * @brief 次の命令を実行する前のレジスタを設定する
+     * @note
+     * トレースを始めたときや順に実行しなかったときは、最後に記録したレジスタとCPUのレジスタが一致しないため、
+     * 新しいブロックの先頭のレジスタと最初の命令の差分をCPUのレジスタから求める
+     * @param gr 汎用レジスタ
+     * @param sp SP
+     * @param fr FR
+     */
+    void Seed(const uint16_t *gr, uint16_t sp, uint8_t fr) {
+        std::copy(gr, gr + 8, state_gr);
+        state_sp = sp;
+        state_fr = fr;
+    }
+
+    /**
+     * @brief 実行した命令を記録する
+     * @param step 実行命令数
+     * @param adr 命令のアドレス
+     * @param opword 命令の第1語
+     * @param len 命令語長
+     * @param ea 実効アドレス(2語命令のとき)
+     * @param gr 実行後の汎用レジスタ
+     * @param sp 実行後のSP
+     * @param fr 実行後のFR
+     * @param next_pr 実行後のPR
+     */
+    inline void Record(uint32_t step, uint16_t adr, uint16_t opword, uint8_t len, uint16_t ea, const uint16_t *gr,
+                       uint16_t sp, uint8_t fr, uint16_t next_pr) {
+        Block *b = &blocks[head];
+        if (sealed || b->used > sizeof(b->data) - MAX_RECORD || step != last_step + 1 || adr != expected_pr) {
+            b = NewBlock(step, adr);
+        }
+        uint8_t *p = b->data + b->used;
+        uint8_t *flags = p++;
+        uint8_t f = 0;
+        Put16(p, opword);
+        if (len == 2) {
+            f |= EA;
+            Put16(p, ea);
+        }
+        if (next_pr != (uint16_t)(adr + len)) {
+            if (len == 2 && next_pr == ea) {
+                f |= TAKEN;
+            } else {
+                f |= JUMP;
+                Put16(p, next_pr);
+            }
+        }
+        if (fr != state_fr) {
+            f |= FR;
+            *p++ = fr;
+            state_fr = fr;
+        }
+        if (sp != state_sp) {
+            f |= SP;
+            Put16(p, sp);
+            state_sp = sp;
+        }
+        uint8_t mask = 0;
+        for (int i = 0; i < 8; i++) mask |= (gr[i] != state_gr[i]) << i;
+        if (mask != 0) {
+            f |= GR;
+            *p++ = mask;
+            for (int i = 0; i < 8; i++) {
+                if (mask & (1 << i)) {
+                    Put16(p, gr[i]);
+                    state_gr[i] = gr[i];
+                }
+            }
+        }
+        *flags = f;
+        b->used = (uint16_t)(p - b->data);
+        b->count++;
+        last_step = step;
+        expected_pr = next_pr;
+        total++;
+    }
+
+    /**
+     * @brief 残っている記録を古い順に復元する
+     * @param fn 1ステップごとに呼び出す関数
+     */
+    void ForEach(const std::function<void(const TraceStep &)> &fn) const;
+    /**
+     * @brief 最後のnステップを取得する
+     * @return std::vector<TraceStep> 古い順
+     */
+    std::vector<TraceStep> GetLast(size_t n) const;
+    /**
+     * @brief 記録したステップ数(上書きしたものを含む)
+     */
+    uint64_t GetTotal() const { return total; }
+
+    /**
+     * @brief SetSinkで書き込んだトレースファイルを読み込んで復元する
+     * @param is トレースファイル(バイナリ)
+     * @param fn 1ステップごとに呼び出す関数
+     * @return false 形式が違う
+     */
+    static bool ReadFile(std::istream &is, const std::function<void(const TraceStep &)> &fn);
+    /**
+     * @brief 1ステップを"EC アドレス 命令語 [実効アドレス] 変わったレジスタ"の形式で出力する
+     */
+    static void Print(std::ostream &os, const TraceStep &step);
+
+   private:
+    //! 差分のフラグ
+    enum : uint8_t {
+        EA = 0x01,     //!< 実効アドレスあり
+        TAKEN = 0x02,  //!< 次のPRは実効アドレス
+        JUMP = 0x04,   //!< 次のPRあり
+        FR = 0x08,     //!< FRあり
+        SP = 0x10,     //!< SPあり
+        GR = 0x20,     //!< 変わった汎用レジスタのビットと値あり
+    };
+    //! 1命令の最大バイト数
+    static constexpr size_t MAX_RECORD = 1 + 2 + 2 + 2 + 1 + 2 + 1 + 8 * 2;
+
+    std::vector<Block> blocks;  //!< リングバッファ
+    size_t head;                //!< 記録中のブロック
+    size_t filled;              //!< 記録のあるブロック数
+    bool sealed;                //!< 次の命令は新しいブロックに記録する
+    uint32_t last_step;         //!< 最後に記録した実行命令数
+    uint16_t expected_pr;       //!< 最後に記録した命令の次のPR
+    uint16_t state_gr[8];       //!< 最後に記録した命令の実行後の汎用レジスタ
+    uint16_t state_sp;          //!< 最後に記録した命令の実行後のSP
+    uint8_t state_fr;           //!< 最後に記録した命令の実行後のFR
+    uint64_t total;             //!< 記録したステップ数
+    std::ostream *sink;         //!< 埋まったブロックの出力先
+
+    static inline void Put16(uint8_t *&p, uint16_t v) {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p += 2;
+    }
+    /**
+     * @brief 次のブロックに移る。記録中のブロックは出力先に書き込む
+     * @return Block* 新しいブロック
+     */
+    Block *NewBlock(uint32_t step, uint16_t adr);
+    static void DecodeBlock(const Block &b, const std::function<void(const TraceStep &)> &fn);
+};
+
+}  // namespace cii
+#endif
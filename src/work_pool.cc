@@ -0,0 +1,57 @@
+#include "work_pool.h"
+
+#include <thread>
+
+namespace cmn {
+
+WorkPool::WorkPool(unsigned workers) : next(0) {
+    if (workers == 0) workers = std::thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+    for (unsigned i = 0; i < workers; i++) queues.push_back(std::make_unique<Queue>());
+}
+
+void WorkPool::Push(Task task) {
+    Queue& q = *queues[next];
+    next = (next + 1) % queues.size();
+
+    std::lock_guard<std::mutex> lock(q.mtx);
+    q.tasks.push_back(std::move(task));
+}
+
+void WorkPool::Run() {
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < queues.size(); i++) threads.emplace_back(&WorkPool::Work, this, i);
+    // 呼び出し元のスレッドもワーカー0として動作する
+    Work(0);
+    for (auto& t : threads) t.join();
+}
+
+bool WorkPool::Take(unsigned worker, Task& task) {
+    {
+        Queue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        Queue& victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    // タスクは実行中に追加されないため、すべて空なら終了してよい
+    return false;
+}
+
+void WorkPool::Work(unsigned worker) {
+    Task task;
+    while (Take(worker, task)) task(worker);
+}
+
+}  // namespace cmn
@@ -0,0 +1,70 @@
+#ifndef WORK_POOL_H_
+#define WORK_POOL_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cmn {
+
+/**
+ * @class
+ * ワークスティーリング方式のスレッドプール
+ * @note
+ * タスクを登録してからRunで一括実行する。各ワーカーは自分のキューの末尾から取り出し、
+ * 空になったら他のワーカーのキューの先頭から盗む。
+ */
+class WorkPool {
+   public:
+    //! タスク。引数は実行するワーカー番号
+    using Task = std::function<void(unsigned worker)>;
+
+    /**
+     * @brief Construct a new Work Pool object
+     *
+     * @param workers ワーカー数(0のときはハードウェアスレッド数)
+     */
+    explicit WorkPool(unsigned workers = 0);
+
+    /**
+     * @brief タスクを登録する。ワーカーのキューに順番に割り当てる
+     *
+     * @param task タスク
+     */
+    void Push(Task task);
+    /**
+     * @brief 登録したタスクをすべて実行し、終了を待つ
+     */
+    void Run();
+
+    unsigned GetWorkers() const { return (unsigned)queues.size(); }
+
+   private:
+    /**
+     * @brief ワーカーごとのタスクキュー
+     */
+    struct Queue {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;  //!< ワーカーごとのタスクキュー
+    size_t next;                                 //!< 次に割り当てるキュー
+
+    /**
+     * @brief タスクを1つ取り出す。自分のキューが空のときは他のワーカーから盗む
+     *
+     * @param worker ワーカー番号
+     * @param task 取り出したタスク
+     * @return true 取り出した
+     * @return false すべてのキューが空
+     */
+    bool Take(unsigned worker, Task& task);
+    void Work(unsigned worker);
+};
+
+}  // namespace cmn
+
+#endif
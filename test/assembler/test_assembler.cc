@@ -682,7 +682,7 @@ TEST_F(AssTest, ERR_0023) {
 
     assem.Assemble(ss, mem);
 
-    EXPECT_EQ(ass::AsmErrCode::MULTI_DEF_SYM, assem.dbg_infos[1].err);
+    EXPECT_EQ(ass::AsmErrCode::MULTI_DEF_SYM, assem.dbg_infos.Err(1));
 }
 TEST_F(AssTest, ERR_0024) {
     mem.Start();
@@ -714,5 +714,122 @@ TEST_F(AssTest, ERR_0026) {
     EXPECT_EQ(ass::AsmErrCode::INVALID_OPERAND, assem.error);
 }
 
+TEST_F(AssTest, LINK_0001) {
+    // 2つのモジュールで同じローカルシンボルを定義し、STARTのシンボルは共有する
+    mem.Start();
+    std::stringstream main_src{
+        "MAIN  START\n"
+        "      LD    GR1,VAL\n"
+        "      CALL  SUB\n"
+        "      RET\n"
+        "VAL   DC    1\n"
+        "      END\n"};
+    assem.Assemble(main_src, mem);
+    mem.SnapShot();
+    uint16_t main_val = mem.FindSym("VAL");
+
+    std::stringstream sub_src{
+        "SUB   START\n"
+        "      LD    GR2,VAL\n"
+        "      LD    GR3,NONE\n"
+        "      RET\n"
+        "VAL   DC    2\n"
+        "      END\n"};
+    assem.Assemble(sub_src, mem);
+    // モジュール内の定義だけ重複をチェックする
+    std::string val = "VAL";
+    std::string main = "MAIN";
+    EXPECT_EQ(false, mem.CheckSym(val));
+    EXPECT_EQ(false, mem.CheckSym(main));
+    mem.SnapShot();
+    std::string none = "NONE";
+    EXPECT_EQ(true, mem.CheckSym(none));
+
+    EXPECT_EQ(false, mem.End());
+    ASSERT_EQ(1, mem.GetUnresolved().size());
+    EXPECT_EQ(1u, mem.GetUnresolved()[0].module);
+
+    // 最初に定義したモジュールのシンボルを返す
+    EXPECT_EQ(main_val, mem.FindSym("VAL"));
+    uint16_t sub = mem.FindSym("SUB");
+    EXPECT_EQ(main_val, mem.memory[1]);
+    EXPECT_EQ(sub, mem.memory[3]);
+    EXPECT_EQ(sub + 5, mem.memory[sub + 1]);
+    EXPECT_EQ(UINT16_MAX, mem.FindSym("NONE"));
+}
+
+
+TEST_F(AssTest, LINE_TABLE_0001) {
+    mem.Start();
+    std::stringstream ss{
+        "MAIN  START\n"
+        "      LD    GR1,VAL\n"
+        "VAL   DC    2\n"
+        "      END\n"};
+    assem.Assemble(ss, mem);
+
+    const ass::LineTable& lines = assem.dbg_infos;
+    ASSERT_EQ(4u, lines.Size());
+    EXPECT_EQ("      LD    GR1,VAL", lines.Text(1));
+    EXPECT_EQ(0, lines.StartOffset(1));
+    EXPECT_EQ(2, lines.EndOffset(1));
+    EXPECT_EQ(2u, lines.LineNo(1));
+    EXPECT_EQ(ass::AsmErrCode::OK, lines.Err(1));
+
+    // ファイルごとに行番号を振り直し、アドレスは再配置する
+    ass::LineTable all;
+    all.AddFile("a.csl");
+    all.Append(lines);
+    ass::LineTable sub = lines;
+    sub.Relocate(3);
+    all.AddFile("b.csl");
+    all.Append(sub);
+    ASSERT_EQ(8u, all.Size());
+    EXPECT_EQ(2, all.GetFiles());
+    EXPECT_EQ(4u, all.FileBegin(1));
+    EXPECT_EQ(8u, all.FileEnd(1));
+    EXPECT_EQ("b.csl", all.FileName(all.FileId(6)));
+    EXPECT_EQ(3u, all.LineNo(6));
+    EXPECT_EQ("VAL   DC    2", all.Text(6));
+    EXPECT_EQ(5, all.StartOffset(6));
+
+    // エラーとブレークポイントは別々に設定する
+    all.SetBreak(5, true);
+    all.SetErr(5, ass::AsmErrCode::NO_DEF_SYM);
+    EXPECT_TRUE(all.IsBreak(5));
+    EXPECT_EQ(ass::AsmErrCode::NO_DEF_SYM, all.Err(5));
+    all.SetBreak(5, false);
+    EXPECT_FALSE(all.IsBreak(5));
+    EXPECT_EQ(ass::AsmErrCode::NO_DEF_SYM, all.Err(5));
+}
+
+
+TEST_F(AssTest, LINE_TABLE_0002) {
+    mem.Start();
+    std::stringstream ss{
+        "MAIN  START\n"
+        "      LD    GR1,VAL\n"
+        "; コメント\n"
+        "      RET\n"
+        "VAL   DS    3\n"
+        "      END\n"};
+    assem.Assemble(ss, mem);
+
+    ass::LineTable& lines = assem.dbg_infos;
+    lines.BuildIndex();
+    // アドレスを含む行。長さが0の行は含まない
+    EXPECT_EQ(1u, lines.FindLine(0));
+    EXPECT_EQ(1u, lines.FindLine(1));
+    EXPECT_EQ(3u, lines.FindLine(2));
+    EXPECT_EQ(4u, lines.FindLine(5));
+    EXPECT_EQ(ass::LineTable::NO_LINE, lines.FindLine(6));
+
+    // 開始アドレスがstart以上、終了アドレスがend未満の行
+    EXPECT_EQ(std::make_pair(0u, 6u), lines.FindLines(0, UINT16_MAX));
+    EXPECT_EQ(std::make_pair(2u, 4u), lines.FindLines(2, 6));
+    EXPECT_EQ(std::make_pair(2u, 6u), lines.FindLines(1, 7));
+    EXPECT_EQ(std::make_pair(6u, 6u), lines.FindLines(7, UINT16_MAX));
+}
+
 }  // namespace
 #endif
\ No newline at end of file
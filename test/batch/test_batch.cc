@@ -0,0 +1,381 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "../test_config.h"
+#include "batch_runner.h"
+#include "builder.h"
+#include "conf.h"
+#include "exec_image.h"
+#include "object_module.h"
+#include "program_image.h"
+#include "work_pool.h"
+
+#if TEST_CONFIG_BATCH_TEST
+
+namespace {
+std::string WriteFile(const std::string &name, const std::string &contents) {
+    std::string path = ::testing::TempDir() + name;
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << contents;
+    return path;
+}
+
+//! 入力した文字列をそのまま出力する
+const char *ECHO_SRC =
+    "ECHO   START\n"
+    "       IN    BUF,LEN\n"
+    "       OUT   BUF,LEN\n"
+    "       RET\n"
+    "BUF    DS    256\n"
+    "LEN    DS    1\n"
+    "       END\n";
+
+//! 終了しない
+const char *LOOP_SRC =
+    "LOOP   START\n"
+    "L      JUMP  L\n"
+    "       END\n";
+
+TEST(WorkPool, 0001) {
+    cmn::WorkPool pool(4);
+    EXPECT_EQ(4u, pool.GetWorkers());
+
+    std::vector<std::atomic<int>> runs(1000);
+    for (auto &r : runs) r = 0;
+    for (size_t i = 0; i < runs.size(); i++) pool.Push([&, i](unsigned) { runs[i]++; });
+    pool.Run();
+
+    for (auto &r : runs) EXPECT_EQ(1, r);
+}
+
+TEST(BatchRunner, Manifest) {
+    std::stringstream manifest{
+        "# comment\n"
+        "\n"
+        "a.csl b.csl < in1.txt > out1.txt\n"
+        "c.csl < in2.txt > out2.txt\n"
+        "a.csl b.csl < in3.txt > out3.txt\n"};
+    std::vector<cii::BatchProgram> programs;
+    EXPECT_TRUE(cii::BatchRunner::ReadManifest(manifest, programs));
+    ASSERT_EQ(2u, programs.size());
+    EXPECT_EQ((std::vector<std::string>{"a.csl", "b.csl"}), programs[0].files);
+    ASSERT_EQ(2u, programs[0].cases.size());
+    EXPECT_EQ("in3.txt", programs[0].cases[1].input_file);
+    EXPECT_EQ("out3.txt", programs[0].cases[1].expect_file);
+    EXPECT_EQ(1u, programs[1].cases.size());
+
+    std::stringstream bad{"a.csl in1.txt out1.txt\n"};
+    std::stringstream err;
+    EXPECT_FALSE(cii::BatchRunner::ReadManifest(bad, programs, err));
+}
+
+TEST(BatchRunner, Run) {
+    std::string echo = WriteFile("echo.csl", ECHO_SRC);
+    std::string loop = WriteFile("loop.csl", LOOP_SRC);
+    std::string in = WriteFile("in.txt", "hello\n");
+    std::string ok = WriteFile("ok.txt", "hello\n");
+    std::string ng = WriteFile("ng.txt", "world\n");
+
+    std::vector<cii::BatchProgram> programs = {
+        {{echo}, {{in, ok}, {in, ng}, {in, ok}}},
+        {{loop}, {{in, ok}}},
+    };
+    cii::BatchRunner runner{2, 1000};
+    std::string profile_dir = ::testing::TempDir() + "casl_profile";
+    std::filesystem::remove_all(profile_dir);
+    runner.SetProfileDir(profile_dir);
+    std::stringstream out;
+    EXPECT_FALSE(runner.Run(programs, out));
+
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(out, line)) lines.push_back(line);
+    ASSERT_EQ(4u, lines.size());
+    EXPECT_NE(std::string::npos, lines[0].find("\"result\":\"pass\""));
+    EXPECT_NE(std::string::npos, lines[1].find("\"result\":\"fail\""));
+    EXPECT_NE(std::string::npos, lines[2].find("\"result\":\"pass\""));
+    EXPECT_NE(std::string::npos, lines[3].find("\"cause\":\"STEP_LIMIT\""));
+    EXPECT_NE(std::string::npos, lines[3].find("\"steps\":1000"));
+
+    // プロファイルはプログラムごとに全ケースを合計する
+    for (auto [name, steps] : std::vector<std::pair<std::string, std::string>>{{"program1.txt", "steps: 45\n"},
+                                                                               {"program2.txt", "steps: 1000\n"}}) {
+        std::ifstream ifs(profile_dir + "/" + name);
+        std::string report((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        EXPECT_NE(std::string::npos, report.find(steps)) << report;
+    }
+}
+
+TEST(ProgramImage, Fork) {
+    std::string echo = WriteFile("echo.csl", ECHO_SRC);
+
+    auto build_env = std::make_unique<cii::CommetIIEnv>();
+    Builder builder{*build_env};
+    std::shared_ptr<const cii::ProgramImage> image = builder.BuildImage({echo});
+    ASSERT_NE(nullptr, image);
+    EXPECT_EQ(0, image->GetStart());
+    EXPECT_EQ(build_env->mem.GetOffset(), image->GetUsed());
+    EXPECT_FALSE(image->GetDbgInfos().Empty());
+
+    // 同じイメージから別々のCometIIで実行する
+    auto env1 = std::make_unique<cii::CommetIIEnv>();
+    auto env2 = std::make_unique<cii::CommetIIEnv>();
+    for (const char *input : {"abc", "hello world", "x"}) {
+        for (auto env : {env1.get(), env2.get()}) {
+            std::stringstream in{input};
+            std::stringstream out;
+            env->cii_cpu.SetSvcIn(in);
+            env->cii_cpu.SetSvcOut(out);
+            EXPECT_TRUE(image->Fork(env->cii_cpu));
+            EXPECT_EQ(cii::CauseOfStop::HALT, env->cii_cpu.Run());
+            EXPECT_EQ(std::string(input) + "\n", out.str());
+        }
+    }
+
+    // 前の実行で書き込んだ使用領域以降のワードは、次の展開で0に戻す
+    for (uint32_t adr : {image->GetUsed(), 2047u, 2048u, 4095u}) env1->mem.memory[adr].data = 0x1234;
+    EXPECT_TRUE(image->Fork(env1->cii_cpu));
+    for (uint32_t adr = image->GetUsed(); adr < env1->mem.size; adr++) {
+        ASSERT_EQ(0, env1->mem.memory[adr].data) << adr;
+    }
+
+    // 展開先のメモリが足りない
+    cii::WordData words[4];
+    cii::Memory small{4, words};
+    EXPECT_FALSE(image->Load(small));
+}
+
+/**
+ * @brief ビルドした結果
+ */
+struct BuildResult {
+    bool ok;
+    std::vector<uint16_t> words;
+    std::vector<std::pair<uint16_t, uint16_t>> offsets;
+    std::string out;
+};
+
+BuildResult BuildFiles(const std::vector<std::string> &files, unsigned jobs, const std::string &cache_dir = "") {
+    auto env = std::make_unique<cii::CommetIIEnv>();
+    Builder builder{*env};
+    builder.SetJobs(jobs);
+    builder.SetCacheDir(cache_dir);
+
+    BuildResult r;
+    std::stringstream out;
+    std::streambuf *cout_buf = std::cout.rdbuf(out.rdbuf());
+    ass::LineTable dbg_infos;
+    r.ok = builder.Build(files, dbg_infos);
+    std::cout.rdbuf(cout_buf);
+
+    r.out = out.str();
+    for (uint32_t i = 0; i < env->mem.GetOffset(); i++) r.words.push_back(env->mem.memory[i].data);
+    for (uint32_t i = 0; i < dbg_infos.Size(); i++) r.offsets.push_back({dbg_infos.StartOffset(i), dbg_infos.EndOffset(i)});
+    return r;
+}
+
+TEST(Builder, Parallel) {
+    std::string main = WriteFile("main.csl",
+                                 "MAIN   START\n"
+                                 "       LD    GR1,=1\n"
+                                 "       CALL  SUB\n"
+                                 "       OUT   BUF,LEN\n"
+                                 "       RET\n"
+                                 "BUF    DC    'main'\n"
+                                 "LEN    DC    4\n"
+                                 "       END\n");
+    std::string sub = WriteFile("sub.csl",
+                                "SUB    START\n"
+                                "       ADDA  GR1,=1\n"
+                                "       ADDA  GR1,=#10\n"
+                                "       OUT   BUF,LEN\n"
+                                "       RET\n"
+                                "BUF    DC    'sub'\n"
+                                "LEN    DC    3\n"
+                                "       END\n");
+    // 前のファイルのSTARTと同じラベル
+    std::string redef = WriteFile("redef.csl",
+                                  "RDEF   START\n"
+                                  "MAIN   DC    1\n"
+                                  "       LD    GR1,NONE\n"
+                                  "       RET\n"
+                                  "       END\n");
+    std::string error = WriteFile("error.csl",
+                                  "ERR    START\n"
+                                  "       LD    GR1\n"
+                                  "       END\n");
+
+    // 順番にアセンブルしたときと同じメモリ、デバッグ情報、エラー表示になる
+    for (auto &files : std::vector<std::vector<std::string>>{
+             {main, sub}, {sub, main, sub}, {main, sub, redef}, {main, error, sub}, {main, "none.csl", sub}}) {
+        BuildResult seq = BuildFiles(files, 1);
+        BuildResult par = BuildFiles(files, 4);
+        EXPECT_EQ(seq.ok, par.ok);
+        EXPECT_EQ(seq.words, par.words);
+        EXPECT_EQ(seq.offsets, par.offsets);
+        EXPECT_EQ(seq.out, par.out);
+    }
+    EXPECT_TRUE(BuildFiles({main, sub}, 4).ok);
+    EXPECT_FALSE(BuildFiles({main, sub, redef}, 4).ok);
+
+    // キャッシュから読み込んでも同じ結果になる
+    std::string cache_dir = ::testing::TempDir() + "casl_cache";
+    std::filesystem::remove_all(cache_dir);
+    for (auto &files : std::vector<std::vector<std::string>>{{main, sub}, {main, sub, redef}, {main, error, sub}}) {
+        BuildResult seq = BuildFiles(files, 1);
+        for (int i = 0; i < 2; i++) {
+            BuildResult cached = BuildFiles(files, 1, cache_dir);
+            EXPECT_EQ(seq.ok, cached.ok);
+            EXPECT_EQ(seq.words, cached.words);
+            EXPECT_EQ(seq.offsets, cached.offsets);
+            EXPECT_EQ(seq.out, cached.out);
+        }
+    }
+}
+
+TEST(ObjectModule, SaveLoad) {
+    std::string sub = WriteFile("sub.csl",
+                                "SUB    START\n"
+                                "       ADDA  GR1,=1\n"
+                                "       OUT   BUF,LEN\n"
+                                "       RET\n"
+                                "BUF    DC    'sub'\n"
+                                "LEN    DC    3\n"
+                                "       END\n");
+    auto env = std::make_unique<cii::CommetIIEnv>();
+    Builder builder{*env};
+    std::unique_ptr<cii::ObjectModule> module = builder.Compile(sub);
+    ASSERT_NE(nullptr, module);
+    EXPECT_EQ(nullptr, builder.Compile("none.csl"));
+
+    std::stringstream ss;
+    EXPECT_TRUE(module->Save(ss));
+    cii::ObjectModule loaded;
+    EXPECT_TRUE(loaded.Load(ss));
+    EXPECT_EQ(module->words, loaded.words);
+    EXPECT_EQ(module->locals, loaded.locals);
+    EXPECT_EQ((std::vector<cii::SymValue>{{"SUB", 0}}), loaded.externs);
+    EXPECT_EQ(module->refs, loaded.refs);
+    EXPECT_EQ((std::vector<cii::SymValue>{{"=1", 1}}), loaded.consts);
+    ASSERT_EQ(module->dbg_infos.Size(), loaded.dbg_infos.Size());
+    for (uint32_t i = 0; i < loaded.dbg_infos.Size(); i++) {
+        EXPECT_EQ(module->dbg_infos.Text(i), loaded.dbg_infos.Text(i));
+        EXPECT_EQ(module->dbg_infos.Err(i), loaded.dbg_infos.Err(i));
+        EXPECT_EQ(module->dbg_infos.StartOffset(i), loaded.dbg_infos.StartOffset(i));
+        EXPECT_EQ(module->dbg_infos.EndOffset(i), loaded.dbg_infos.EndOffset(i));
+    }
+
+    // 形式が違う
+    std::stringstream bad{"CIIX"};
+    EXPECT_FALSE(loaded.Load(bad));
+
+    // ファイルの大きさを超える長さ(ワード数、シンボル数)
+    for (const char *body : {"\xff\xff\xff\xff\x0f", "\x00\xff\xff\xff\x7f"}) {
+        std::stringstream broken{std::string("CIIO\x02\x00", 6) + body};
+        EXPECT_FALSE(loaded.Load(broken));
+    }
+}
+
+TEST(ObjectCache, Collision) {
+    const std::string src_a = "A      START\n       LAD   GR1,1\n       RET\n       END\n";
+    const std::string src_b = "B      START\n       LAD   GR1,2\n       RET\n       END\n";
+    std::string file_a = WriteFile("cache_a.csl", src_a);
+    auto env = std::make_unique<cii::CommetIIEnv>();
+    Builder builder{*env};
+    std::unique_ptr<cii::ObjectModule> module = builder.Compile(file_a);
+    ASSERT_NE(nullptr, module);
+    EXPECT_EQ(src_a.size(), module->source_size);
+
+    std::string cache_dir = ::testing::TempDir() + "casl_cache_collision";
+    std::filesystem::remove_all(cache_dir);
+    cii::ObjectCache cache{cache_dir};
+    ASSERT_TRUE(cache.Save(src_a, *module));
+    cii::ObjectModule loaded;
+    EXPECT_TRUE(cache.Load(src_a, loaded));
+    EXPECT_EQ(module->words, loaded.words);
+
+    // ハッシュ値が衝突した別のソースのモジュールは読み込まない
+    std::filesystem::copy_file(cache.GetPath(src_a), cache.GetPath(src_b));
+    EXPECT_FALSE(cache.Load(src_b, loaded));
+    // 行が同じでもバイト数が違う(末尾の改行がない)
+    std::string src_c = src_a.substr(0, src_a.size() - 1);
+    std::filesystem::copy_file(cache.GetPath(src_a), cache.GetPath(src_c));
+    EXPECT_FALSE(cache.Load(src_c, loaded));
+}
+
+TEST(ExecImage, SaveOpen) {
+    std::string main = WriteFile("main.csl",
+                                 "MAIN   START\n"
+                                 "       CALL  SUB\n"
+                                 "       OUT   BUF,LEN\n"
+                                 "       RET\n"
+                                 "BUF    DC    'main'\n"
+                                 "LEN    DC    4\n"
+                                 "       END\n");
+    std::string sub = WriteFile("sub.csl",
+                                "SUB    START\n"
+                                "       ADDA  GR1,=1\n"
+                                "       RET\n"
+                                "BUF    DS    2\n"
+                                "       END\n");
+    auto env = std::make_unique<cii::CommetIIEnv>();
+    Builder builder{*env};
+    ass::LineTable dbg_infos;
+    ASSERT_TRUE(builder.Build({main, sub}, dbg_infos));
+
+    std::string file = ::testing::TempDir() + "main.ciix";
+    {
+        std::ofstream ofs(file, std::ios::binary);
+        EXPECT_TRUE(cii::ExecImage::Save(ofs, env->mem, builder.GetStart(), dbg_infos));
+    }
+    cii::ExecImage image;
+    ASSERT_TRUE(image.Open(file));
+    EXPECT_EQ(env->mem.size, image.GetMemSize());
+    EXPECT_EQ(env->mem.GetOffset(), image.GetUsed());
+    EXPECT_EQ(0, image.GetStart());
+
+    // ビルドしたときと同じメモリ、シンボル、デバッグ情報
+    // 前の内容が残っているメモリに読み込んでも、使用領域以降は0になる
+    auto loaded = std::make_unique<cii::CommetIIEnv>();
+    for (uint32_t adr : {image.GetUsed(), 2048u, loaded->mem.size - 1}) loaded->mem.memory[adr].data = 0x1234;
+    EXPECT_TRUE(image.Load(loaded->mem));
+    image.LoadSyms(loaded->mem);
+    for (uint32_t i = 0; i < env->mem.size; i++) EXPECT_EQ(env->mem.memory[i].data, loaded->mem.memory[i].data);
+    for (const char *sym : {"MAIN", "SUB", "BUF", "LEN", "NONE"}) {
+        EXPECT_EQ(env->mem.FindSym(sym), image.FindSym(sym)) << sym;
+        EXPECT_EQ(env->mem.FindSym(sym), loaded->mem.FindSym(sym)) << sym;
+    }
+    ass::LineTable image_dbg_infos;
+    image.GetDbgInfos(image_dbg_infos);
+    ASSERT_EQ(dbg_infos.Size(), image_dbg_infos.Size());
+    for (uint32_t i = 0; i < dbg_infos.Size(); i++) {
+        EXPECT_EQ(dbg_infos.Text(i), image_dbg_infos.Text(i));
+        EXPECT_EQ(dbg_infos.StartOffset(i), image_dbg_infos.StartOffset(i));
+        EXPECT_EQ(dbg_infos.EndOffset(i), image_dbg_infos.EndOffset(i));
+    }
+
+    // 展開先のメモリが足りない
+    cii::WordData words[4];
+    cii::Memory small{4, words};
+    EXPECT_FALSE(image.Load(small));
+
+    // 途中で切れたファイル、ないファイル
+    std::string contents;
+    {
+        std::ifstream ifs(file, std::ios::binary);
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        contents = ss.str();
+    }
+    cii::ExecImage bad;
+    EXPECT_FALSE(bad.Open(WriteFile("bad.ciix", contents.substr(0, contents.size() - 1))));
+    EXPECT_FALSE(bad.Open(WriteFile("bad.ciix", "CIIO")));
+    EXPECT_FALSE(bad.Open("none.ciix"));
+}
+
+}  // namespace
+#endif
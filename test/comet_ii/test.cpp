@@ -5,6 +5,7 @@
 
 #include "../../src/assem_mem.h"
 #include "../../src/comet_ii.h"
+#include "../../src/conf.h"
 #include "../test_config.h"
 
 #if TEST_CONFIG_TEST_TEST
@@ -268,6 +269,35 @@ TEST(CALL, 0001) {
     cii.Run();
 
     EXPECT_EQ(100, cii.GR1);
+
+    // 戻りアドレスを積めないときは、SPとPRを変更せずに停止する
+    cii.Reset();
+    cii.SP = 200;
+    EXPECT_EQ(CauseOfStop::ILLEGAL_ACCESS, cii.Run());
+    EXPECT_EQ(200, cii.SP);
+    EXPECT_EQ(2, cii.PR);
+    EXPECT_EQ(0, cii.GR1);
+}
+
+TEST(RET, 0001) {
+    CometII cii(&asem);
+
+    asem.Start();
+    asem << OpWord(OpCode::LAD, Reg::GR1) << 5;
+    asem << OpWord(OpCode::RET);
+    EXPECT_EQ(true, asem.End());
+
+    // STARTからのRETはOSに戻り、HALTで停止する
+    cii.Reset();
+    EXPECT_EQ(CauseOfStop::HALT, cii.Run());
+    EXPECT_EQ(5, cii.GR1);
+    EXPECT_EQ(128, cii.SP);
+
+    // スタックの底より下でのRETはスタックアンダーフロー
+    cii.Reset();
+    cii.SP = 129;
+    EXPECT_EQ(CauseOfStop::STACK_UNDERFLOW, cii.Run());
+    EXPECT_EQ(129, cii.SP);
 }
 
 TEST(PUSH_POP, 0001) {
@@ -1291,4 +1321,242 @@ TEST(Load, SUBL_M) {
     EXPECT_EQ((int16_t)-1, (int16_t)cii.GR5);
 }
 
+TEST(DecodeCache, 0001) {
+    CometII cii(&asem);
+
+    // 自己書き換え: LADのアドレス部をSTで書き換える
+    asem.Start();
+    asem << SymDef("L1");
+    asem << OpWord(OpCode::LAD, Reg::GR1) << 1;
+    asem << OpWord(OpCode::ADDA_R, Reg::GR2, Reg::GR1);
+    asem << OpWord(OpCode::LAD, Reg::GR3) << 5;
+    asem << OpWord(OpCode::ST, Reg::GR3) << 1;
+    asem << OpWord(OpCode::LAD, Reg::GR4, Reg::GR4) << 1;
+    asem << OpWord(OpCode::CPA_M, Reg::GR4) << SymRef("TWO");
+    asem << OpWord(OpCode::JNZ) << SymRef("L1");
+    asem << OpWord(OpCode::HLT);
+    asem << SymDef("TWO") << 2;
+
+    EXPECT_EQ(true, asem.End());
+
+    cii.Reset();
+    EXPECT_EQ(CauseOfStop::HALT, cii.Run());
+
+    EXPECT_EQ(5, cii.GR1);
+    EXPECT_EQ(6, cii.GR2);
+    EXPECT_EQ(2, cii.GR4);
+}
+
+TEST(Engine, 0001) {
+    CometII cii(&asem);
+
+    asem.Start();
+    asem << OpWord(OpCode::LAD, Reg::GR1) << 10;
+    asem << SymDef("L1");
+    asem << OpWord(OpCode::ADDA_R, Reg::GR0, Reg::GR1);
+    asem << OpWord(OpCode::SUBA_M, Reg::GR1) << SymRef("ONE");
+    asem << OpWord(OpCode::JNZ) << SymRef("L1");
+    asem << OpWord(OpCode::HLT);
+    asem << SymDef("ONE") << 1;
+
+    EXPECT_EQ(true, asem.End());
+
+    for (auto engine : {ExecEngine::CALL, ExecEngine::THREADED}) {
+        cii.SetEngine(engine);
+        cii.Reset();
+        EXPECT_EQ(CauseOfStop::HALT, cii.Run());
+        EXPECT_EQ(55, cii.GR0);
+        EXPECT_EQ(0, cii.GR1);
+        EXPECT_EQ(32, cii.GetExcutedCounter());
+
+        // シングルステップ
+        cii.Reset();
+        cii.FR.SetSingleStep(ON);
+        EXPECT_EQ(CauseOfStop::SINGLE_STEP, cii.Run());
+        EXPECT_EQ(2, cii.PR);
+        EXPECT_EQ(1, cii.GetExcutedCounter());
+    }
+}
+
+TEST(Fault, 0001) {
+    CometII cii(&asem);
+
+    asem.Start();
+    asem << OpWord(OpCode::LAD, Reg::GR1) << 7;
+    asem << OpWord(OpCode::LD_M, Reg::GR1) << 0xFFFF;
+    asem << OpWord(OpCode::HLT);
+
+    EXPECT_EQ(true, asem.End());
+
+    for (auto engine : {ExecEngine::CALL, ExecEngine::THREADED}) {
+        cii.SetEngine(engine);
+        cii.Reset();
+        // 範囲外アクセスではレジスタを変更せずに停止する
+        EXPECT_EQ(CauseOfStop::ILLEGAL_ACCESS, cii.Run());
+        EXPECT_EQ(7, cii.GR1);
+        EXPECT_EQ(4, cii.PR);
+        EXPECT_EQ(2, cii.GetExcutedCounter());
+
+        // 停止要因は持ち越さない
+        cii.PR = 4;
+        EXPECT_EQ(CauseOfStop::HALT, cii.Run());
+    }
+}
+
+TEST(BreakPoint, 0001) {
+    CometII cii(&asem);
+
+    asem.Start();
+    asem << OpWord(OpCode::LAD, Reg::GR1) << 10;
+    asem << SymDef("L1");
+    asem << OpWord(OpCode::ADDA_R, Reg::GR0, Reg::GR1);
+    asem << OpWord(OpCode::SUBA_M, Reg::GR1) << SymRef("ONE");
+    asem << OpWord(OpCode::JNZ) << SymRef("L1");
+    asem << OpWord(OpCode::HLT);
+    asem << SymDef("ONE") << 1;
+
+    EXPECT_EQ(true, asem.End());
+    uint16_t l1 = asem.FindSym("L1");
+
+    for (auto engine : {ExecEngine::CALL, ExecEngine::THREADED, ExecEngine::JIT}) {
+        cii.SetEngine(engine);
+        cii.Reset();
+
+        // 無条件
+        cii.SetBreakPoint(l1);
+        EXPECT_EQ(CauseOfStop::BREAK_POINT, cii.Run());
+        EXPECT_EQ(l1, cii.PR);
+        EXPECT_EQ(0, cii.GR0);
+        EXPECT_EQ(CauseOfStop::BREAK_POINT, cii.Run());
+        EXPECT_EQ(10, cii.GR0);
+        EXPECT_EQ(2u, cii.FindBreakPoint(l1)->hit_count);
+
+        // 条件付き
+        cii.SetBreakPoint(l1, [](const CometII &c) { return c.GR1 == 3; });
+        EXPECT_EQ(CauseOfStop::BREAK_POINT, cii.Run());
+        EXPECT_EQ(3, cii.GR1);
+        EXPECT_EQ(3u, cii.FindBreakPoint(l1)->hit_count);
+        cii.DeleteBreakPoint(l1);
+        EXPECT_EQ(nullptr, cii.FindBreakPoint(l1));
+        EXPECT_EQ(CauseOfStop::HALT, cii.Run());
+        EXPECT_EQ(55, cii.GR0);
+
+        // 通過回数
+        cii.Reset();
+        cii.SetBreakPoint(l1, nullptr, 4);
+        EXPECT_EQ(CauseOfStop::BREAK_POINT, cii.Run());
+        EXPECT_EQ(6, cii.GR1);
+        cii.DeleteBreakPoint(l1);
+    }
+
+    // 削除しても他のブレークポイントは残る
+    cii.SetBreakPoint(0);
+    cii.SetBreakPoint(l1);
+    cii.SetBreakPoint(l1 + 1);
+    cii.DeleteBreakPoint(0);
+    EXPECT_EQ(2u, cii.GetBreakPoints().size());
+    EXPECT_NE(nullptr, cii.FindBreakPoint(l1));
+    EXPECT_NE(nullptr, cii.FindBreakPoint(l1 + 1));
+    cii.DeleteBreakPoint(l1);
+    cii.DeleteBreakPoint(l1 + 1);
+    EXPECT_EQ(0u, cii.GetBreakPoints().size());
+}
+
+TEST(RunFor, 0001) {
+    CometII cii(&asem);
+
+    // 無限ループ
+    asem.Start();
+    asem << SymDef("L1");
+    asem << OpWord(OpCode::LAD, Reg::GR1, Reg::GR1) << 1;
+    asem << OpWord(OpCode::ADDA_R, Reg::GR0, Reg::GR1);
+    asem << OpWord(OpCode::JUMP) << SymRef("L1");
+
+    EXPECT_EQ(true, asem.End());
+
+    for (auto engine : {ExecEngine::CALL, ExecEngine::THREADED, ExecEngine::JIT}) {
+        cii.SetEngine(engine);
+        cii.Reset();
+
+        RunResult result = cii.RunFor(1000);
+        EXPECT_EQ(CauseOfStop::STEP_LIMIT, result.cause);
+        EXPECT_EQ(1000u, result.steps);
+        EXPECT_EQ(1000u, cii.GetExcutedCounter());
+        EXPECT_EQ(334, cii.GR1);
+
+        // 続きから実行する
+        result = cii.RunFor(1);
+        EXPECT_EQ(CauseOfStop::STEP_LIMIT, result.cause);
+        EXPECT_EQ(1u, result.steps);
+        EXPECT_EQ(1001u, cii.GetExcutedCounter());
+
+        result = cii.RunFor(0);
+        EXPECT_EQ(CauseOfStop::STEP_LIMIT, result.cause);
+        EXPECT_EQ(0u, result.steps);
+
+        result = cii.RunUntil([](const CometII &c) { return c.GR1 == 500; });
+        EXPECT_EQ(CauseOfStop::CONDITION, result.cause);
+        EXPECT_EQ(500, cii.GR1);
+        EXPECT_EQ(cii.GetExcutedCounter(), 1001u + result.steps);
+
+        result = cii.RunUntil([](const CometII &) { return false; }, 10);
+        EXPECT_EQ(CauseOfStop::STEP_LIMIT, result.cause);
+        EXPECT_EQ(10u, result.steps);
+    }
+
+    // 上限より先に停止する
+    asem.Start();
+    asem << OpWord(OpCode::LAD, Reg::GR1) << 1;
+    asem << OpWord(OpCode::HLT);
+
+    EXPECT_EQ(true, asem.End());
+
+    cii.Reset();
+    RunResult result = cii.RunFor(100);
+    EXPECT_EQ(CauseOfStop::HALT, result.cause);
+    EXPECT_EQ(2u, result.steps);
+}
+
+TEST(Memory, 0001) {
+    // アドレス空間全体
+    CommetIIEnv env{CommetIIEnv::MAX_MEM_SIZE};
+    AssmMem &mem = env.mem;
+    CometII &cii = env.cii_cpu;
+    EXPECT_EQ(0x10000u, mem.size);
+
+    mem.Start();
+    mem << OpWord(OpCode::PUSH) << 0x1234;
+    mem << OpWord(OpCode::POP, Reg::GR1);
+    mem << OpWord(OpCode::CALL) << SymRef("SUB");
+    mem << OpWord(OpCode::ST, Reg::GR2) << 0xFFFF;
+    mem << OpWord(OpCode::RET);
+    mem << SymDef("SUB");
+    mem << OpWord(OpCode::LAD, Reg::GR2) << 7;
+    mem << OpWord(OpCode::RET);
+
+    EXPECT_EQ(true, mem.End());
+
+    for (auto engine : {ExecEngine::CALL, ExecEngine::THREADED, ExecEngine::JIT}) {
+        cii.SetEngine(engine);
+        cii.Reset();
+        EXPECT_EQ(0, cii.SP);
+        // STARTからのRETでHALTと同じように停止する
+        EXPECT_EQ(CauseOfStop::HALT, cii.Run());
+        EXPECT_EQ(0x1234, cii.GR1);
+        EXPECT_EQ(7, mem.memory[0xFFFF].data);
+        EXPECT_EQ(0, cii.SP);
+    }
+
+    // メモリサイズを超えるプログラム
+    WordData words[4];
+    AssmMem small = {4, words, 0};
+    small.Start();
+    small << OpWord(OpCode::LAD, Reg::GR1) << 1;
+    small << OpWord(OpCode::LAD, Reg::GR2) << 2;
+    EXPECT_EQ(false, small.IsOverflow());
+    small << OpWord(OpCode::HLT);
+    EXPECT_EQ(false, small.End());
+    EXPECT_EQ(true, small.IsOverflow());
+}
+
 #endif
\ No newline at end of file
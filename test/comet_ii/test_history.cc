@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "../test_base.h"
+#include "../test_config.h"
+#include "assembler.h"
+#include "comet_ii.h"
+#include "debugger.h"
+#include "history.h"
+#include "input_arena.h"
+
+#if TEST_CONFIG_HISTORY_TEST
+
+namespace {
+const char* const SRC =
+    "MAIN    START\n"
+    "        IN      BUF,LEN\n"
+    "        LAD     GR2,0\n"
+    "LOOP    LD      GR1,BUF\n"
+    "        ADDA    GR1,GR2\n"
+    "        ST      GR1,DATA,GR2\n"
+    "        CALL    SUB\n"
+    "        LAD     GR2,1,GR2\n"
+    "        CPA     GR2,=600\n"
+    "        JNZ     LOOP\n"
+    "        OUT     BUF,LEN\n"
+    "        IN      BUF,LEN\n"
+    "        HLT\n"
+    "SUB     PUSH    0,GR1\n"
+    "        POP     GR3\n"
+    "        RET\n"
+    "BUF     DS      10\n"
+    "LEN     DS      1\n"
+    "DATA    DS      600\n"
+    "        END\n";
+const char* const INPUT = "AB\nCD\n";
+constexpr uint32_t MEM_SIZE = 1024;
+
+class HistoryTest : public TestBase<MEM_SIZE> {
+   protected:
+    /**
+     * @brief メモリとCPUの状態
+     */
+    struct Snap {
+        cii::CpuState state;
+        std::vector<uint16_t> words;
+    };
+
+    cii::InputArena input{INPUT};
+    std::stringstream out;
+    std::vector<uint16_t> init;  //!< 実行前のメモリ
+
+    // 実行履歴を使わずに実行する、同じプログラムの別のCPU
+    cii::WordData ref_words[MEM_SIZE] = {};
+    cii::Memory ref_mem = {MEM_SIZE, ref_words};
+    cii::CometII ref_cpu = {&ref_mem};
+    cii::InputArena ref_input{INPUT};
+    std::stringstream ref_out;
+
+    void SetUp() {
+        ASSERT_NO_FATAL_FAILURE(Assemble(SRC));
+        for (uint32_t i = 0; i < MEM_SIZE; i++) init.push_back(words[i].data);
+
+        cii_cpu.SetSvcIn(input);
+        cii_cpu.SetSvcOut(out);
+        cii_cpu.SetEngine(cii::ExecEngine::CALL);
+        ref_cpu.SetSvcIn(ref_input);
+        ref_cpu.SetSvcOut(ref_out);
+    }
+    void TearDown() { cii_cpu.SetHistory(nullptr); }
+
+    static Snap Take(const cii::CometII& cpu) {
+        Snap snap{cpu.GetState(), {}};
+        const cii::Memory& m = cpu.GetMemory();
+        for (uint32_t i = 0; i < m.size; i++) snap.words.push_back(m.memory[i].data);
+        return snap;
+    }
+    /**
+     * 最初から指定した命令数まで実行したときの状態
+     */
+    Snap Reference(uint32_t counter) {
+        for (uint32_t i = 0; i < MEM_SIZE; i++) ref_words[i].data = init[i];
+        ref_cpu.Reset();
+        ref_input.Rewind();
+        while (ref_cpu.GetExcutedCounter() < counter) {
+            if (ref_cpu.RunFor(counter - ref_cpu.GetExcutedCounter()).steps == 0) break;
+        }
+        return Take(ref_cpu);
+    }
+    static void ExpectSame(const Snap& expect, const Snap& actual) {
+        EXPECT_EQ(expect.state.counter, actual.state.counter);
+        EXPECT_TRUE(std::equal(expect.state.gr, expect.state.gr + 8, actual.state.gr)) << expect.state.counter;
+        EXPECT_EQ(expect.state.sp, actual.state.sp);
+        EXPECT_EQ(expect.state.pr, actual.state.pr);
+        EXPECT_EQ(expect.state.fr, actual.state.fr);
+        EXPECT_TRUE(expect.words == actual.words) << expect.state.counter;
+    }
+};
+}  // namespace
+
+/**
+ * 任意の実行命令数に戻せる。戻したあとは記録した入力で同じ結果になる
+ */
+TEST_F(HistoryTest, GoTo) {
+    cii_cpu.Reset();
+    cii::History history(cii_cpu, cii::History::DEFAULT_BUDGET, 50);
+    cii_cpu.SetHistory(&history);
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    uint32_t end = cii_cpu.GetExcutedCounter();
+    Snap last = Take(cii_cpu);
+    ExpectSame(Reference(end), last);
+    EXPECT_EQ("AB\n", out.str());
+    EXPECT_GT(history.GetCheckpoints(), 0u);
+
+    for (uint32_t counter : {end, end - 1, 2000u, 1234u, 50u, 3u}) {
+        ASSERT_TRUE(history.GoTo(counter));
+        ExpectSame(Reference(counter), Take(cii_cpu));
+    }
+    // 現在より後には移動しない
+    EXPECT_FALSE(history.GoTo(4));
+    // 戻したあとに実行した範囲にも戻せる
+    EXPECT_EQ(1500u, cii_cpu.RunFor(1500).steps);
+    ASSERT_TRUE(history.GoTo(1000));
+    ExpectSame(Reference(1000), Take(cii_cpu));
+    // 戻すときは出力しない
+    EXPECT_EQ("AB\n", out.str());
+
+    // 入力は読み終わっているが、記録した入力を読み込むため同じ結果になる
+    ASSERT_TRUE(history.GoTo(0));
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    ExpectSame(last, Take(cii_cpu));
+    EXPECT_EQ("AB\nAB\n", out.str());
+}
+
+/**
+ * 前に到達したブレークポイントに戻る
+ */
+TEST_F(HistoryTest, ReverseContinue) {
+    uint16_t sub = mem.FindSym("SUB");
+    std::vector<uint32_t> hits;
+    Reference(0);
+    ref_cpu.RunUntil([&](const cii::CometII& c) {
+        if (c.PR == sub) hits.push_back(c.GetExcutedCounter());
+        return false;
+    });
+    ASSERT_EQ(600u, hits.size());
+
+    cii_cpu.Reset();
+    cii::History history(cii_cpu, cii::History::DEFAULT_BUDGET, 64);
+    cii_cpu.SetHistory(&history);
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    cii_cpu.SetBreakPoint(sub);
+
+    EXPECT_EQ(cii::CauseOfStop::BREAK_POINT, history.ReverseContinue());
+    EXPECT_EQ(hits[599], cii_cpu.GetExcutedCounter());
+    EXPECT_EQ(599, cii_cpu.GR2);
+    EXPECT_EQ(cii::CauseOfStop::BREAK_POINT, history.ReverseContinue());
+    EXPECT_EQ(hits[598], cii_cpu.GetExcutedCounter());
+
+    // 戻した位置のブレークポイントでは停止せず、次のブレークポイントで停止する
+    EXPECT_EQ(cii::CauseOfStop::BREAK_POINT, cii_cpu.Run());
+    EXPECT_EQ(hits[599], cii_cpu.GetExcutedCounter());
+
+    cii_cpu.DeleteBreakPoint(sub);
+    EXPECT_EQ(cii::CauseOfStop::OK, history.ReverseContinue());
+    EXPECT_EQ(0u, cii_cpu.GetExcutedCounter());
+}
+
+/**
+ * 上限を超えると古いチェックポイントを統合し、戻れる範囲が短くなる
+ */
+TEST_F(HistoryTest, Budget) {
+    cii_cpu.Reset();
+    cii::History history(cii_cpu, 16 * 1024, 50);
+    cii_cpu.SetHistory(&history);
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    uint32_t end = cii_cpu.GetExcutedCounter();
+
+    EXPECT_LE(history.GetUsed(), 16u * 1024);
+    uint32_t oldest = history.GetOldest();
+    EXPECT_GT(oldest, 0u);
+    EXPECT_FALSE(history.GoTo(oldest - 1));
+    ASSERT_TRUE(history.GoTo(oldest + 7));
+    ExpectSame(Reference(oldest + 7), Take(cii_cpu));
+    ASSERT_TRUE(history.GoTo(oldest));
+    ExpectSame(Reference(oldest), Take(cii_cpu));
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    ExpectSame(Reference(end), Take(cii_cpu));
+}
+
+/**
+ * デバッガは実行履歴の記録を開始するまでは記録せず、指定したエンジン(THREADED、JIT)で実行する
+ */
+TEST_F(HistoryTest, DebuggerDefault) {
+    ass::LineTable dbg_infos;
+    {
+        cii::Debugger debug(cii_cpu, dbg_infos, mem);
+        EXPECT_FALSE(cii_cpu.IsHooked());
+        for (auto engine : {cii::ExecEngine::THREADED, cii::ExecEngine::JIT}) {
+            cii_cpu.SetEngine(engine);
+            cii_cpu.Reset();
+            input.Rewind();
+            EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+            EXPECT_FALSE(cii_cpu.IsHooked());
+        }
+        ExpectSame(Reference(cii_cpu.GetExcutedCounter()), Take(cii_cpu));
+
+        debug.StartHistory(cii::History::DEFAULT_BUDGET);
+        EXPECT_TRUE(cii_cpu.IsHooked());
+    }
+    EXPECT_FALSE(cii_cpu.IsHooked());
+}
+#endif
@@ -0,0 +1,217 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <vector>
+
+#include "../test_base.h"
+#include "../test_config.h"
+#include "assembler.h"
+#include "comet_ii.h"
+#include "jit_x64.h"
+
+#if TEST_CONFIG_JIT_TEST
+
+namespace {
+/**
+ * 実行後の状態
+ */
+struct State {
+    cii::CauseOfStop cause;
+    uint16_t gr[8];
+    uint16_t sp, pr;
+    bool of, sf, zf;
+    uint32_t counter;
+    std::vector<uint16_t> memory;
+
+    bool operator==(const State& s) const {
+        return cause == s.cause && std::equal(gr, gr + 8, s.gr) && sp == s.sp && pr == s.pr && of == s.of &&
+               sf == s.sf && zf == s.zf && counter == s.counter && memory == s.memory;
+    }
+};
+
+std::ostream& operator<<(std::ostream& os, const State& s) {
+    os << "cause=" << (int)s.cause << " PR=" << s.pr << " SP=" << s.sp << " OF=" << s.of << " SF=" << s.sf
+       << " ZF=" << s.zf << " EC=" << s.counter << " GR=";
+    for (auto r : s.gr) os << r << " ";
+    return os;
+}
+
+class JitTest : public TestBase<1024> {
+   protected:
+    void SetUp() {}
+    void TearDown() {}
+
+    void Build(const char* src) {
+        ass::Assembler assem;
+        std::stringstream ss{src};
+        mem.Start();
+        assem.Assemble(ss, mem);
+        ASSERT_FALSE(assem.is_error);
+        ASSERT_TRUE(mem.End());
+    }
+
+    State Save(cii::CauseOfStop cause) {
+        State s{cause,
+                {},
+                cii_cpu.SP,
+                cii_cpu.PR,
+                cii_cpu.FR.IsOverflow(),
+                cii_cpu.FR.IsSigned(),
+                cii_cpu.FR.IsZero(),
+                cii_cpu.GetExcutedCounter(),
+                {}};
+        for (int i = 0; i < 8; i++) s.gr[i] = cii_cpu.GetReg(i);
+        for (uint32_t i = 0; i < mem.size; i++) s.memory.push_back(mem.memory[i].data);
+        return s;
+    }
+
+    State RunWith(cii::ExecEngine engine, const char* src) {
+        Build(src);
+        cii_cpu.SetEngine(engine);
+        cii_cpu.Reset();
+        return Save(cii_cpu.Run());
+    }
+
+    /**
+     * @brief JITで実行したときに、ブロックをコンパイルしたことを確かめる
+     * @note
+     * インタプリタに戻るだけでも結果は一致するため、結果の比較だけではJITを確かめたことにならない
+     */
+    void ExpectCompiled() {
+#if defined(__x86_64__) && defined(__unix__)
+        const cii::JitX64* jit = cii_cpu.GetJit();
+        ASSERT_NE(nullptr, jit);
+        EXPECT_GT(jit->GetCompiledCount(), 0u);
+#endif
+    }
+
+    void ExpectSame(const char* src, cii::CauseOfStop cause) {
+        State interp = RunWith(cii::ExecEngine::CALL, src);
+        State jit = RunWith(cii::ExecEngine::JIT, src);
+        ExpectCompiled();
+        EXPECT_EQ(cause, interp.cause);
+        EXPECT_EQ(interp, jit);
+    }
+};
+
+const char* ALU_SRC =
+    "MAIN   START\n"
+    "       LAD   GR7,200\n"
+    "LOOP   LD    GR1,GR7\n"
+    "       ADDA  GR1,=30000\n"
+    "       JOV   OV\n"
+    "       ADDL  GR2,GR1\n"
+    "       JUMP  NEXT\n"
+    "OV     SUBL  GR3,GR1\n"
+    "NEXT   SUBA  GR4,=12345\n"
+    "       JMI   NEG\n"
+    "       XOR   GR5,GR4\n"
+    "       JUMP  NEXT2\n"
+    "NEG    OR    GR5,=#0F0F\n"
+    "NEXT2  AND   GR6,GR5\n"
+    "       CPL   GR6,GR2\n"
+    "       JPL   P1\n"
+    "       ADDA  GR6,=1\n"
+    "P1     CPA   GR4,GR3\n"
+    "       JZE   P2\n"
+    "       LD    GR0,TBL,GR7\n"
+    "       ADDL  GR0,GR6\n"
+    "       ST    GR0,TBL,GR7\n"
+    "P2     PUSH  0,GR0\n"
+    "       POP   GR1\n"
+    "       SUBA  GR7,=1\n"
+    "       JNZ   LOOP\n"
+    "       HLT\n"
+    "TBL    DS    256\n"
+    "       END\n";
+
+TEST_F(JitTest, Available) {
+#if defined(__x86_64__) && defined(__unix__)
+    cii::JitX64 jit(1024);
+    EXPECT_TRUE(jit.IsAvailable());
+#endif
+}
+
+TEST_F(JitTest, Alu) { ExpectSame(ALU_SRC, cii::CauseOfStop::HALT); }
+
+TEST_F(JitTest, SumLoop) {
+    ExpectSame(
+        "PROG1  START\n"
+        "       LAD   GR7,100\n"
+        "OUTER  XOR   GR0,GR0\n"
+        "       XOR   GR1,GR1\n"
+        "L1     CPA   GR1,LEN\n"
+        "       JZE   L2\n"
+        "       ADDA  GR0,DATA,GR1\n"
+        "       ADDA  GR1,=1\n"
+        "       JUMP  L1\n"
+        "L2     ST    GR0,ANS\n"
+        "       SUBA  GR7,=1\n"
+        "       JNZ   OUTER\n"
+        "       HLT\n"
+        "DATA   DC    12,34,56,78,90\n"
+        "LEN    DC    5\n"
+        "ANS    DS    1\n"
+        "       END\n",
+        cii::CauseOfStop::HALT);
+}
+
+TEST_F(JitTest, SelfModify) {
+    ExpectSame(
+        "MAIN   START\n"
+        "       LAD   GR7,100\n"
+        "       LAD   GR4,1\n"
+        "L      LAD   GR1,1\n"
+        "       ADDA  GR2,GR1\n"
+        "       ST    GR7,L,GR4\n"
+        "       SUBA  GR7,=1\n"
+        "       JNZ   L\n"
+        "       HLT\n"
+        "       END\n",
+        cii::CauseOfStop::HALT);
+}
+
+TEST_F(JitTest, IllegalAccess) {
+    ExpectSame(
+        "MAIN   START\n"
+        "       LAD   GR1,0\n"
+        "L      LD    GR0,0,GR1\n"
+        "       LAD   GR1,1,GR1\n"
+        "       JUMP  L\n"
+        "       END\n",
+        cii::CauseOfStop::ILLEGAL_ACCESS);
+}
+
+TEST_F(JitTest, BreakPoint) {
+    std::vector<State> results[2];
+    int i = 0;
+    for (auto engine : {cii::ExecEngine::CALL, cii::ExecEngine::JIT}) {
+        Build(ALU_SRC);
+        cii_cpu.SetEngine(engine);
+        cii_cpu.Reset();
+
+        uint16_t p2 = mem.FindSym("P2");
+        // LOOPブロックの途中(ADDA)
+        uint16_t loop_adda = mem.FindSym("LOOP") + 1;
+
+        // P2以外のブロックがコンパイルされるまで実行する
+        cii_cpu.SetBreakPoint(p2);
+        for (int n = 0; n < 30; n++) results[i].push_back(Save(cii_cpu.Run()));
+        cii_cpu.DeleteBreakPoint(p2);
+
+        // コンパイル済みブロックの途中にブレークポイントを設定する
+        cii_cpu.SetBreakPoint(loop_adda);
+        for (int n = 0; n < 30; n++) results[i].push_back(Save(cii_cpu.Run()));
+        cii_cpu.DeleteBreakPoint(loop_adda);
+        results[i].push_back(Save(cii_cpu.Run()));
+        i++;
+    }
+    ExpectCompiled();
+    EXPECT_EQ(cii::CauseOfStop::BREAK_POINT, results[0][0].cause);
+    EXPECT_EQ(cii::CauseOfStop::HALT, results[0].back().cause);
+    ASSERT_EQ(results[0].size(), results[1].size());
+    for (size_t n = 0; n < results[0].size(); n++) EXPECT_EQ(results[0][n], results[1][n]) << "stop " << n;
+}
+
+}  // namespace
+#endif
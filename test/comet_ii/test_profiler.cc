@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "../test_base.h"
+#include "../test_config.h"
+#include "assembler.h"
+#include "comet_ii.h"
+#include "profiler.h"
+
+#if TEST_CONFIG_PROFILER_TEST
+
+namespace {
+const char* const SRC =
+    "MAIN    START\n"
+    "        LAD     GR2,3\n"
+    "LOOP    CALL    SUB\n"
+    "        SUBA    GR2,=1\n"
+    "        JNZ     LOOP\n"
+    "        HLT\n"
+    "SUB     ADDA    GR1,=2\n"
+    "        CALL    SUB2\n"
+    "        RET\n"
+    "SUB2    LAD     GR3,1\n"
+    "        RET\n"
+    "        END\n";
+
+class ProfilerTest : public TestBase<1024> {
+   protected:
+    ass::Assembler assem;
+
+    void SetUp() {
+        ASSERT_NO_FATAL_FAILURE(Assemble(SRC, assem));
+        assem.dbg_infos.BuildIndex();
+    }
+    void TearDown() {}
+};
+}  // namespace
+
+/**
+ * 命令、分岐、CALL先ごとの回数
+ */
+TEST_F(ProfilerTest, Counts) {
+    cii::Profiler profiler(mem.size);
+    cii_cpu.SetProfiler(&profiler);
+    cii_cpu.Reset();
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    cii_cpu.SetProfiler(nullptr);
+
+    EXPECT_EQ(cii_cpu.GetExcutedCounter(), profiler.GetSteps());
+    EXPECT_EQ(1u, profiler.GetCount(mem.FindSym("MAIN")));
+    EXPECT_EQ(3u, profiler.GetCount(mem.FindSym("LOOP")));
+    EXPECT_EQ(3u, profiler.GetCount(mem.FindSym("SUB2")));
+    EXPECT_EQ(6u, profiler.GetOpCount(cii::OpCode::CALL));
+    EXPECT_EQ(6u, profiler.GetOpCount(cii::OpCode::RET));
+
+    // JNZ LOOP
+    uint16_t jnz = mem.FindSym("LOOP") + 4;
+    EXPECT_EQ(2u, profiler.GetTaken(jnz));
+    EXPECT_EQ(1u, profiler.GetNotTaken(jnz));
+
+    // SUB: ADDA,CALL,(LAD,RET),RET
+    auto funcs = profiler.GetFuncs();
+    ASSERT_EQ(2u, funcs.size());
+    EXPECT_EQ(mem.FindSym("SUB"), funcs[0].adr);
+    EXPECT_EQ(3u, funcs[0].calls);
+    EXPECT_EQ(15u, funcs[0].inclusive);
+    EXPECT_EQ(mem.FindSym("SUB2"), funcs[1].adr);
+    EXPECT_EQ(6u, funcs[1].inclusive);
+
+    auto lines = profiler.GetHotLines(assem.dbg_infos, 2);
+    ASSERT_EQ(2u, lines.size());
+    EXPECT_EQ(3u, lines[0].count);
+    EXPECT_EQ(2u, lines[0].line);
+
+    std::stringstream folded;
+    profiler.WriteFolded(folded, mem.GetSyms());
+    EXPECT_EQ("MAIN 11\nMAIN;SUB 9\nMAIN;SUB;SUB2 6\n", folded.str());
+}
+
+/**
+ * 記録しないときと実行結果が同じ。合計は経路ごとにまとめる
+ */
+TEST_F(ProfilerTest, Merge) {
+    cii_cpu.Reset();
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    uint32_t steps = cii_cpu.GetExcutedCounter();
+    uint16_t gr1 = cii_cpu.GR1;
+
+    cii::Profiler total(mem.size);
+    for (int i = 0; i < 2; i++) {
+        cii::Profiler profiler(mem.size);
+        cii_cpu.SetProfiler(&profiler);
+        cii_cpu.Reset();
+        EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+        EXPECT_EQ(steps, cii_cpu.GetExcutedCounter());
+        EXPECT_EQ(gr1, cii_cpu.GR1);
+        total.Merge(profiler);
+    }
+    cii_cpu.SetProfiler(nullptr);
+
+    EXPECT_EQ(steps * 2u, total.GetSteps());
+    EXPECT_EQ(6u, total.GetCount(mem.FindSym("SUB")));
+    EXPECT_EQ(30u, total.GetFuncs()[0].inclusive);
+    std::stringstream folded;
+    total.WriteFolded(folded, mem.GetSyms());
+    EXPECT_EQ("MAIN 22\nMAIN;SUB 18\nMAIN;SUB;SUB2 12\n", folded.str());
+}
+
+/**
+ * 1つのプロファイラで複数回の実行を合計しても、実行ごとに記録して合計したときと同じになる
+ */
+TEST_F(ProfilerTest, EndRun) {
+    cii::Profiler total(mem.size);
+    cii::Profiler acc(mem.size);
+    for (uint32_t max_steps : {5u, 0u}) {
+        cii::Profiler profiler(mem.size);
+        for (cii::Profiler* p : {&profiler, &acc}) {
+            cii_cpu.SetProfiler(p);
+            cii_cpu.Reset();
+            // 5命令目はSUB2の中で停止する
+            if (max_steps == 0)
+                EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+            else
+                EXPECT_EQ(cii::CauseOfStop::STEP_LIMIT, cii_cpu.RunFor(max_steps).cause);
+        }
+        acc.EndRun();
+        total.Merge(profiler);
+    }
+    cii_cpu.SetProfiler(nullptr);
+
+    EXPECT_EQ(total.GetSteps(), acc.GetSteps());
+    EXPECT_EQ(total.GetFuncs()[0].inclusive, acc.GetFuncs()[0].inclusive);
+    EXPECT_EQ(total.GetFuncs()[1].inclusive, acc.GetFuncs()[1].inclusive);
+    std::stringstream expect;
+    std::stringstream folded;
+    total.WriteFolded(expect, mem.GetSyms());
+    acc.WriteFolded(folded, mem.GetSyms());
+    EXPECT_EQ(expect.str(), folded.str());
+}
+#endif
@@ -81,6 +81,36 @@ TEST_F(SVCTest, SVC_IN_002) {
     EXPECT_EQ(0xffff, len);
 }
 
+TEST_F(SVCTest, SVC_IN_ARENA) {
+    mem.Start();
+    mem << cii::OpWord(cii::OpCode::LAD, cii::Reg::GR1) << 5;
+    mem << cii::OpWord(cii::OpCode::LAD, cii::Reg::GR2) << 7;
+    mem << cii::IOSVC(cii::SVCNo::SVC_IN, "INBUF", "LEN");
+    mem << cii::Halt();
+    uint16_t buff_offset = mem.GetOffset();
+    mem << cii::SymDS("INBUF", 256);
+    uint16_t len_offset = mem.GetOffset();
+    mem << cii::SymDC("LEN", 0);
+
+    EXPECT_EQ(true, mem.End());
+
+    cii::InputArena arena{"Hello\n\nWorld"};
+    EXPECT_EQ(3u, arena.GetLines());
+    cii_cpu.SetSvcIn(arena);
+
+    // 1行ずつ読み込み、最後は改行なしの行、そのあとは入力の終わり
+    const std::pair<const char *, uint16_t> expects[] = {{"Hello", 5}, {"", 0}, {"World", 5}, {"", 0xffff}};
+    for (auto &expect : expects) {
+        cii_cpu.Reset();
+        cii_cpu.Run();
+
+        EXPECT_EQ(5, cii_cpu.GR1);
+        EXPECT_EQ(7, cii_cpu.GR2);
+        EXPECT_EQ(expect.second, mem.memory[len_offset]);
+        for (int i = 0; expect.first[i] != '\0'; i++) EXPECT_EQ(expect.first[i], mem.memory[buff_offset + i]);
+    }
+}
+
 TEST_F(SVCTest, SVC_OUT) {
     std::string msg = "Hello World!";
     mem.Start();
@@ -103,5 +133,27 @@ TEST_F(SVCTest, SVC_OUT) {
 
     EXPECT_EQ("Hello World!\n", os.str());
 }
+
+TEST_F(SVCTest, SVC_OUT_BUFFER) {
+    std::string msg = "Hello World!";
+    mem.Start();
+    mem << cii::IOSVC(cii::SVCNo::SVC_OUT, "OUTBUF", "LEN");
+    mem << cii::IOSVC(cii::SVCNo::SVC_OUT, "OUTBUF", "LEN");
+    mem << cii::Halt();
+    mem << cii::SymDef("OUTBUF") << msg.c_str() << cii::SymDC("LEN", msg.size());
+
+    EXPECT_EQ(true, mem.End());
+
+    // 既定のバッファリング、1行ごと、しきい値より長い出力のいずれも同じ結果になる
+    for (size_t flush_size : {cii::CometII::DEFAULT_OUT_FLUSH_SIZE, (size_t)0, (size_t)4}) {
+        std::stringstream os;
+        cii_cpu.SetSvcOut(os);
+        cii_cpu.SetSvcOutBuffer(flush_size);
+
+        cii_cpu.Reset();
+        EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+        EXPECT_EQ("Hello World!\nHello World!\n", os.str());
+    }
+}
 }  // namespace
 #endif
\ No newline at end of file
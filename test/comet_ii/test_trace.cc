@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "../test_base.h"
+#include "../test_config.h"
+#include "assembler.h"
+#include "comet_ii.h"
+#include "tracer.h"
+
+#if TEST_CONFIG_TRACE_TEST
+
+namespace {
+const char* const SRC =
+    "MAIN    START\n"
+    "        LAD     GR2,40\n"
+    "LOOP    CALL    SUB\n"
+    "        ST      GR1,DATA,GR2\n"
+    "        SUBA    GR2,=1\n"
+    "        JNZ     LOOP\n"
+    "        HLT\n"
+    "SUB     ADDA    GR1,=2\n"
+    "        PUSH    0,GR1\n"
+    "        POP     GR3\n"
+    "        RET\n"
+    "DATA    DS      41\n"
+    "        END\n";
+
+class TraceTest : public TestBase<1024> {
+   protected:
+    void SetUp() { ASSERT_NO_FATAL_FAILURE(Assemble(SRC)); }
+    void TearDown() {}
+
+    /**
+     * 1命令ずつ実行したときの実行後のレジスタ
+     */
+    std::vector<cii::TraceStep> StepByStep() {
+        std::vector<cii::TraceStep> steps;
+        cii_cpu.Reset();
+        for (;;) {
+            cii::TraceStep s{};
+            s.adr = cii_cpu.PR;
+            cii::RunResult r = cii_cpu.RunFor(1);
+            if (r.steps == 0) break;
+            s.step = cii_cpu.GetExcutedCounter();
+            s.next_pr = cii_cpu.PR;
+            for (int i = 0; i < 8; i++) s.gr[i] = cii_cpu.GetReg(i);
+            s.sp = cii_cpu.SP;
+            s.fr = cii_cpu.FR.IsOverflow() | (cii_cpu.FR.IsSigned() << 1) | (cii_cpu.FR.IsZero() << 2);
+            steps.push_back(s);
+            if (r.cause != cii::CauseOfStop::STEP_LIMIT) break;
+        }
+        return steps;
+    }
+
+    void ExpectSame(const cii::TraceStep& expect, const cii::TraceStep& actual) {
+        EXPECT_EQ(expect.step, actual.step);
+        EXPECT_EQ(expect.adr, actual.adr);
+        EXPECT_EQ(expect.next_pr, actual.next_pr);
+        EXPECT_TRUE(std::equal(expect.gr, expect.gr + 8, actual.gr)) << "step " << expect.step;
+        EXPECT_EQ(expect.sp, actual.sp);
+        EXPECT_EQ(expect.fr, actual.fr);
+    }
+};
+}  // namespace
+
+/**
+ * 差分から復元したレジスタが1命令ずつ実行したときと同じ
+ */
+TEST_F(TraceTest, Decode) {
+    std::vector<cii::TraceStep> expect = StepByStep();
+
+    cii::Tracer tracer;
+    cii_cpu.SetTracer(&tracer);
+    cii_cpu.Reset();
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    cii_cpu.SetTracer(nullptr);
+
+    std::vector<cii::TraceStep> actual;
+    tracer.ForEach([&](const cii::TraceStep& s) { actual.push_back(s); });
+    ASSERT_EQ(expect.size(), actual.size());
+    EXPECT_EQ(expect.size(), tracer.GetTotal());
+    for (size_t i = 0; i < expect.size(); i++) ExpectSame(expect[i], actual[i]);
+
+    // ST GR1,DATA,GR2 の実効アドレス
+    uint16_t st = mem.FindSym("LOOP") + 2;
+    auto itr = std::find_if(actual.begin(), actual.end(), [&](const cii::TraceStep& s) { return s.adr == st; });
+    ASSERT_NE(actual.end(), itr);
+    EXPECT_TRUE(itr->has_ea);
+    EXPECT_EQ(mem.FindSym("DATA") + 40, itr->ea);
+}
+
+/**
+ * リングバッファが埋まると古いブロックから上書きし、出力先には全命令を書き込む
+ */
+TEST_F(TraceTest, RingAndFile) {
+    std::vector<cii::TraceStep> expect = StepByStep();
+
+    std::stringstream file;
+    cii::Tracer tracer(2 * cii::Tracer::BLOCK_SIZE);
+    tracer.SetSink(&file);
+    cii_cpu.SetTracer(&tracer);
+    cii_cpu.Reset();
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    cii_cpu.SetTracer(nullptr);
+    tracer.Flush();
+
+    std::vector<cii::TraceStep> last = tracer.GetLast(10);
+    ASSERT_EQ(10u, last.size());
+    for (size_t i = 0; i < last.size(); i++) ExpectSame(expect[expect.size() - 10 + i], last[i]);
+    size_t kept = 0;
+    tracer.ForEach([&](const cii::TraceStep&) { kept++; });
+    EXPECT_LT(kept, expect.size());
+
+    std::vector<cii::TraceStep> all;
+    EXPECT_TRUE(cii::Tracer::ReadFile(file, [&](const cii::TraceStep& s) { all.push_back(s); }));
+    ASSERT_EQ(expect.size(), all.size());
+    for (size_t i = 0; i < expect.size(); i++) ExpectSame(expect[i], all[i]);
+}
+
+/**
+ * トレースを途中から始めても、最初の命令で変わったレジスタだけを記録する
+ */
+TEST_F(TraceTest, StartMidway) {
+    std::vector<cii::TraceStep> expect = StepByStep();
+    ASSERT_GT(expect.size(), 10u);
+
+    for (size_t start : {size_t(0), size_t(5), size_t(10)}) {
+        cii::Tracer tracer;
+        cii_cpu.Reset();
+        if (start > 0) ASSERT_EQ(start, cii_cpu.RunFor(start).steps);
+        cii_cpu.SetTracer(&tracer);
+        ASSERT_EQ(1u, cii_cpu.RunFor(1).steps);
+        cii_cpu.SetTracer(nullptr);
+
+        std::vector<cii::TraceStep> actual;
+        tracer.ForEach([&](const cii::TraceStep& s) { actual.push_back(s); });
+        ASSERT_EQ(1u, actual.size());
+        ExpectSame(expect[start], actual[0]);
+
+        // 実行前のレジスタ(リセット直後はGRとFRが0、SPはメモリの末尾)との差分
+        cii::TraceStep before{};
+        if (start > 0) {
+            before = expect[start - 1];
+        } else {
+            cii_cpu.Reset();
+            before.sp = cii_cpu.SP;
+        }
+        uint8_t gr_changed = 0;
+        for (int i = 0; i < 8; i++) gr_changed |= (before.gr[i] != expect[start].gr[i]) << i;
+        EXPECT_EQ(gr_changed, actual[0].gr_changed) << "start " << start;
+        EXPECT_EQ(before.sp != expect[start].sp, actual[0].sp_changed) << "start " << start;
+        EXPECT_EQ(before.fr != expect[start].fr, actual[0].fr_changed) << "start " << start;
+    }
+}
+#endif
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "../test_base.h"
+#include "../test_config.h"
+#include "assembler.h"
+#include "comet_ii.h"
+#include "history.h"
+
+#if TEST_CONFIG_WATCH_TEST
+
+namespace {
+const char* const SRC =
+    "MAIN    START\n"
+    "        LAD     GR2,0\n"
+    "LOOP    ST      GR2,DATA,GR2\n"
+    "        LD      GR1,CNT\n"
+    "        LAD     GR1,1,GR1\n"
+    "        ST      GR1,CNT\n"
+    "        LAD     GR2,1,GR2\n"
+    "        CPA     GR2,=300\n"
+    "        JNZ     LOOP\n"
+    "        LD      GR3,FLAG\n"
+    "        ST      GR3,FLAG\n"
+    "        CALL    SUB\n"
+    "        HLT\n"
+    "SUB     RET\n"
+    "CNT     DC      0\n"
+    "FLAG    DC      7\n"
+    "DATA    DS      300\n"
+    "        END\n";
+constexpr uint32_t MEM_SIZE = 1024;
+
+class WatchTest : public TestBase<MEM_SIZE> {
+   protected:
+    std::stringstream out;
+    uint16_t cnt;
+    uint16_t flag;
+    uint16_t data;
+
+    void SetUp() {
+        ASSERT_NO_FATAL_FAILURE(Assemble(SRC));
+        cnt = mem.FindSym("CNT");
+        flag = mem.FindSym("FLAG");
+        data = mem.FindSym("DATA");
+
+        cii_cpu.SetSvcOut(out);
+        cii_cpu.SetEngine(cii::ExecEngine::CALL);
+        cii_cpu.Reset();
+    }
+    void TearDown() { cii_cpu.SetHistory(nullptr); }
+};
+}  // namespace
+
+/**
+ * 値が変わる書き込みで、その命令を実行してから停止する
+ */
+TEST_F(WatchTest, Write) {
+    cii_cpu.SetWatchPoint(cnt, cnt, cii::WatchType::WRITE);
+    for (uint16_t i = 1; i <= 3; i++) {
+        EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, cii_cpu.Run());
+        const cii::WatchHit& hit = cii_cpu.GetWatchHit();
+        EXPECT_TRUE(hit.write);
+        EXPECT_EQ(cnt, hit.adr);
+        EXPECT_EQ(i - 1, hit.old_data);
+        EXPECT_EQ(i, hit.data);
+        EXPECT_EQ(i, words[cnt].data);
+        EXPECT_EQ(i - 1, cii_cpu.GR2);
+    }
+    cii_cpu.DeleteWatchPoint(cnt);
+    EXPECT_TRUE(cii_cpu.GetWatchPoints().empty());
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    EXPECT_EQ(300, words[cnt].data);
+}
+
+/**
+ * 同じ値の書き込みでは停止しない。読み書きのときは読み込みと書き込みの両方で停止する
+ */
+TEST_F(WatchTest, UnchangedAndAccess) {
+    cii_cpu.SetWatchPoint(flag, flag, cii::WatchType::WRITE);
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+
+    cii_cpu.Reset();
+    // 範囲が同じウォッチポイントは置き換える
+    cii_cpu.SetWatchPoint(flag, flag, cii::WatchType::ACCESS);
+    ASSERT_EQ(1u, cii_cpu.GetWatchPoints().size());
+    EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, cii_cpu.Run());
+    EXPECT_FALSE(cii_cpu.GetWatchHit().write);
+    EXPECT_EQ(7, cii_cpu.GR3);
+    EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, cii_cpu.Run());
+    EXPECT_TRUE(cii_cpu.GetWatchHit().write);
+    EXPECT_EQ(7, cii_cpu.GetWatchHit().data);
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+}
+
+/**
+ * 読み込み、範囲、値の一致で停止する
+ */
+TEST_F(WatchTest, ReadRangeValue) {
+    cii_cpu.SetWatchPoint(cnt, cnt, cii::WatchType::READ);
+    EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, cii_cpu.Run());
+    EXPECT_FALSE(cii_cpu.GetWatchHit().write);
+    EXPECT_EQ(0, cii_cpu.GR1);
+    cii_cpu.DeleteWatchPoint(cnt);
+
+    // DATA[0]には同じ値(0)を書き込むため、最初に停止するのはDATA[1]
+    cii_cpu.SetWatchPoint(data, data + 3, cii::WatchType::WRITE);
+    EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, cii_cpu.Run());
+    EXPECT_EQ(data + 1, cii_cpu.GetWatchHit().adr);
+    cii_cpu.DeleteWatchPoint(data);
+
+    // ページをまたぐ範囲
+    cii_cpu.SetWatchPoint(data, data + 299, cii::WatchType::VALUE, 280);
+    EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, cii_cpu.Run());
+    EXPECT_EQ(data + 280, cii_cpu.GetWatchHit().adr);
+    EXPECT_EQ(280, cii_cpu.GR2);
+    cii_cpu.DeleteWatchPoint(data);
+
+    // RETでスタックから読み込むときも判定する
+    cii_cpu.SetWatchPoint(MEM_SIZE - 1, MEM_SIZE - 1, cii::WatchType::READ);
+    EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, cii_cpu.Run());
+    EXPECT_EQ(MEM_SIZE - 1, cii_cpu.GetWatchHit().adr);
+    EXPECT_EQ(cii_cpu.PR, cii_cpu.GetWatchHit().data);
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+}
+
+/**
+ * スタックが空のときのRET(STARTからのRET)はスタックを読み込まずに停止する
+ */
+TEST_F(WatchTest, ReturnToOs) {
+    cii_cpu.SetWatchPoint(MEM_SIZE - 1, MEM_SIZE - 1, cii::WatchType::ACCESS);
+    cii_cpu.PR = mem.FindSym("SUB");
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+    EXPECT_EQ(MEM_SIZE, cii_cpu.SP);
+    EXPECT_EQ(0, words[MEM_SIZE - 1].data);
+}
+
+/**
+ * THREADED、JITでも同じ位置で停止する(JITはウォッチポイントがあるときはTHREADEDで実行する)
+ */
+TEST_F(WatchTest, Engines) {
+    for (auto engine : {cii::ExecEngine::THREADED, cii::ExecEngine::JIT}) {
+        cii_cpu.SetEngine(engine);
+        cii_cpu.Reset();
+        for (uint32_t i = 0; i < 300; i++) words[data + i].data = 0;
+        words[cnt].data = 0;
+        cii_cpu.SetWatchPoint(data + 250, data + 250, cii::WatchType::WRITE);
+        EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, cii_cpu.Run());
+        EXPECT_EQ(250, cii_cpu.GR2);
+        EXPECT_EQ(250, words[cnt].data);
+        cii_cpu.DeleteWatchPoint(data + 250);
+        EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+        EXPECT_EQ(300, words[cnt].data);
+    }
+}
+
+/**
+ * 逆実行で前にウォッチポイントで停止した位置に戻る
+ */
+TEST_F(WatchTest, ReverseContinue) {
+    cii::History history(cii_cpu, cii::History::DEFAULT_BUDGET, 64);
+    cii_cpu.SetHistory(&history);
+    EXPECT_EQ(cii::CauseOfStop::HALT, cii_cpu.Run());
+
+    cii_cpu.SetWatchPoint(cnt, cnt, cii::WatchType::WRITE);
+    EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, history.ReverseContinue());
+    EXPECT_EQ(300, words[cnt].data);
+    EXPECT_EQ(299, cii_cpu.GR2);
+    EXPECT_EQ(300, cii_cpu.GetWatchHit().data);
+    EXPECT_EQ(cii::CauseOfStop::WATCH_POINT, history.ReverseContinue());
+    EXPECT_EQ(299, words[cnt].data);
+    EXPECT_EQ(299, cii_cpu.GetWatchHit().data);
+}
+#endif
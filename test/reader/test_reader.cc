@@ -180,6 +180,41 @@ TEST_F(ReaderTest, 0010) {
     EXPECT_EQ(ass::TokenId::COMMA, tokens[2].token_id);
     EXPECT_EQ(ass::TokenId::LABEL, tokens[3].token_id);
 }
+TEST_F(ReaderTest, 0011) {
+    std::string line{"MSG DC 'It''s, a ; test' ;comment"};
+
+    ass::Tokens tokens = reader.Parse(line);
+
+    EXPECT_EQ(3, tokens.size());
+    EXPECT_EQ(ass::TokenId::LABEL, tokens[0].token_id);
+    EXPECT_EQ(ass::TokenId::DC, tokens[1].token_id);
+    EXPECT_EQ(ass::TokenId::STRING, tokens[2].token_id);
+    EXPECT_EQ(std::string("It's, a ; test"), tokens[2].label);
+}
+TEST_F(ReaderTest, 0012) {
+    std::string line{"\tLD\tGR1,='A'\t"};
+
+    ass::Tokens tokens = reader.Parse(line);
+
+    EXPECT_EQ(4, tokens.size());
+    EXPECT_EQ(ass::TokenId::LD, tokens[0].token_id);
+    EXPECT_EQ(ass::TokenId::CONST, tokens[3].token_id);
+    EXPECT_EQ('A', tokens[3].digit);
+    EXPECT_EQ(std::string("'A'"), tokens[3].label);
+}
+TEST_F(ReaderTest, 0013) {
+    // 16ビットを超える値は切り詰める
+    std::string line{" DC #FFFF,-32768,65537,-,#"};
+
+    ass::Tokens tokens = reader.Parse(line);
+
+    EXPECT_EQ(10, tokens.size());
+    EXPECT_EQ(0xffff, tokens[1].digit);
+    EXPECT_EQ(-32768, CastInt(tokens[3].digit));
+    EXPECT_EQ(1, tokens[5].digit);
+    EXPECT_EQ(ass::TokenId::OTHER, tokens[7].token_id);
+    EXPECT_EQ(ass::TokenId::OTHER, tokens[9].token_id);
+}
 
 }  // namespace
 #endif
\ No newline at end of file
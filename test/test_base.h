@@ -1,7 +1,12 @@
 #ifndef TEST_BASE_H_
 #define TEST_BASE_H_
 
+#include <gtest/gtest.h>
+
+#include <sstream>
+
 #include "../src/assem_mem.h"
+#include "../src/assembler.h"
 #include "../src/comet_ii.h"
 #include "../src/reader.h"
 
@@ -13,5 +18,24 @@ class TestBase : public ::testing::Test {
     cii::CometII cii_cpu = {&mem};
     void SetUp() {}
     void TearDown() {}
+
+    /**
+     * @brief ソースをアセンブルしてメモリに配置する
+     * @param src ソース
+     * @param assem アセンブラ(デバッグ情報を使うとき)
+     * @note
+     * アセンブルエラーのときは致命的な失敗にする。呼び出し元はASSERT_NO_FATAL_FAILUREで囲む
+     */
+    void Assemble(const char* src, ass::Assembler& assem) {
+        std::stringstream ss{src};
+        mem.Start();
+        assem.Assemble(ss, mem);
+        ASSERT_FALSE(assem.is_error);
+        ASSERT_TRUE(mem.End());
+    }
+    void Assemble(const char* src) {
+        ass::Assembler assem;
+        Assemble(src, assem);
+    }
 };
 #endif
\ No newline at end of file
@@ -13,8 +13,14 @@
  */
 #define TEST_CONFIG_TEST_TEST TEST_CONFIG_TEST(true)
 #define TEST_CONFIG_SVC_TEST TEST_CONFIG_TEST(true)
+#define TEST_CONFIG_JIT_TEST TEST_CONFIG_TEST(true)
+#define TEST_CONFIG_PROFILER_TEST TEST_CONFIG_TEST(true)
+#define TEST_CONFIG_TRACE_TEST TEST_CONFIG_TEST(true)
+#define TEST_CONFIG_HISTORY_TEST TEST_CONFIG_TEST(true)
+#define TEST_CONFIG_WATCH_TEST TEST_CONFIG_TEST(true)
 
 #define TEST_CONFIG_ASSEMBLER_TEST TEST_CONFIG_TEST(true)
 #define TEST_CONFIG_READER_TEST TEST_CONFIG_TEST(true)
+#define TEST_CONFIG_BATCH_TEST TEST_CONFIG_TEST(true)
 
 #endif